@@ -0,0 +1,297 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Benchmark of the calls made with work_run_parallel() for an increasing
+ * number of threads.  The objects at the start of the array are much more
+ * expensive than the others, so an even split of the objects between the
+ * threads is unbalanced and the threads have to steal work.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+/* Not an error, see comments in generated file. */
+#include "bench/parallel/spin_work_gen.c"
+
+/** The number of objects */
+#define NUM_OBJECTS 100000
+
+/** The weight of the expensive objects */
+#define HEAVY_WEIGHT 32
+
+/** The number of rounds per unit of weight */
+#define NUM_ROUNDS 64
+
+/** The number of timed runs per number of threads, the best one is kept */
+#define NUM_RUNS 3
+
+/**
+ * The class-specific data.
+ */
+typedef struct spin_work_data_st_ {
+    /** The number of times the work is repeated */
+    uint32_t weight;
+} spin_work_data_st;
+
+/**
+ * Override the work virtual function to run.
+ *
+ * @param work_h The work object
+ * @param rounds The number of rounds per unit of weight
+ * @return The checksum of the work
+ * @see work_run()
+ */
+static uint64_t
+spin_work_work_run (work_handle work_h, uint32_t rounds)
+{
+    spin_work_handle spin_work_h = work_cast_to_spin_work(work_h);
+    uint64_t x = 88172645463325252ULL;
+    uint64_t i;
+
+    if (NULL == spin_work_h) {
+        return (0);
+    }
+
+    for (i = 0; i < (uint64_t) rounds * spin_work_h->spin_work_data_h->weight;
+         i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+
+    return (x);
+}
+
+/**
+ * The internal function to delete spin_work_data objects.  Upon return, the
+ * object is not longer valid.
+ *
+ * @param spin_work_data_h Pointer to the object.  If NULL, then this function
+ * is a no-op.  The pointer is set to NULL upon return.
+ * @see spin_work_delete()
+ */
+static void
+spin_work_data_delete (spin_work_data_handle *spin_work_data_h)
+{
+    if ((NULL == spin_work_data_h) || (NULL == *spin_work_data_h)) {
+        return;
+    }
+
+    free(*spin_work_data_h);
+    *spin_work_data_h = NULL;
+}
+
+/**
+ * Create a new spin_work_data object.
+ *
+ * @param spin_work_data_h A pointer to the newly created object
+ * @param context A pointer to the weight of the object
+ * @return TRUE on success, FALSE otherwise
+ */
+static bool
+spin_work_data_create (spin_work_data_handle *spin_work_data_h,
+                       void *context)
+{
+    spin_work_data_st *data;
+
+    if ((NULL == spin_work_data_h) || (NULL == context)) {
+        return (false);
+    }
+
+    data = calloc(1, sizeof(*data));
+    if (NULL == data) {
+        return (false);
+    }
+
+    data->weight = *((uint32_t *) context);
+
+    *spin_work_data_h = data;
+
+    return (true);
+}
+
+/**
+ * Create a new spin_work object.
+ *
+ * @param weight The number of times the work is repeated
+ * @return The object or NULL if creation failed
+ */
+static spin_work_handle
+spin_work_new1 (uint32_t weight)
+{
+    spin_work_st *spin_work = NULL;
+    bool rc;
+
+    spin_work = spin_work_alloc();
+    if (NULL != spin_work) {
+        rc = spin_work_init(spin_work, &weight);
+        if (!rc) {
+            goto err_exit;
+        }
+    }
+
+    return (spin_work);
+
+err_exit:
+
+    spin_work_delete(spin_work);
+
+    return (NULL);
+}
+
+/**
+ * Get the current time in seconds.
+ *
+ * @return The time
+ */
+static double
+now_sec (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/**
+ * Time the parallel calls with the given pool, keeping the best run.
+ *
+ * @param work_handles The objects
+ * @param pool The pool
+ * @param results Set to the return values
+ * @return The time of the best run in seconds
+ */
+static double
+time_parallel (const work_handle *work_handles, c_intf_pool_handle pool,
+               uint64_t *results)
+{
+    double best = 0;
+    double start;
+    double elapsed;
+    int i;
+
+    for (i = 0; i < NUM_RUNS; i++) {
+        start = now_sec();
+        work_run_parallel(work_handles, NUM_OBJECTS, pool, results,
+                          NUM_ROUNDS);
+        elapsed = now_sec() - start;
+        if ((0 == i) || (elapsed < best)) {
+            best = elapsed;
+        }
+    }
+
+    return (best);
+}
+
+/**
+ * Run the benchmark.
+ *
+ * @param argc The number of arguments
+ * @param argv The maximum number of threads, defaults to the number of CPUs
+ * @return 0 on success, 1 otherwise
+ */
+int
+main (int argc, char *argv[])
+{
+    static work_handle work_handles[NUM_OBJECTS];
+    static uint64_t expected[NUM_OBJECTS];
+    static uint64_t results[NUM_OBJECTS];
+    c_intf_pool_handle pool;
+    unsigned int max_threads;
+    unsigned int num_threads;
+    double serial = 0;
+    double start;
+    double elapsed;
+    size_t i;
+    size_t j;
+    int rc = 0;
+
+    max_threads = (argc > 1) ? (unsigned int) atoi(argv[1]) :
+        (unsigned int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (0 == max_threads) {
+        max_threads = 1;
+    }
+
+    for (i = 0; i < NUM_OBJECTS; i++) {
+        work_handles[i] = spin_work_cast_to_work(
+            spin_work_new1((i < NUM_OBJECTS / 8) ? HEAVY_WEIGHT : 1));
+        if (NULL == work_handles[i]) {
+            fprintf(stderr, "Could not create the objects\n");
+            return (1);
+        }
+    }
+
+    /* The plain loop the parallel calls are compared with */
+    for (i = 0; i < NUM_RUNS; i++) {
+        start = now_sec();
+        for (j = 0; j < NUM_OBJECTS; j++) {
+            expected[j] = work_run(work_handles[j], NUM_ROUNDS);
+        }
+        elapsed = now_sec() - start;
+        if ((0 == i) || (elapsed < serial)) {
+            serial = elapsed;
+        }
+    }
+    printf("loop: %.2f ms\n", serial * 1000);
+
+    /* Double the number of threads up to the maximum */
+    for (num_threads = 1; ; num_threads *= 2) {
+        if (num_threads > max_threads) {
+            num_threads = max_threads;
+        }
+
+        pool = c_intf_pool_new(num_threads);
+        if (NULL == pool) {
+            fprintf(stderr, "Could not create a pool of %u threads\n",
+                    num_threads);
+            rc = 1;
+            break;
+        }
+
+        elapsed = time_parallel(work_handles, pool, results);
+        c_intf_pool_delete(pool);
+
+        for (i = 0; i < NUM_OBJECTS; i++) {
+            if (results[i] != expected[i]) {
+                fprintf(stderr, "Wrong result for object %zu\n", i);
+                rc = 1;
+                break;
+            }
+        }
+
+        printf("%u thread%s: %.2f ms, speedup %.2f\n", num_threads,
+               (1 == num_threads) ? "" : "s", elapsed * 1000,
+               serial / elapsed);
+
+        if (num_threads == max_threads) {
+            break;
+        }
+    }
+
+    for (i = 0; i < NUM_OBJECTS; i++) {
+        work_delete(work_handles[i]);
+    }
+
+    return (rc);
+}
@@ -65,6 +65,19 @@ typedef struct osx_button_st_ {
     osx_button_data_handle osx_button_data_h;
 } osx_button_st;
 
+/**
+ * Allocate a zeroed osx_button object.  Objects should be allocated with this
+ * rather than calloc(), so they come from the allocator of the class when
+ * the code is generated with --alloc-hooks.
+ *
+ * @return The object or NULL on failure
+ */
+static inline osx_button_st *
+osx_button_alloc (void)
+{
+    return (calloc(1, sizeof(osx_button_st)));
+}
+
 /*
  * This is C, we need explicit casts to each of an object's parent classes.
  */
@@ -143,9 +156,10 @@ osx_button_button_delete (button_handle button_h)
 }
 
 /**
- * The virtual function table for button interface.
+ * The virtual function table of the button interface of the osx_button
+ * class.
  */
-static button_vtable_st button_vtable = {
+static button_vtable_st osx_button_button_vtable = {
     osx_button_button_paint,
     osx_button_button_delete
 };
@@ -175,7 +189,7 @@ osx_button_init (osx_button_handle osx_button_h, void *context)
     button_initialized = true;
 
     rc = button_set_vtable(&(osx_button_h->button),
-             &button_vtable);
+             &osx_button_button_vtable);
     if (!rc) {
         goto err_exit;
     }
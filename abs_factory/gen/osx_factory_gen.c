@@ -65,6 +65,19 @@ typedef struct osx_factory_st_ {
     osx_factory_data_handle osx_factory_data_h;
 } osx_factory_st;
 
+/**
+ * Allocate a zeroed osx_factory object.  Objects should be allocated with this
+ * rather than calloc(), so they come from the allocator of the class when
+ * the code is generated with --alloc-hooks.
+ *
+ * @return The object or NULL on failure
+ */
+static inline osx_factory_st *
+osx_factory_alloc (void)
+{
+    return (calloc(1, sizeof(osx_factory_st)));
+}
+
 /*
  * This is C, we need explicit casts to each of an object's parent classes.
  */
@@ -143,9 +156,10 @@ osx_factory_gui_factory_delete (gui_factory_handle gui_factory_h)
 }
 
 /**
- * The virtual function table for gui_factory interface.
+ * The virtual function table of the gui_factory interface of the osx_factory
+ * class.
  */
-static gui_factory_vtable_st gui_factory_vtable = {
+static gui_factory_vtable_st osx_factory_gui_factory_vtable = {
     osx_factory_gui_factory_create_button,
     osx_factory_gui_factory_delete
 };
@@ -175,7 +189,7 @@ osx_factory_init (osx_factory_handle osx_factory_h, void *context)
     gui_factory_initialized = true;
 
     rc = gui_factory_set_vtable(&(osx_factory_h->gui_factory),
-             &gui_factory_vtable);
+             &osx_factory_gui_factory_vtable);
     if (!rc) {
         goto err_exit;
     }
@@ -65,6 +65,19 @@ typedef struct win_button_st_ {
     win_button_data_handle win_button_data_h;
 } win_button_st;
 
+/**
+ * Allocate a zeroed win_button object.  Objects should be allocated with this
+ * rather than calloc(), so they come from the allocator of the class when
+ * the code is generated with --alloc-hooks.
+ *
+ * @return The object or NULL on failure
+ */
+static inline win_button_st *
+win_button_alloc (void)
+{
+    return (calloc(1, sizeof(win_button_st)));
+}
+
 /*
  * This is C, we need explicit casts to each of an object's parent classes.
  */
@@ -143,9 +156,10 @@ win_button_button_delete (button_handle button_h)
 }
 
 /**
- * The virtual function table for button interface.
+ * The virtual function table of the button interface of the win_button
+ * class.
  */
-static button_vtable_st button_vtable = {
+static button_vtable_st win_button_button_vtable = {
     win_button_button_paint,
     win_button_button_delete
 };
@@ -175,7 +189,7 @@ win_button_init (win_button_handle win_button_h, void *context)
     button_initialized = true;
 
     rc = button_set_vtable(&(win_button_h->button),
-             &button_vtable);
+             &win_button_button_vtable);
     if (!rc) {
         goto err_exit;
     }
@@ -65,6 +65,19 @@ typedef struct win_factory_st_ {
     win_factory_data_handle win_factory_data_h;
 } win_factory_st;
 
+/**
+ * Allocate a zeroed win_factory object.  Objects should be allocated with this
+ * rather than calloc(), so they come from the allocator of the class when
+ * the code is generated with --alloc-hooks.
+ *
+ * @return The object or NULL on failure
+ */
+static inline win_factory_st *
+win_factory_alloc (void)
+{
+    return (calloc(1, sizeof(win_factory_st)));
+}
+
 /*
  * This is C, we need explicit casts to each of an object's parent classes.
  */
@@ -143,9 +156,10 @@ win_factory_gui_factory_delete (gui_factory_handle gui_factory_h)
 }
 
 /**
- * The virtual function table for gui_factory interface.
+ * The virtual function table of the gui_factory interface of the win_factory
+ * class.
  */
-static gui_factory_vtable_st gui_factory_vtable = {
+static gui_factory_vtable_st win_factory_gui_factory_vtable = {
     win_factory_gui_factory_create_button,
     win_factory_gui_factory_delete
 };
@@ -175,7 +189,7 @@ win_factory_init (win_factory_handle win_factory_h, void *context)
     gui_factory_initialized = true;
 
     rc = gui_factory_set_vtable(&(win_factory_h->gui_factory),
-             &gui_factory_vtable);
+             &win_factory_gui_factory_vtable);
     if (!rc) {
         goto err_exit;
     }
@@ -107,6 +107,67 @@ osx_button_data_create (osx_button_data_handle *osx_button_data_h,
     return (true);
 }
 
+#ifdef C_INTF_MEM_STATS
+/**
+ * Get the size of an osx_button_data object, counted in the memory usage of
+ * the class.
+ *
+ * @param osx_button_data_h The object
+ * @return The number of bytes of the data, 0 if NULL
+ */
+static size_t
+osx_button_data_size (osx_button_data_handle osx_button_data_h)
+{
+    if (NULL == osx_button_data_h) {
+        return (0);
+    }
+
+    return (sizeof(*osx_button_data_h));
+}
+#endif
+
+#ifdef C_INTF_SNAPSHOT
+/**
+ * Write an osx_button_data object to a snapshot.
+ *
+ * @param osx_button_data_h The object
+ * @param writer The snapshot being written
+ * @param offset Set to the offset of the written object
+ * @return TRUE on success, FALSE otherwise
+ */
+static bool
+osx_button_data_snapshot (osx_button_data_handle osx_button_data_h,
+                          c_intf_snap_writer_handle writer, size_t *offset)
+{
+    osx_button_data_st *image;
+
+    *offset = c_intf_snap_alloc(writer, sizeof(*image));
+    if (0 == *offset) {
+        return (false);
+    }
+
+    /* The data holds no pointers, so it is copied as is */
+    image = c_intf_snap_at(writer, *offset);
+    *image = *osx_button_data_h;
+
+    return (true);
+}
+
+/**
+ * Fix a revived osx_button_data object, which holds no pointers.
+ *
+ * @param osx_button_data_h The object, mapped from the snapshot
+ * @param snap The snapshot
+ * @return TRUE
+ */
+static bool
+osx_button_data_revive (osx_button_data_handle osx_button_data_h,
+                        c_intf_snap_handle snap)
+{
+    return (true);
+}
+#endif
+
 /**
  * Create a new osx_button object.
  *
@@ -119,7 +180,7 @@ osx_button_new1 (uint64_t id)
     osx_button_st *osx_button = NULL;
     bool rc;
 
-    osx_button = calloc(1, sizeof(*osx_button));
+    osx_button = osx_button_alloc();
     if (NULL != osx_button) {
         rc = osx_button_init(osx_button, &id);
         if (!rc) {
@@ -25,6 +25,8 @@
 #ifndef __OSX_BUTTON_H__
 #define __OSX_BUTTON_H__
 
+#include <stdint.h>
+#include "gen/button_gen.h"
 #include "gen/osx_button_gen.h"
 
 /* APIs below are documented in their implementation file */
@@ -113,6 +113,67 @@ osx_factory_data_create (osx_factory_data_handle *osx_factory_data_h,
     return (true);
 }
 
+#ifdef C_INTF_MEM_STATS
+/**
+ * Get the size of an osx_factory_data object, counted in the memory usage of
+ * the class.
+ *
+ * @param osx_factory_data_h The object
+ * @return The number of bytes of the data, 0 if NULL
+ */
+static size_t
+osx_factory_data_size (osx_factory_data_handle osx_factory_data_h)
+{
+    if (NULL == osx_factory_data_h) {
+        return (0);
+    }
+
+    return (sizeof(*osx_factory_data_h));
+}
+#endif
+
+#ifdef C_INTF_SNAPSHOT
+/**
+ * Write an osx_factory_data object to a snapshot.
+ *
+ * @param osx_factory_data_h The object
+ * @param writer The snapshot being written
+ * @param offset Set to the offset of the written object
+ * @return TRUE on success, FALSE otherwise
+ */
+static bool
+osx_factory_data_snapshot (osx_factory_data_handle osx_factory_data_h,
+                           c_intf_snap_writer_handle writer, size_t *offset)
+{
+    osx_factory_data_st *image;
+
+    *offset = c_intf_snap_alloc(writer, sizeof(*image));
+    if (0 == *offset) {
+        return (false);
+    }
+
+    /* The data holds no pointers, so it is copied as is */
+    image = c_intf_snap_at(writer, *offset);
+    *image = *osx_factory_data_h;
+
+    return (true);
+}
+
+/**
+ * Fix a revived osx_factory_data object, which holds no pointers.
+ *
+ * @param osx_factory_data_h The object, mapped from the snapshot
+ * @param snap The snapshot
+ * @return TRUE
+ */
+static bool
+osx_factory_data_revive (osx_factory_data_handle osx_factory_data_h,
+                         c_intf_snap_handle snap)
+{
+    return (true);
+}
+#endif
+
 /**
  * Create a new osx_factory object.
  *
@@ -124,7 +185,7 @@ osx_factory_new1 (void)
     osx_factory_st *osx_factory = NULL;
     bool rc;
 
-    osx_factory = calloc(1, sizeof(*osx_factory));
+    osx_factory = osx_factory_alloc();
     if (NULL != osx_factory) {
         rc = osx_factory_init(osx_factory, NULL);
         if (!rc) {
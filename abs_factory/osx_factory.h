@@ -25,6 +25,7 @@
 #ifndef __OSX_FACTORY_H__
 #define __OSX_FACTORY_H__
 
+#include "gen/gui_factory_gen.h"
 #include "gen/osx_factory_gen.h"
 
 /* APIs below are documented in their implementation file */
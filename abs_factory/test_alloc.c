@@ -0,0 +1,124 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Test of the allocators set with --alloc-hooks, run by "make check"
+ * against code generated with it.  Counting allocators are set globally and
+ * for the osx_button class, and every allocation made from them when the
+ * example creates objects must be freed when they are deleted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "win_factory.h"
+#include "osx_factory.h"
+#include "gen/osx_button_gen.h"
+
+/**
+ * The context of a counting allocator.
+ */
+typedef struct counting_st_ {
+    /** The number of allocations */
+    int num_allocs;
+    /** The number of frees */
+    int num_frees;
+} counting_st;
+
+/**
+ * Allocate memory and count it.
+ *
+ * @param ctx The counting_st
+ * @param size The number of bytes
+ * @return The memory or NULL on failure
+ */
+static void *
+counting_alloc (void *ctx, size_t size)
+{
+    ((counting_st *) ctx)->num_allocs++;
+
+    return (malloc(size));
+}
+
+/**
+ * Free memory and count it.
+ *
+ * @param ctx The counting_st
+ * @param ptr The memory
+ */
+static void
+counting_free (void *ctx, void *ptr)
+{
+    ((counting_st *) ctx)->num_frees++;
+    free(ptr);
+}
+
+int
+main (int argc, char *argv[])
+{
+    counting_st global_counts = { 0, 0 };
+    counting_st button_counts = { 0, 0 };
+    const c_intf_allocator_st global_allocator = {
+        counting_alloc, counting_free, &global_counts
+    };
+    const c_intf_allocator_st button_allocator = {
+        counting_alloc, counting_free, &button_counts
+    };
+    win_factory_handle win_factory_h;
+    osx_factory_handle osx_factory_h;
+    button_handle win_button_h, osx_button_h;
+
+    c_intf_set_allocator(&global_allocator);
+    osx_button_set_allocator(&button_allocator);
+
+    /* The object and the private data of its interface */
+    win_factory_h = win_factory_new1();
+    assert((NULL != win_factory_h) && (2 == global_counts.num_allocs));
+    osx_factory_h = osx_factory_new1();
+    assert((NULL != osx_factory_h) && (4 == global_counts.num_allocs));
+
+    win_button_h =
+        gui_factory_create_button(win_factory_cast_to_gui_factory(
+                                      win_factory_h));
+    assert((NULL != win_button_h) && (6 == global_counts.num_allocs));
+
+    /* Buttons of the class with its own allocator only use it */
+    osx_button_h =
+        gui_factory_create_button(osx_factory_cast_to_gui_factory(
+                                      osx_factory_h));
+    assert((NULL != osx_button_h) && (6 == global_counts.num_allocs) &&
+           (2 == button_counts.num_allocs));
+    button_paint(osx_button_h);
+
+    button_delete(osx_button_h);
+    assert((2 == button_counts.num_frees) && (0 == global_counts.num_frees));
+    button_delete(win_button_h);
+    win_factory_delete(win_factory_h);
+    osx_factory_delete(osx_factory_h);
+    assert(global_counts.num_allocs == global_counts.num_frees);
+    assert(button_counts.num_allocs == button_counts.num_frees);
+
+    c_intf_set_allocator(NULL);
+    osx_button_set_allocator(NULL);
+
+    printf("Allocator smoke test passed\n");
+
+    return (0);
+}
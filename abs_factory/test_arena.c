@@ -0,0 +1,254 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Test of the objects created in arenas with --arena, run by "make check"
+ * against code generated from check_arena_def.txt.  An arena holding
+ * TRIVIAL_DESTROY squares and labels needing clean-up is reset and reused.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+
+/* Not an error, the classes are implemented here */
+#include "gen/shape_gen.c"
+#include "gen/square_gen.c"
+#include "gen/label_gen.c"
+
+/** The number of objects of each class created in the arena */
+#define NUM_SHAPES 200
+
+/**
+ * What the objects are created with.
+ */
+typedef struct shape_context_st_ {
+    /** The arena the data is allocated from, NULL for the heap */
+    c_intf_arena_handle arena;
+    /** The size of the shape */
+    int side;
+} shape_context_st;
+
+/**
+ * The class-specific data of squares.
+ */
+typedef struct square_data_st_ {
+    /** The length of the sides */
+    int side;
+} square_data_st;
+
+/**
+ * The class-specific data of labels.
+ */
+typedef struct label_data_st_ {
+    /** The number of characters */
+    int length;
+} label_data_st;
+
+/** The number of labels whose data was not deleted yet */
+static int num_labels;
+
+/**
+ * Get the area of a square.
+ *
+ * @param shape_h The object
+ * @return The area
+ */
+static int
+square_shape_area (shape_handle shape_h)
+{
+    square_data_handle data = shape_cast_to_square(shape_h)->square_data_h;
+
+    return (data->side * data->side);
+}
+
+/**
+ * Delete the data of a square, which is only done for squares not in an
+ * arena.
+ *
+ * @param square_data_h Pointer to the data, set to NULL upon return
+ */
+static void
+square_data_delete (square_data_handle *square_data_h)
+{
+    if ((NULL == square_data_h) || (NULL == *square_data_h)) {
+        return;
+    }
+
+    free(*square_data_h);
+    *square_data_h = NULL;
+}
+
+/**
+ * Create the data of a square, in the arena of the square if it has one, so
+ * it needs no clean-up.
+ *
+ * @param square_data_h Set to the data
+ * @param context The shape_context_st
+ * @return TRUE on success, FALSE otherwise
+ */
+static bool
+square_data_create (square_data_handle *square_data_h, void *context)
+{
+    shape_context_st *shape_context = context;
+    square_data_st *data;
+
+    if ((NULL == square_data_h) || (NULL == shape_context)) {
+        return (false);
+    }
+
+    if (NULL != shape_context->arena) {
+        data = c_intf_alloc(c_intf_arena_get_allocator(shape_context->arena),
+                            sizeof(*data));
+    } else {
+        data = calloc(1, sizeof(*data));
+    }
+    if (NULL == data) {
+        return (false);
+    }
+    data->side = shape_context->side;
+    *square_data_h = data;
+
+    return (true);
+}
+
+/**
+ * Get the area of a label.
+ *
+ * @param shape_h The object
+ * @return The area
+ */
+static int
+label_shape_area (shape_handle shape_h)
+{
+    return (shape_cast_to_label(shape_h)->label_data_h->length);
+}
+
+/**
+ * Delete the data of a label.
+ *
+ * @param label_data_h Pointer to the data, set to NULL upon return
+ */
+static void
+label_data_delete (label_data_handle *label_data_h)
+{
+    if ((NULL == label_data_h) || (NULL == *label_data_h)) {
+        return;
+    }
+
+    free(*label_data_h);
+    *label_data_h = NULL;
+    num_labels--;
+}
+
+/**
+ * Create the data of a label on the heap, so it needs to be deleted.
+ *
+ * @param label_data_h Set to the data
+ * @param context The shape_context_st
+ * @return TRUE on success, FALSE otherwise
+ */
+static bool
+label_data_create (label_data_handle *label_data_h, void *context)
+{
+    shape_context_st *shape_context = context;
+
+    if ((NULL == label_data_h) || (NULL == shape_context)) {
+        return (false);
+    }
+
+    *label_data_h = calloc(1, sizeof(**label_data_h));
+    if (NULL == *label_data_h) {
+        return (false);
+    }
+    (*label_data_h)->length = shape_context->side;
+    num_labels++;
+
+    return (true);
+}
+
+/**
+ * Fill an arena with squares and labels and check their areas.
+ *
+ * @param arena The arena
+ * @param labels Set to the labels created
+ */
+static void
+fill_arena (c_intf_arena_handle arena, label_handle *labels)
+{
+    shape_context_st context;
+    square_handle square_h;
+    int i;
+
+    context.arena = arena;
+    for (i = 0; i < NUM_SHAPES; i++) {
+        context.side = i;
+        square_h = square_new_in(arena, &context);
+        labels[i] = label_new_in(arena, &context);
+        assert((NULL != square_h) && (NULL != labels[i]));
+        assert(i * i == shape_area(square_cast_to_shape(square_h)));
+        assert(i == shape_area(label_cast_to_shape(labels[i])));
+
+        /* Arena objects of a TRIVIAL_DESTROY class are left as they are */
+        if (0 == (i % 2)) {
+            square_delete(square_h);
+            assert(i * i == shape_area(square_cast_to_shape(square_h)));
+        }
+    }
+    assert(NUM_SHAPES == num_labels);
+}
+
+int
+main (int argc, char *argv[])
+{
+    label_handle labels[NUM_SHAPES];
+    shape_context_st context;
+    c_intf_arena_handle arena;
+    square_handle square_h;
+    int i;
+
+    arena = c_intf_arena_new(4096, 0);
+    assert(NULL != arena);
+
+    fill_arena(arena, labels);
+
+    /* Labels deleted before the reset must not be deleted again */
+    for (i = 0; i < NUM_SHAPES; i += 3) {
+        label_delete(labels[i]);
+    }
+    c_intf_arena_reset(arena);
+    assert(0 == num_labels);
+
+    /* The chunks are reused after a reset and deleted with the arena */
+    fill_arena(arena, labels);
+    c_intf_arena_delete(arena);
+    assert(0 == num_labels);
+
+    /* Objects of the same class can still live on the heap */
+    context.arena = NULL;
+    context.side = 3;
+    square_h = square_alloc();
+    assert((NULL != square_h) && square_init(square_h, &context));
+    assert(9 == shape_area(square_cast_to_shape(square_h)));
+    square_delete(square_h);
+
+    printf("Arena smoke test passed\n");
+
+    return (0);
+}
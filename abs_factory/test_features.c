@@ -0,0 +1,435 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Test of the LAZY_DATA, BATCH, MULTIVERSION, EXTENDS and THREADSAFE
+ * features of check_features_def.txt, run by "make check" against the code
+ * generated from it.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <pthread.h>
+
+/* Not an error, the classes are implemented here */
+#include "gen/shape_gen.c"
+#include "gen/regular_shape_gen.c"
+#include "gen/counter_gen.c"
+#include "gen/square_gen.c"
+#include "gen/dot_gen.c"
+
+/** The number of threads incrementing a counter at once */
+#define NUM_THREADS 4
+
+/** The number of increments made by each thread */
+#define NUM_INCREMENTS 20000
+
+/**
+ * The class-specific data of squares.
+ */
+typedef struct square_data_st_ {
+    /** The length of the sides */
+    int side;
+    /** The count of the counter interface */
+    long count;
+} square_data_st;
+
+/** The number of times the data of a square was created */
+static int num_square_data;
+
+/** The number of calls to the batch function of squares */
+static int num_square_batches;
+
+/**
+ * Get the area of a square.
+ *
+ * @param shape_h The object
+ * @param scale What the area is multiplied by
+ * @return The area
+ */
+static int
+square_shape_area (shape_handle shape_h,
+                   int scale)
+{
+    square_data_handle data = shape_cast_to_square(shape_h)->square_data_h;
+
+    return (data->side * data->side * scale);
+}
+
+/**
+ * Get the areas of squares.
+ *
+ * @param shape_handles The objects
+ * @param num_handles The number of objects
+ * @param results Set to the areas
+ * @param scale What the areas are multiplied by
+ */
+static void
+square_shape_area_n (const shape_handle *shape_handles,
+                     size_t num_handles,
+                     int *results,
+                     int scale)
+{
+    size_t i;
+
+    num_square_batches++;
+    for (i = 0; i < num_handles; i++) {
+        results[i] = square_shape_area(shape_handles[i], scale);
+    }
+}
+
+/**
+ * Get the length of the sides.
+ *
+ * @param regular_shape_h The object
+ * @return The length
+ */
+static int
+square_regular_shape_side (regular_shape_handle regular_shape_h)
+{
+    return (regular_shape_cast_to_square(regular_shape_h)->square_data_h->side);
+}
+
+/**
+ * The version used without AVX2 and SSE4.2.
+ *
+ * @param regular_shape_h The object
+ * @return 0
+ */
+static int
+square_regular_shape_version (regular_shape_handle regular_shape_h)
+{
+    return (0);
+}
+
+/**
+ * The version used with AVX2.
+ *
+ * @param regular_shape_h The object
+ * @return 2
+ */
+__attribute__((target("avx2")))
+static int
+square_regular_shape_version_avx2 (regular_shape_handle regular_shape_h)
+{
+    return (2);
+}
+
+/**
+ * The version used with SSE4.2 but not AVX2.
+ *
+ * @param regular_shape_h The object
+ * @return 1
+ */
+__attribute__((target("sse4.2")))
+static int
+square_regular_shape_version_sse4_2 (regular_shape_handle regular_shape_h)
+{
+    return (1);
+}
+
+/**
+ * Add one to the count, only called by one thread at a time.
+ *
+ * @param counter_h The object
+ */
+static void
+square_counter_increment (counter_handle counter_h)
+{
+    counter_cast_to_square(counter_h)->square_data_h->count++;
+}
+
+/**
+ * Get the count.
+ *
+ * @param counter_h The object
+ * @return The count
+ */
+static long
+square_counter_get (counter_handle counter_h)
+{
+    return (counter_cast_to_square(counter_h)->square_data_h->count);
+}
+
+/**
+ * Delete the data of a square.
+ *
+ * @param square_data_h Pointer to the data, set to NULL upon return
+ */
+static void
+square_data_delete (square_data_handle *square_data_h)
+{
+    if ((NULL == square_data_h) || (NULL == *square_data_h)) {
+        return;
+    }
+
+    free(*square_data_h);
+    *square_data_h = NULL;
+}
+
+/**
+ * Create the data of a square on its first call.
+ *
+ * @param square_data_h Set to the data
+ * @param context The length of the sides
+ * @return TRUE on success, FALSE otherwise
+ */
+static bool
+square_data_create (square_data_handle *square_data_h, void *context)
+{
+    if ((NULL == square_data_h) || (NULL == context)) {
+        return (false);
+    }
+
+    *square_data_h = calloc(1, sizeof(**square_data_h));
+    if (NULL == *square_data_h) {
+        return (false);
+    }
+    (*square_data_h)->side = *((int *) context);
+    __atomic_add_fetch(&num_square_data, 1, __ATOMIC_RELAXED);
+
+    return (true);
+}
+
+/**
+ * Get the area of a dot.
+ *
+ * @param shape_h The object
+ * @param scale What the area is multiplied by
+ * @return The scale
+ */
+static int
+dot_shape_area (shape_handle shape_h,
+                int scale)
+{
+    return (scale);
+}
+
+/**
+ * Delete the data of a dot, which has none.
+ *
+ * @param dot_data_h Pointer to the data
+ */
+static void
+dot_data_delete (dot_data_handle *dot_data_h)
+{
+}
+
+/**
+ * Create the data of a dot, which has none.
+ *
+ * @param dot_data_h Set to NULL
+ * @param context Unused
+ * @return TRUE
+ */
+static bool
+dot_data_create (dot_data_handle *dot_data_h, void *context)
+{
+    *dot_data_h = NULL;
+
+    return (true);
+}
+
+/**
+ * Create a square.
+ *
+ * @param side The length of the sides, which must stay valid until the
+ * first call
+ * @return The object
+ */
+static square_handle
+square_new (int *side)
+{
+    square_st *square = square_alloc();
+
+    assert((NULL != square) && square_init(square, side));
+
+    return (square);
+}
+
+/**
+ * Create a dot.
+ *
+ * @return The object
+ */
+static dot_handle
+dot_new (void)
+{
+    dot_st *dot = dot_alloc();
+
+    assert((NULL != dot) && dot_init(dot, NULL));
+
+    return (dot);
+}
+
+/**
+ * Increment a counter from several threads, reading it along.
+ *
+ * @param arg The counter
+ * @return NULL
+ */
+static void *
+increment_thread (void *arg)
+{
+    counter_handle counter_h = arg;
+    long last = 0;
+    long count;
+    int i;
+
+    for (i = 0; i < NUM_INCREMENTS; i++) {
+        counter_increment(counter_h);
+        count = counter_get(counter_h);
+        assert((count > last) && (count <= NUM_THREADS * NUM_INCREMENTS));
+        last = count;
+    }
+
+    return (NULL);
+}
+
+/**
+ * Check the data of a square is created on its first call.
+ */
+static void
+test_lazy_data (void)
+{
+    square_handle square_h;
+    int side = 3;
+
+    num_square_data = 0;
+    square_h = square_new(&side);
+    assert(0 == num_square_data);
+    assert(3 == regular_shape_side(square_cast_to_regular_shape(square_h)));
+    assert(1 == num_square_data);
+    assert(18 == shape_area(square_cast_to_shape(square_h), 2));
+    assert(1 == num_square_data);
+    square_delete(square_h);
+
+    /* Never called, so its data is never created */
+    square_h = square_new(&side);
+    square_delete(square_h);
+    assert(1 == num_square_data);
+}
+
+/**
+ * Check a batch of squares and dots goes through the batch function of
+ * squares and the default one of the interface.
+ */
+static void
+test_batch (void)
+{
+    int sides[3] = { 1, 2, 3 };
+    square_handle squares[3];
+    dot_handle dots[3];
+    shape_handle shapes[6];
+    int results[6];
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        squares[i] = square_new(&(sides[i]));
+        dots[i] = dot_new();
+    }
+    shapes[0] = square_cast_to_shape(squares[0]);
+    shapes[1] = square_cast_to_shape(squares[1]);
+    shapes[2] = dot_cast_to_shape(dots[0]);
+    shapes[3] = square_cast_to_shape(squares[2]);
+    shapes[4] = dot_cast_to_shape(dots[1]);
+    shapes[5] = dot_cast_to_shape(dots[2]);
+
+    num_square_batches = 0;
+    shape_area_n(shapes, 6, results, 10);
+    assert(2 == num_square_batches);
+    assert((10 == results[0]) && (40 == results[1]) && (10 == results[2]) &&
+           (90 == results[3]) && (10 == results[4]) && (10 == results[5]));
+
+    for (i = 0; i < 3; i++) {
+        square_delete(squares[i]);
+        dot_delete(dots[i]);
+    }
+}
+
+/**
+ * Check the version of the method picked for the CPU and that the
+ * interface extending shape can be used as a shape.
+ */
+static void
+test_multiversion_extends (void)
+{
+    regular_shape_handle regular_shape_h;
+    square_handle square_h;
+    int side = 5;
+    int version = 0;
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        version = 2;
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        version = 1;
+    }
+
+    square_h = square_new(&side);
+    regular_shape_h = square_cast_to_regular_shape(square_h);
+    assert(version == regular_shape_version(regular_shape_h));
+
+    assert(square_cast_to_shape(square_h) ==
+           regular_shape_to_shape(regular_shape_h));
+    assert(25 == shape_area(regular_shape_to_shape(regular_shape_h), 1));
+    assert(25 == regular_shape_area(regular_shape_h, 1));
+    square_delete(square_h);
+}
+
+/**
+ * Check concurrent increments of a THREADSAFE counter, whose data is
+ * created by the first of them.
+ */
+static void
+test_threadsafe (void)
+{
+    pthread_t threads[NUM_THREADS];
+    square_handle square_h;
+    int side = 1;
+    int i;
+
+    num_square_data = 0;
+    square_h = square_new(&side);
+    for (i = 0; i < NUM_THREADS; i++) {
+        assert(pthread_create(&(threads[i]), NULL, increment_thread,
+                              square_cast_to_counter(square_h)) == 0);
+    }
+    for (i = 0; i < NUM_THREADS; i++) {
+        assert(pthread_join(threads[i], NULL) == 0);
+    }
+    assert(1 == num_square_data);
+    assert(NUM_THREADS * NUM_INCREMENTS ==
+           counter_get(square_cast_to_counter(square_h)));
+    square_delete(square_h);
+}
+
+int
+main (int argc, char *argv[])
+{
+    test_lazy_data();
+    test_batch();
+    test_multiversion_extends();
+    test_threadsafe();
+
+    printf("Features smoke test passed\n");
+
+    return (0);
+}
@@ -0,0 +1,136 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Test of the memory usage counted with --mem-stats, run by "make check"
+ * against code generated with it.  The live and peak objects and bytes of
+ * the osx_button class, read back from c_intf_mem_report(), must follow the
+ * buttons the example creates and deletes.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "osx_factory.h"
+
+/** The number of buttons created at once */
+#define NUM_BUTTONS 3
+
+/**
+ * The memory usage of a class, as written by c_intf_mem_report().
+ */
+typedef struct usage_st_ {
+    /** The number of live objects */
+    size_t live;
+    /** The highest number of live objects */
+    size_t peak_live;
+    /** The bytes held by the live objects */
+    size_t bytes;
+    /** The highest number of bytes held */
+    size_t peak_bytes;
+} usage_st;
+
+/**
+ * Get the memory usage of a class from c_intf_mem_report().
+ *
+ * @param name The name of the class
+ * @param usage Set to the usage of the class
+ */
+static void
+get_usage (const char *name, usage_st *usage)
+{
+    char line[256];
+    char prefix[64];
+    bool found = false;
+    FILE *report;
+
+    report = tmpfile();
+    assert(NULL != report);
+    c_intf_mem_report(fileno(report));
+    rewind(report);
+
+    snprintf(prefix, sizeof(prefix), "%s: ", name);
+    while (NULL != fgets(line, sizeof(line), report)) {
+        if (0 != strncmp(line, prefix, strlen(prefix))) {
+            continue;
+        }
+        assert(4 == sscanf(line + strlen(prefix),
+                           "%zu live (peak %zu), %zu bytes (peak %zu)",
+                           &(usage->live), &(usage->peak_live),
+                           &(usage->bytes), &(usage->peak_bytes)));
+        found = true;
+    }
+    fclose(report);
+    assert(found);
+}
+
+int
+main (int argc, char *argv[])
+{
+    osx_factory_handle osx_factory_h;
+    button_handle buttons[NUM_BUTTONS];
+    usage_st usage;
+    size_t button_bytes;
+    int i;
+
+    get_usage("osx_button", &usage);
+    assert((0 == usage.live) && (0 == usage.peak_live) &&
+           (0 == usage.bytes) && (0 == usage.peak_bytes));
+
+    osx_factory_h = osx_factory_new1();
+    assert(NULL != osx_factory_h);
+    get_usage("osx_factory", &usage);
+    assert((1 == usage.live) && (1 == usage.peak_live) && (0 != usage.bytes));
+
+    for (i = 0; i < NUM_BUTTONS; i++) {
+        buttons[i] = gui_factory_create_button(
+                         osx_factory_cast_to_gui_factory(osx_factory_h));
+        assert(NULL != buttons[i]);
+    }
+    get_usage("osx_button", &usage);
+    assert((NUM_BUTTONS == usage.live) && (NUM_BUTTONS == usage.peak_live));
+
+    /* Each holds the same object, interface private data and class data */
+    button_bytes = usage.bytes / NUM_BUTTONS;
+    assert((0 != button_bytes) && (NUM_BUTTONS * button_bytes == usage.bytes) &&
+           (usage.bytes == usage.peak_bytes));
+
+    button_delete(buttons[0]);
+    get_usage("osx_button", &usage);
+    assert((NUM_BUTTONS - 1 == usage.live) &&
+           (NUM_BUTTONS == usage.peak_live) &&
+           ((NUM_BUTTONS - 1) * button_bytes == usage.bytes) &&
+           (NUM_BUTTONS * button_bytes == usage.peak_bytes));
+
+    for (i = 1; i < NUM_BUTTONS; i++) {
+        button_delete(buttons[i]);
+    }
+    osx_factory_delete(osx_factory_h);
+    get_usage("osx_button", &usage);
+    assert((0 == usage.live) && (0 == usage.bytes) &&
+           (NUM_BUTTONS == usage.peak_live) &&
+           (NUM_BUTTONS * button_bytes == usage.peak_bytes));
+    get_usage("osx_factory", &usage);
+    assert((0 == usage.live) && (0 == usage.bytes) && (1 == usage.peak_live));
+
+    printf("Memory usage smoke test passed\n");
+
+    return (0);
+}
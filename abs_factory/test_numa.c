@@ -0,0 +1,86 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Smoke test of the objects created on NUMA nodes with --numa, run by
+ * "make check" against code generated with it.  It holds on any machine,
+ * since with a single node every placement resolves to node 0.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include "osx_button.h"
+#include "gen/button_gen.h"
+
+/** The number of objects created */
+#define NUM_BUTTONS 300
+
+int
+main (int argc, char *argv[])
+{
+    osx_button_handle buttons[NUM_BUTTONS];
+    uint64_t id = 1;
+    int placement;
+    int node;
+    int i;
+
+    printf("NUMA nodes: %d, current node: %d\n",
+           c_intf_numa_get_num_nodes(), c_intf_numa_get_current_node());
+
+    for (i = 0; i < NUM_BUTTONS; i++) {
+        switch (i % 3) {
+        case 0:
+            placement = C_INTF_NUMA_CURRENT;
+            break;
+        case 1:
+            placement = 0;
+            break;
+        default:
+            placement = C_INTF_NUMA_INTERLEAVE;
+            break;
+        }
+        buttons[i] = osx_button_new_on(placement, &id);
+        assert(NULL != buttons[i]);
+        if (c_intf_numa_get_num_nodes() == 1) {
+            /* -1 where move_pages() is not allowed, e.g. in containers */
+            node = c_intf_numa_get_node(buttons[i]);
+            assert((0 == node) || (-1 == node));
+        }
+    }
+
+    /* Calls go through the vtable as usual */
+    button_paint(osx_button_cast_to_button(buttons[0]));
+
+    /* There is no such node */
+    assert(NULL == osx_button_new_on(c_intf_numa_get_num_nodes(), &id));
+
+    if (c_intf_numa_get_num_nodes() == 1) {
+        assert(NUM_BUTTONS == osx_button_numa_count(0));
+    }
+
+    for (i = 0; i < NUM_BUTTONS; i++) {
+        osx_button_delete(buttons[i]);
+    }
+    assert(0 == osx_button_numa_count(0));
+
+    printf("NUMA smoke test passed\n");
+
+    return (0);
+}
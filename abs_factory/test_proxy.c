@@ -0,0 +1,325 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Test of the ASYNC and SHM_PROXY proxies of check_proxy_def.txt, run by
+ * "make check" against code generated from it with --record.  A thread
+ * queues calls on an ASYNC proxy which are drained on the target, then
+ * forked clients call the target through shared memory, including clients
+ * exiting in the middle of a call.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/* Not an error, the class is implemented here */
+#include "gen/counter_gen.c"
+#include "gen/tally_gen.c"
+
+/** The number of calls queued on the ASYNC proxy */
+#define NUM_ASYNC_CALLS 100000
+
+/** The number of calls made by the client through shared memory */
+#define NUM_SHM_CALLS 1000
+
+/** The file the calls run on the target are recorded to */
+#define LOG_PATH "test_proxy.log"
+
+/**
+ * The class-specific data.
+ */
+typedef struct tally_data_st_ {
+    /** What was added so far */
+    long count;
+} tally_data_st;
+
+/**
+ * Add to the count.
+ *
+ * @param counter_h The object
+ * @param amount What to add
+ */
+static void
+tally_counter_add (counter_handle counter_h,
+                   int amount)
+{
+    counter_cast_to_tally(counter_h)->tally_data_h->count += amount;
+}
+
+/**
+ * Get the count.
+ *
+ * @param counter_h The object
+ * @return What was added so far
+ */
+static long
+tally_counter_get (counter_handle counter_h)
+{
+    return (counter_cast_to_tally(counter_h)->tally_data_h->count);
+}
+
+/**
+ * Delete the class-specific data.
+ *
+ * @param tally_data_h Pointer to the data, set to NULL upon return
+ */
+static void
+tally_data_delete (tally_data_handle *tally_data_h)
+{
+    if ((NULL == tally_data_h) || (NULL == *tally_data_h)) {
+        return;
+    }
+
+    free(*tally_data_h);
+    *tally_data_h = NULL;
+}
+
+/**
+ * Create the class-specific data.
+ *
+ * @param tally_data_h Set to the data
+ * @param context Unused
+ * @return TRUE on success, FALSE otherwise
+ */
+static bool
+tally_data_create (tally_data_handle *tally_data_h, void *context)
+{
+    if (NULL == tally_data_h) {
+        return (false);
+    }
+
+    *tally_data_h = calloc(1, sizeof(**tally_data_h));
+
+    return (NULL != *tally_data_h);
+}
+
+/**
+ * Create a tally counting from 0.
+ *
+ * @return The object
+ */
+static tally_handle
+tally_new (void)
+{
+    tally_st *tally = tally_alloc();
+
+    assert((NULL != tally) && tally_init(tally, NULL));
+
+    return (tally);
+}
+
+/**
+ * Queue calls on the ASYNC proxy, then wait for the count.
+ *
+ * @param arg The proxy
+ * @return NULL
+ */
+static void *
+producer_thread (void *arg)
+{
+    counter_handle proxy_h = arg;
+    int i;
+
+    for (i = 0; i < NUM_ASYNC_CALLS; i++) {
+        counter_add(proxy_h, 1);
+    }
+    /* Run after the calls queued before it */
+    assert(NUM_ASYNC_CALLS == counter_get(proxy_h));
+
+    return (NULL);
+}
+
+/**
+ * Check the calls drained from the ASYNC proxy were only recorded once, on
+ * the target.
+ *
+ * @param tally_h The target
+ */
+static void
+check_async_record (tally_handle tally_h)
+{
+    const c_intf_call_record_st *record;
+    c_intf_replay_handle replay;
+    const void *args;
+    int num_calls = 0;
+
+    replay = c_intf_replay_open(LOG_PATH);
+    assert(NULL != replay);
+    while (c_intf_replay_next(replay, &record, &args)) {
+        assert((uintptr_t) tally_h == record->object_id);
+        assert(TALLY_RECORD_ID == record->class_id);
+        num_calls++;
+    }
+    assert(0 == c_intf_replay_get_dropped(replay));
+    c_intf_replay_close(replay);
+    remove(LOG_PATH);
+
+    assert(NUM_ASYNC_CALLS + 1 == num_calls);
+}
+
+/**
+ * Drain 100k calls queued by another thread on an ASYNC proxy.
+ */
+static void
+test_async (void)
+{
+    tally_handle tally_h = tally_new();
+    counter_handle proxy_h;
+    pthread_t thread;
+    size_t drained = 0;
+    size_t count;
+
+    proxy_h = counter_async_new(tally_cast_to_counter(tally_h), 0);
+    assert(NULL != proxy_h);
+
+    assert(c_intf_record_start(LOG_PATH, 16 << 20, 1 << 16));
+    assert(pthread_create(&thread, NULL, producer_thread, proxy_h) == 0);
+    while (drained < NUM_ASYNC_CALLS + 1) {
+        count = counter_async_drain(proxy_h, 64);
+        if (0 == count) {
+            sched_yield();
+        }
+        drained += count;
+    }
+    assert(pthread_join(thread, NULL) == 0);
+    c_intf_record_stop();
+
+    assert(0 == counter_async_drain(proxy_h, 64));
+    assert(NUM_ASYNC_CALLS == counter_get(tally_cast_to_counter(tally_h)));
+    check_async_record(tally_h);
+
+    counter_delete(proxy_h);
+    tally_delete(tally_h);
+}
+
+/**
+ * Run a client in a child process.  A client exiting mid-call only reserves
+ * a slot, or only waits for its call without releasing the slot.
+ *
+ * @param name The name of the channel
+ * @param mode 0 for a client making calls, 1 to exit after reserving a slot
+ * and 2 to exit before releasing it
+ * @return The pid of the child
+ */
+static pid_t
+fork_client (const char *name, int mode)
+{
+    counter_handle client_h;
+    c_intf_shm_handle shm;
+    long start;
+    size_t pos;
+    pid_t pid;
+    int i;
+
+    pid = fork();
+    assert(pid >= 0);
+    if (pid > 0) {
+        return (pid);
+    }
+
+    if (0 != mode) {
+        shm = c_intf_shm_open(name, COUNTER_SHM_ID,
+                              sizeof(counter_shm_payload_un));
+        if (NULL == shm) {
+            _exit(1);
+        }
+        c_intf_shm_call_begin(shm, COUNTER_SHM_GET, &pos);
+        if (2 == mode) {
+            c_intf_shm_call_wait(shm, pos);
+        }
+        _exit(0);
+    }
+
+    client_h = counter_shm_client_new(name);
+    if (NULL == client_h) {
+        _exit(1);
+    }
+    start = counter_get(client_h);
+    for (i = 0; i < NUM_SHM_CALLS; i++) {
+        counter_add(client_h, 2);
+    }
+    _exit((start + 2 * NUM_SHM_CALLS == counter_get(client_h)) ? 0 : 1);
+}
+
+/**
+ * Serve a channel until a client exits.  The client is reaped right away
+ * since a slot is only recovered once its process is gone.
+ *
+ * @param shm The channel
+ * @param tally_h The target
+ * @param pid The client
+ */
+static void
+serve_client (c_intf_shm_handle shm, tally_handle tally_h, pid_t pid)
+{
+    int status;
+
+    while (waitpid(pid, &status, WNOHANG) != pid) {
+        counter_shm_serve(shm, tally_cast_to_counter(tally_h), 64, 10);
+    }
+    assert(WIFEXITED(status) && (0 == WEXITSTATUS(status)));
+}
+
+/**
+ * Serve calls made by forked clients through shared memory.
+ */
+static void
+test_shm (void)
+{
+    tally_handle tally_h = tally_new();
+    c_intf_shm_handle shm;
+    char name[64];
+    int i;
+
+    snprintf(name, sizeof(name), "/test_proxy_%d", (int) getpid());
+    shm = counter_shm_create(name, 0);
+    assert(NULL != shm);
+
+    /*
+     * Clients exiting mid-call must not stall the ones after them, whose
+     * calls go around the ring past the slots recovered
+     */
+    serve_client(shm, tally_h, fork_client(name, 0));
+    serve_client(shm, tally_h, fork_client(name, 1));
+    serve_client(shm, tally_h, fork_client(name, 2));
+    for (i = 0; i < 2; i++) {
+        serve_client(shm, tally_h, fork_client(name, 0));
+    }
+    assert(3 * 2 * NUM_SHM_CALLS ==
+           counter_get(tally_cast_to_counter(tally_h)));
+
+    c_intf_shm_delete(shm);
+    tally_delete(tally_h);
+}
+
+int
+main (int argc, char *argv[])
+{
+    test_async();
+    test_shm();
+
+    printf("Proxy smoke test passed\n");
+
+    return (0);
+}
@@ -0,0 +1,148 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Test of the calls recorded with --record, run by "make check" against
+ * code generated with it.  Calls are recorded while another thread keeps
+ * making calls as recording stops, then replayed on new objects.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include "osx_button.h"
+#include "win_button.h"
+#include "gen/button_gen.h"
+
+/** The file calls are recorded to */
+#define LOG_PATH "test_record.log"
+
+/** The number of calls made by the thread */
+#define NUM_THREAD_CALLS 2000
+
+/** The number of calls made by the thread before recording stops */
+#define NUM_THREAD_CALLS_RECORDED 100
+
+/** The number of calls made by the thread so far */
+static int thread_calls;
+
+/**
+ * Paint a button while recording starts and stops.
+ *
+ * @param arg The button
+ * @return NULL
+ */
+static void *
+paint_thread (void *arg)
+{
+    button_handle button_h = arg;
+    int i;
+
+    for (i = 0; i < NUM_THREAD_CALLS; i++) {
+        button_paint(button_h);
+        __atomic_store_n(&thread_calls, i + 1, __ATOMIC_RELEASE);
+    }
+
+    return (NULL);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const c_intf_call_record_st *record;
+    osx_button_handle osx_button_h, replay_osx_button_h;
+    win_button_handle win_button_h, replay_win_button_h;
+    osx_button_handle thread_button_h;
+    c_intf_replay_handle replay;
+    button_handle replay_h;
+    const void *args;
+    pthread_t thread;
+    int num_recorded;
+    int num_osx = 0;
+    int num_win = 0;
+    int num_thread = 0;
+
+    osx_button_h = osx_button_new1(1);
+    win_button_h = win_button_new1();
+    thread_button_h = osx_button_new1(3);
+    assert((NULL != osx_button_h) && (NULL != win_button_h) &&
+           (NULL != thread_button_h));
+
+    assert(c_intf_record_start(LOG_PATH, 1 << 20, 4096));
+    assert(pthread_create(&thread, NULL, paint_thread,
+                          osx_button_cast_to_button(thread_button_h)) == 0);
+
+    button_paint(osx_button_cast_to_button(osx_button_h));
+    button_paint(win_button_cast_to_button(win_button_h));
+    button_paint(osx_button_cast_to_button(osx_button_h));
+
+    /* Stop while the thread is still making calls */
+    while (__atomic_load_n(&thread_calls, __ATOMIC_ACQUIRE) <
+           NUM_THREAD_CALLS_RECORDED) {
+        sched_yield();
+    }
+    num_recorded = __atomic_load_n(&thread_calls, __ATOMIC_ACQUIRE);
+    c_intf_record_stop();
+    button_paint(osx_button_cast_to_button(osx_button_h));
+    assert(pthread_join(thread, NULL) == 0);
+
+    replay_osx_button_h = osx_button_new1(4);
+    replay_win_button_h = win_button_new1();
+    assert((NULL != replay_osx_button_h) && (NULL != replay_win_button_h));
+
+    replay = c_intf_replay_open(LOG_PATH);
+    assert(NULL != replay);
+    while (c_intf_replay_next(replay, &record, &args)) {
+        assert(BUTTON_RECORD_ID == record->intf_id);
+        if ((uintptr_t) osx_button_h == record->object_id) {
+            assert(OSX_BUTTON_RECORD_ID == record->class_id);
+            replay_h = osx_button_cast_to_button(replay_osx_button_h);
+            num_osx++;
+        } else if ((uintptr_t) win_button_h == record->object_id) {
+            assert(WIN_BUTTON_RECORD_ID == record->class_id);
+            replay_h = win_button_cast_to_button(replay_win_button_h);
+            num_win++;
+        } else {
+            assert((uintptr_t) thread_button_h == record->object_id);
+            replay_h = osx_button_cast_to_button(replay_osx_button_h);
+            num_thread++;
+        }
+        assert(button_replay_call(replay_h, record->fn_id, args,
+                                  record->args_size));
+    }
+    assert(0 == c_intf_replay_get_dropped(replay));
+    c_intf_replay_close(replay);
+
+    assert(2 == num_osx);
+    assert(1 == num_win);
+    assert((num_thread >= num_recorded) && (num_thread <= NUM_THREAD_CALLS));
+
+    osx_button_delete(osx_button_h);
+    win_button_delete(win_button_h);
+    osx_button_delete(thread_button_h);
+    osx_button_delete(replay_osx_button_h);
+    win_button_delete(replay_win_button_h);
+    remove(LOG_PATH);
+
+    printf("Record smoke test passed\n");
+
+    return (0);
+}
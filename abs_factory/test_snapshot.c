@@ -0,0 +1,137 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Test of the snapshots written and revived with --snapshot, run by "make
+ * check" against code generated with it.  An OSX factory and an OSX button
+ * are each written to a file, and the objects revived from the files must
+ * keep their data and be called through their interfaces.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "osx_factory.h"
+#include "osx_button.h"
+
+/** The file the snapshots are written to */
+#define SNAP_PATH "test_snapshot.snap"
+
+/**
+ * Paint a button and check what it printed.
+ *
+ * @param button_h The button
+ * @param expected The line it must print
+ */
+static void
+check_paint (button_handle button_h, const char *expected)
+{
+    char line[128] = "";
+    FILE *output;
+    int saved_fd;
+
+    output = tmpfile();
+    assert(NULL != output);
+    fflush(stdout);
+    saved_fd = dup(STDOUT_FILENO);
+    assert((saved_fd >= 0) && (dup2(fileno(output), STDOUT_FILENO) >= 0));
+
+    button_paint(button_h);
+
+    fflush(stdout);
+    assert(dup2(saved_fd, STDOUT_FILENO) >= 0);
+    close(saved_fd);
+    rewind(output);
+    assert(NULL != fgets(line, sizeof(line), output));
+    fclose(output);
+    assert(0 == strcmp(line, expected));
+}
+
+/**
+ * Write an object to SNAP_PATH.
+ *
+ * @param writer The snapshot holding the object
+ * @param offset The offset of the object, 0 if writing it failed
+ */
+static void
+write_snapshot (c_intf_snap_writer_handle writer, size_t offset)
+{
+    assert((0 != offset) && c_intf_snap_write(writer, SNAP_PATH, offset));
+    c_intf_snap_writer_delete(writer);
+}
+
+int
+main (int argc, char *argv[])
+{
+    osx_factory_handle osx_factory_h;
+    osx_button_handle osx_button_h;
+    c_intf_snap_writer_handle writer;
+    c_intf_snap_handle snap;
+    gui_factory_handle gui_factory_h;
+    button_handle button_h;
+
+    /* Its next button gets ID 2 */
+    osx_factory_h = osx_factory_new1();
+    assert(NULL != osx_factory_h);
+    gui_factory_h = osx_factory_cast_to_gui_factory(osx_factory_h);
+    button_h = gui_factory_create_button(gui_factory_h);
+    assert(NULL != button_h);
+    check_paint(button_h, "I'm an OSXButton with ID 1\n");
+    button_delete(button_h);
+
+    /* The revived factory creates buttons from the ID it was written with */
+    writer = c_intf_snap_writer_new();
+    assert(NULL != writer);
+    write_snapshot(writer, osx_factory_snapshot(osx_factory_h, writer));
+    osx_factory_delete(osx_factory_h);
+    snap = c_intf_snap_open(SNAP_PATH);
+    assert(NULL != snap);
+    assert(NULL == c_intf_snap_get_root(snap, OSX_BUTTON_SNAPSHOT_ID));
+    osx_factory_h = c_intf_snap_get_root(snap, OSX_FACTORY_SNAPSHOT_ID);
+    assert(NULL != osx_factory_h);
+    button_h =
+        gui_factory_create_button(osx_factory_cast_to_gui_factory(
+                                      osx_factory_h));
+    assert(NULL != button_h);
+    check_paint(button_h, "I'm an OSXButton with ID 2\n");
+    button_delete(button_h);
+    c_intf_snap_close(snap);
+
+    /* The revived button paints with its ID */
+    osx_button_h = osx_button_new1(7);
+    assert(NULL != osx_button_h);
+    writer = c_intf_snap_writer_new();
+    assert(NULL != writer);
+    write_snapshot(writer, osx_button_snapshot(osx_button_h, writer));
+    button_delete(osx_button_cast_to_button(osx_button_h));
+    snap = c_intf_snap_open(SNAP_PATH);
+    assert(NULL != snap);
+    osx_button_h = c_intf_snap_get_root(snap, OSX_BUTTON_SNAPSHOT_ID);
+    assert(NULL != osx_button_h);
+    check_paint(osx_button_cast_to_button(osx_button_h),
+                "I'm an OSXButton with ID 7\n");
+    c_intf_snap_close(snap);
+    unlink(SNAP_PATH);
+
+    printf("Snapshot smoke test passed\n");
+
+    return (0);
+}
@@ -86,6 +86,56 @@ win_button_data_create (win_button_data_handle *win_button_data_h,
     return (true);
 }
 
+#ifdef C_INTF_MEM_STATS
+/**
+ * Get the size of a win_button_data object, counted in the memory usage of
+ * the class.
+ *
+ * @param win_button_data_h The object
+ * @return 0
+ */
+static size_t
+win_button_data_size (win_button_data_handle win_button_data_h)
+{
+    /* No data is stored for this class */
+    return (0);
+}
+#endif
+
+#ifdef C_INTF_SNAPSHOT
+/**
+ * Write a win_button_data object to a snapshot.
+ *
+ * @param win_button_data_h The object
+ * @param writer The snapshot being written
+ * @param offset Set to the offset of the written object
+ * @return TRUE
+ */
+static bool
+win_button_data_snapshot (win_button_data_handle win_button_data_h,
+                          c_intf_snap_writer_handle writer, size_t *offset)
+{
+    /* No data is stored for this class, so it is never written */
+    *offset = 0;
+
+    return (true);
+}
+
+/**
+ * Fix a revived win_button_data object, which is never written.
+ *
+ * @param win_button_data_h The object, mapped from the snapshot
+ * @param snap The snapshot
+ * @return TRUE
+ */
+static bool
+win_button_data_revive (win_button_data_handle win_button_data_h,
+                        c_intf_snap_handle snap)
+{
+    return (true);
+}
+#endif
+
 /**
  * Create a new win_button object.
  *
@@ -97,7 +147,7 @@ win_button_new1 (void)
     win_button_st *win_button = NULL;
     bool rc;
 
-    win_button = calloc(1, sizeof(*win_button));
+    win_button = win_button_alloc();
     if (NULL != win_button) {
         rc = win_button_init(win_button, NULL);
         if (!rc) {
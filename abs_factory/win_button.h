@@ -25,6 +25,7 @@
 #ifndef __WIN_BUTTON_H__
 #define __WIN_BUTTON_H__
 
+#include "gen/button_gen.h"
 #include "gen/win_button_gen.h"
 
 /* APIs below are documented in their implementation file */
@@ -94,6 +94,56 @@ win_factory_data_create (win_factory_data_handle *win_factory_data_h,
     return (true);
 }
 
+#ifdef C_INTF_MEM_STATS
+/**
+ * Get the size of a win_factory_data object, counted in the memory usage of
+ * the class.
+ *
+ * @param win_factory_data_h The object
+ * @return 0
+ */
+static size_t
+win_factory_data_size (win_factory_data_handle win_factory_data_h)
+{
+    /* No data is stored for this class */
+    return (0);
+}
+#endif
+
+#ifdef C_INTF_SNAPSHOT
+/**
+ * Write a win_factory_data object to a snapshot.
+ *
+ * @param win_factory_data_h The object
+ * @param writer The snapshot being written
+ * @param offset Set to the offset of the written object
+ * @return TRUE
+ */
+static bool
+win_factory_data_snapshot (win_factory_data_handle win_factory_data_h,
+                           c_intf_snap_writer_handle writer, size_t *offset)
+{
+    /* No data is stored for this class, so it is never written */
+    *offset = 0;
+
+    return (true);
+}
+
+/**
+ * Fix a revived win_factory_data object, which is never written.
+ *
+ * @param win_factory_data_h The object, mapped from the snapshot
+ * @param snap The snapshot
+ * @return TRUE
+ */
+static bool
+win_factory_data_revive (win_factory_data_handle win_factory_data_h,
+                         c_intf_snap_handle snap)
+{
+    return (true);
+}
+#endif
+
 /**
  * Create a new win_factory object.
  *
@@ -105,7 +155,7 @@ win_factory_new1 (void)
     win_factory_st *win_factory = NULL;
     bool rc;
 
-    win_factory = calloc(1, sizeof(*win_factory));
+    win_factory = win_factory_alloc();
     if (NULL != win_factory) {
         rc = win_factory_init(win_factory, NULL);
         if (!rc) {
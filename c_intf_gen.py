@@ -35,6 +35,16 @@ typedef void
 void
 my_func(foo_fn callback);
 
+Interfaces defined in other description files can be implemented by classes
+after importing those files at the top level, e.g.:
+
+    IMPORT "employee_def.txt"
+
+Relative paths are taken from the directory of the importing file.  Files are
+only generated for the interfaces and classes defined in the file given on the
+command line; the generated files of imported interfaces are expected to come
+from running the script on their own description file.
+
 For INTERFACE, optionally you can have INCLUDE lines which will be #included.
 E.g.:
 
@@ -62,11 +72,300 @@ Optionally, the following can be specified for comments in the generated files:
 If these are not included, they will not appear in the comments of the generated
 files.
 
+An INTERFACE can be marked with ASYNC, optionally followed by the default
+capacity of the call queue, e.g.:
+
+    INTERFACE employee
+        ASYNC 256
+        ...
+    END INTERFACE
+
+This generates <intf>_async_new() to create a proxy implementing the interface
+for a target object.  Calls on the proxy from any thread are queued in a
+lock-free ring and run on the target by the thread calling
+<intf>_async_drain(), which keeps the target single-threaded.  Functions
+returning void return as soon as the call is queued; the others wait for the
+call to be run, so they must not be called from the draining thread.  Arguments
+are copied by value, so pointers must stay valid until the call is run.
+
+An INTERFACE can also be marked with SHM_PROXY, optionally followed by the
+default capacity of the call queue, to call an object in another process on
+the same host:
+
+    INTERFACE employee
+        SHM_PROXY 64
+        ...
+    END INTERFACE
+
+The serving process creates a channel with <intf>_shm_create() and runs the
+calls on its object with <intf>_shm_serve().  Other processes get a stub
+implementing the interface with <intf>_shm_client_new().  The arguments of a
+call are written straight into a slot of a ring in shared memory, where the
+server also writes the return value, and both sides sleep on futexes when
+there is nothing to do.  Since only values can be passed, inputs and return
+values must not be pointers, arrays or handles.  When no call comes in time,
+the server recovers the slot of a client which exited in the middle of a call,
+so the ring does not stall behind it.
+
+A CLASS can be marked with TRIVIAL_DESTROY if its objects need no clean-up
+when they are allocated from an arena (see --arena), e.g.:
+
+    CLASS teacher
+        TRIVIAL_DESTROY
+        IMPLEMENTS employee
+        END IMPLEMENTS
+    END CLASS
+
+A CLASS can be marked with LAZY_DATA to create the data of its objects with
+<class>_data_create() when one of their methods is first called rather than
+when they are created, so objects which are never used cost no more than
+their interfaces.  The context given to <class>_init() is kept until then, so
+it must remain valid until the first call.  Concurrent first calls wait for
+one of them to create the data.  If the creation fails, the method is still
+called, with a NULL data handle, and the next call tries again.
+
+A class can have versions of a method for CPU features, best first, named
+with MULTIVERSION in its IMPLEMENTS block, e.g.:
+
+    CLASS circle
+        IMPLEMENTS shape
+            MULTIVERSION area avx512f avx2 sse4.2
+        END IMPLEMENTS
+    END CLASS
+
+Besides <class>_<intf>_<fn>(), used when the CPU has none of the features,
+the class then defines <class>_<intf>_<fn>_<feature>() for each feature, with
+any '.' in the feature replaced by '_', compiled for the feature by the
+generated declarations.  A GNU ifunc resolver picks the best version the CPU
+supports with __builtin_cpu_supports() when the program is loaded and the
+vtable of the class points to it, so calls have no feature checks.  This needs
+GCC or Clang on x86 with a C library supporting ifuncs, such as glibc.
+
+A FUNCTION can be marked with BATCH to also generate <intf>_<fn>_n(), which
+calls the function on an array of objects.  The return values, if any, are
+stored in an array and the other inputs are the same for all the objects.
+Each run of objects of the same class is passed to the batch function of the
+class with a single indirect call, so classes can process many objects at
+once, e.g. with SIMD.  A class implements it by naming the function with
+BATCH in its IMPLEMENTS block:
+
+    INTERFACE shape
+        FUNCTION area
+            BATCH
+            RETURN double
+            INPUT void
+        END FUNCTION
+    END INTERFACE
+
+    CLASS circle
+        IMPLEMENTS shape
+            BATCH area
+        END IMPLEMENTS
+    END CLASS
+
+and defining <class>_<intf>_<fn>_n().  For other classes, the batch function
+inherited from the interface calls the function on each object.
+
+An INTERFACE can extend another one, possibly imported, with EXTENDS, e.g.:
+
+    INTERFACE circle_shape EXTENDS shape
+        FUNCTION radius
+            RETURN double
+            INPUT void
+        END FUNCTION
+    END INTERFACE
+
+It has the functions of the interface it extends, whose vtable is the start of
+its own, so <intf>_to_<base>() gets the handle of the extended interface with
+a simple cast.  A class implementing the interface can be cast to both, and
+implements the inherited functions as <class>_<base>_<fn>(), taking a handle
+of the interface declaring them.  The batch versions of inherited functions
+are only called through the interface declaring them.  Interfaces which extend
+another cannot be ASYNC or SHM_PROXY, and a class cannot implement an
+interface twice, directly or through interfaces extending it.
+
+An INTERFACE can be marked with THREADSAFE so its objects can be called from
+several threads while classes implement them as if they were single-threaded,
+and a FUNCTION which does not modify the object with READONLY, e.g.:
+
+    INTERFACE counter
+        THREADSAFE
+        FUNCTION get
+            READONLY
+            RETURN int
+            INPUT void
+        END FUNCTION
+    END INTERFACE
+
+Each call then locks the object, with a lock in the private data of the
+interface: READONLY functions run along with each other and the others run
+alone.  Taking a free lock is a single atomic operation; a thread finding it
+taken spins a while, then sleeps on a futex until it is released, and writers
+waiting keep new readers out.  Deleting an object does not lock it, so it
+must not be called any more.  Interfaces extending a THREADSAFE interface are
+THREADSAFE too, and THREADSAFE interfaces cannot have BATCH functions, which
+would lock many objects at once.
+
 Commented lines begin with any amount of whitespace and a '#' 
 (everything after the '#' is ignored).  Lines with only whitespace are ignored.
 
+Some options generate runtime support shared by all the interfaces and classes
+in c_intf_runtime<suffix>.h and c_intf_runtime<suffix>.c, which must be
+compiled along with the other generated files.
+
+Objects should be allocated with the generated <class>_alloc(), which is
+calloc() by default.  With --alloc-hooks, the object and the private data of
+its interfaces then come from the allocator set with <class>_set_allocator(),
+or else from the one set with c_intf_set_allocator(), and are returned to it
+by <class>_delete().
+
+With --arena, which implies --alloc-hooks, <class>_new_in() creates objects in
+an arena from c_intf_arena_new().  c_intf_arena_reset() releases all of them at
+once, deleting the objects not already deleted unless their class is marked
+TRIVIAL_DESTROY, in which case <class>_delete() is a no-op for arena objects.
+
+With --numa, which implies --alloc-hooks, <class>_new_on() creates objects in
+the memory of a NUMA node given as a placement: an explicit node,
+C_INTF_NUMA_CURRENT for the node of the calling thread or
+C_INTF_NUMA_INTERLEAVE for each node in turn.  The memory comes from a pool
+per node whose pages are bound to the node with mbind(), and
+c_intf_numa_get_node() tells with move_pages() where an object actually is.
+<class>_numa_count() gives the number of live objects of the class per node.
+On machines with a single node, or without NUMA support, every placement
+resolves to node 0 and the pools work the same.
+
+With --parallel-calls, <intf>_<fn>_parallel() calls an interface function on an
+array of objects using a thread pool from c_intf_pool_new(), storing the return
+values, if any, in an array.  The objects are split evenly between the threads,
+which run them in chunks sized from the measured time per call and, once done
+with their own, steal half of the objects left to another thread, so uneven
+costs between implementations are balanced.  Functions with array inputs get
+no parallel version.
+
+With --record, calling c_intf_record_start() makes every interface function
+append the time, object, class, function and scalar inputs of the call to a
+memory-mapped log, each thread to its own segments, until
+c_intf_record_stop().  Objects are identified by their address and classes,
+interfaces and functions by the <CLASS>_RECORD_ID, <INTF>_RECORD_ID and
+<INTF>_RECORD_<FN> hashes of their names.  A replay tool reads the calls back
+in order with c_intf_replay_next(), creates an object of the recorded class
+the first time an object is seen and makes the call again with
+<intf>_replay_call().  Calls with pointer or handle inputs are recorded but
+cannot be replayed.  Calls made on ASYNC proxies are only recorded when they
+run on the target.
+
+With --flight-recorder, every interface function also adds its name, the class
+of the object and its start time and duration, read from the time stamp
+counter, to a ring of the last --flight-events calls made by the thread.
+Rings are lock-free and never block the calls, so c_intf_flight_dump() can
+write the calls of all the threads as Chrome trace JSON at any time, including
+from a signal handler set with c_intf_flight_dump_on_signal() to see what a
+stuck or crashing process was doing.
+
+With --static-init, the vtables of classes are const and the
+<CLASS>_STATIC_INITIALIZER(name, data_h) macro defined in the generated class
+file initializes an object at compile time, so objects such as singletons
+need no allocation or call to <class>_init() and cost nothing at startup:
+
+    static teacher_data_st teacher_data = { ... };
+    static teacher_st teacher = TEACHER_STATIC_INITIALIZER(teacher,
+                                                           &teacher_data);
+
+It can only be used at file scope in the implementation file of the class,
+and such objects must not be deleted.  The private data of interfaces, which
+is a part of the initializer, is then declared in the friend headers.
+
+With --mem-stats, each class counts its live objects, the bytes they hold and
+the peaks of both, and a log2 histogram of the lifetimes of its objects when
+they are deleted.  c_intf_mem_report() writes them for all the classes, along
+with the rate of creation since the previous report, e.g. to find the classes
+worth allocating from pools or arenas or which keep growing.  The bytes of an
+object are counted when it is created, from the object, the private data of
+its interfaces and the data of the class, whose size each class must give:
+
+    static size_t
+    <class>_data_size(<class>_data_handle <class>_data_h);
+
+Classes built both with and without it can define it under #ifdef
+C_INTF_MEM_STATS.
+
+With --snapshot, <class>_snapshot() writes an object, and through its data the
+objects it references, to a writer from c_intf_snap_writer_new() with offsets
+in place of pointers, and c_intf_snap_write() saves it to a file.
+c_intf_snap_open() maps the file and revives every object in a single pass,
+turning offsets back into pointers and setting the vtables from the
+<CLASS>_SNAPSHOT_ID stored with each object, then c_intf_snap_get_root()
+returns the object given to c_intf_snap_write().  As the data of classes is
+opaque to the generator, each class must also define:
+
+    static bool
+    <class>_data_snapshot(<class>_data_handle <class>_data_h,
+        c_intf_snap_writer_handle writer, size_t *offset);
+
+    static bool
+    <class>_data_revive(<class>_data_handle <class>_data_h,
+        c_intf_snap_handle snap);
+
+which write the data with c_intf_snap_alloc(), storing the offsets returned by
+<class>_snapshot() for the objects it references, and turn the offsets back
+into pointers with c_intf_snap_get_ptr().  Revived objects must not be deleted,
+they are released by c_intf_snap_close().  Classes built both with and without
+the option can define both under #ifdef C_INTF_SNAPSHOT.
+
+With --handle-table, <intf>_get_id() gives an object a 32-bit <intf>_id, half
+the size of a handle in arrays, made of the index of a slot in a table of the
+interface and the generation of the slot.  <intf>_resolve() gets the object
+back in O(1) without locking, or NULL once the object was deleted, since
+deleting it frees the slot and changes its generation.  Objects get an id the
+first time it is asked for, so others cost nothing, and freed slots are reused
+oldest first so a stale id is only resolved again after its slot was reused
+1024 times.  Interfaces extending another share the ids of the interface they
+extend, through <intf>_to_<base>().  Objects of TRIVIAL_DESTROY classes
+released with their arena are not deleted, so their ids are not made stale.
+
+With --bulk, <class>_new_n() creates many objects from an array of contexts
+with one allocation holding the objects and the private data of their
+interfaces, set up by <intf>_init_n() which checks the vtable of the class
+once.  If any object cannot be created, the ones already created are deleted
+and nothing is returned.  The objects are deleted one by one as usual, the
+last one freeing the block, or with <intf>_delete_n() for an array of
+handles.
+
+With --epochs, <intf>_retire() deletes an object once no thread can use it
+anymore, so threads reading shared objects do not lock them.  Readers call
+the functions of the objects between c_intf_read_enter() and
+c_intf_read_exit(), which only publish the global epoch the thread is in,
+while a writer replaces an object then retires it instead of deleting it.
+Retired objects are freed two epochs later, when every read section which
+could have seen them is exited; the epoch moves forward when all the threads
+in read sections entered the current one.  Retiring reclaims as it goes, a
+thread stalled in a read section delays but never blocks the others, and
+c_intf_epoch_synchronize() followed by c_intf_epoch_reclaim() frees all the
+retired objects, e.g. before exiting.  Objects can be retired in a read
+section, but c_intf_epoch_synchronize() must be called outside of them.
+
+With --lock-stats, the locks of THREADSAFE interfaces count, for each class,
+how many were taken on its objects, how many had to wait for another thread
+and the time spent waiting, which c_intf_lock_report() writes.  A class with
+many contended locks or long waits is one whose objects are shared too much
+for a single lock.
+
+With --hot-swap, calls read the vtable of an object through a pointer shared
+by all the objects of its class, so <class>_swap_vtable() can swap the
+implementation of all of them, live or created later, with one atomic store
+per interface and without touching them, e.g. to switch to a specialized
+implementation under load, compare implementations or roll one back with
+<class>_default_impl.  The class implementation defines the other vtables,
+which are const, with the functions it replaces; the others are left NULL and
+inherited from the class in a copy of the vtable, made the first time it is
+swapped in and kept for the next times.  Calls then cost one more
+load, and vtables swapped out must never be freed since calls in progress
+may still use them.
+
 """
-import argparse, re, sys, textwrap, os
+import argparse, re, sys, textwrap, os, multiprocessing, hashlib
+import cPickle as pickle
+from collections import OrderedDict
 
 # TODO: packaging this much better is future work
 
@@ -83,11 +382,15 @@ class Function:
         self.name = name
         self.return_type = None
         self.inputs = []
+        self.batch = False
+        self.readonly = False
 
     def __repr__ (self):
-        return "{} (name={}, return_type={}, inputs={})".format(
+        return ("{} (name={}, return_type={}, inputs={}, batch={}, " + \
+                "readonly={})").format(
                    self.__class__.__name__,
-                   self.name, self.return_type, self.inputs)
+                   self.name, self.return_type, self.inputs, self.batch,
+                   self.readonly)
 
     def add_input (self, input):
         """Add an input tuple or void to the function"""
@@ -120,19 +423,58 @@ class Function:
         """Indicates whether the function takes a void input"""
         return ("void" in self.inputs)
 
+    def get_input_names (self):
+        """Return the identifiers of the inputs of the function"""
+        if (self.is_void_input()):
+            return []
+        return [get_c_indentifier(input) for input in self.inputs]
+
+    def get_params_str (self, handle_type, handle_name, sep=", "):
+        """Return the parameter list of the function after the given
+           handle"""
+        params = ["{} {}".format(handle_type, handle_name)]
+        if (not self.is_void_input()):
+            params.extend(self.inputs)
+        return (sep.join(params))
+
+    def get_args_str (self, handle_name, args_prefix="", sep=", "):
+        """Return the argument list of a call passing the inputs through,
+           optionally prefixing each input (e.g. for a struct member)"""
+        return (sep.join([handle_name] +
+                          [args_prefix + name
+                           for name in self.get_input_names()]))
+
 class Interface:
     """An interface which consists of multiple functions declarations"""
     
     def __init__ (self, name):
         """Initialize the interface with the given name"""
         self.name = name
-        self.functions = {}
+        self.functions = OrderedDict()
         self.includes = []
+        self.async_capacity = None
+        self.shm_capacity = None
+        self.threadsafe = False
+        # The name of the extended interface, resolved to base
+        self.base_name = None
+        self.base = None
 
     def __repr__ (self):
-        return "{} (name={}, functions={}, includes={})".format(
+        return "{} (name={}, functions={}, includes={}, base={})".format(
                    self.__class__.__name__,
-                   self.name, self.functions, self.includes)
+                   self.name, self.functions, self.includes, self.base_name)
+
+    def is_async (self):
+        """Indicates whether asynchronous proxies are generated"""
+        return (self.async_capacity is not None)
+
+    def is_shm (self):
+        """Indicates whether shared memory proxies are generated"""
+        return (self.shm_capacity is not None)
+
+    def is_threadsafe (self):
+        """Indicates whether calls lock the object"""
+        return (self.threadsafe)
 
     def add_function (self, function):
         """Add a function to the interface"""
@@ -142,6 +484,33 @@ class Interface:
         """Add a library to include to the interface"""
         self.includes.append(include)
 
+    def get_ancestors (self):
+        """Get the interface and the interfaces it extends, nearest first"""
+        ancestors = [self]
+        while (ancestors[-1].base is not None):
+            ancestors.append(ancestors[-1].base)
+        return (ancestors)
+
+    def get_owner (self, fn):
+        """Get the interface declaring a function, which is an extended
+           interface for the functions inherited from it"""
+        if ((self.base is not None) and (fn.name in self.base.functions)):
+            return (self.base.get_owner(fn))
+        return (self)
+
+    def inherit_functions (self):
+        """Put the functions of the extended interface, already resolved,
+           before the functions declared by this one"""
+        functions = OrderedDict(self.base.functions)
+        for fn in self.functions.viewvalues():
+            if (fn.name in functions):
+                raise ParseError("""
+                                 Function {} of {} already declared by the
+                                 interface it extends""".format(fn.name,
+                                                                self.name))
+            functions[fn.name] = fn
+        self.functions = functions
+
 class ClassObj:
     """Objects to store classes"""
 
@@ -149,23 +518,70 @@ class ClassObj:
         """Initialize the class with the given name"""
         self.name = name
         self.interfaces = []
+        self.trivial_destroy = False
+        self.lazy_data = False
+        # Interface name -> names of the BATCH functions the class implements
+        self.batch_fns = {}
+        # Interface name -> function name -> CPU features of its versions
+        self.versions = {}
 
     def __repr__ (self):
-        return "{} (name={}, interfaces={})".format(
+        return ("{} (name={}, interfaces={}, trivial_destroy={}, " + \
+                "lazy_data={}, batch_fns={}, versions={})").format(
                    self.__class__.__name__,
-                   self.name, self.interfaces)
+                   self.name, self.interfaces, self.trivial_destroy,
+                   self.lazy_data, self.batch_fns, self.versions)
 
     def add_interface (self, interface_name):
         """Add an interface list for the class. Duplicates are removed
-           automatically."""
-        self.interfaces.append(interface_name)
-        self.interfaces = list(set(self.interfaces))
+           automatically and declaration order is kept."""
+        if (interface_name not in self.interfaces):
+            self.interfaces.append(interface_name)
+
+    def add_batch_function (self, interface_name, function_name):
+        """Add a BATCH function of an interface implemented by the class"""
+        self.batch_fns.setdefault(interface_name, []).append(function_name)
+
+    def implements_batch (self, intf, fn):
+        """Indicates whether the class implements the batch version of a
+           function rather than using the generated loop"""
+        return (fn.name in self.batch_fns.get(intf.name, []))
+
+    def add_versions (self, interface_name, function_name, features):
+        """Add versions of a method for CPU features, best first"""
+        self.versions.setdefault(interface_name, OrderedDict())[
+            function_name] = features
+
+    def get_versions (self, intf, fn):
+        """Get the CPU features the method has versions for, best first"""
+        return (self.versions.get(intf.name, {}).get(fn.name, []))
+
+    def get_method_name (self, intf, fn):
+        """Get the name of the function implementing a method, which picks
+           the version of the method if it has several.  Methods inherited
+           by the interface are named after the interface declaring them."""
+        return ("{}_{}_{}{}".format(self.name, intf.get_owner(fn).name,
+                    fn.name,
+                    "_best" if len(self.get_versions(intf, fn)) > 0 else ""))
+
+    def get_casts (self):
+        """Get the (interface, implemented interface embedding it) of each
+           interface objects of the class can be cast to, including the ones
+           extended by the implemented interfaces"""
+        return [(ancestor, intf) for intf in self.interfaces
+                for ancestor in intf.get_ancestors()]
+
+# Queue capacity of ASYNC interfaces without an explicit one
+default_async_capacity = 1024
+
+# Queue capacity of SHM_PROXY interfaces without an explicit one
+default_shm_capacity = 256
 
 def get_c_indentifier (input_str):
     # Give it our best shot, won't get everything like function pointers
     # and va_args, but gets most common stuff.
     ret_val = ""
-    p_c_id = re.compile(r'^.*\W([a-zA-Z]\w+)(?:\[\w*\])*\s*$')
+    p_c_id = re.compile(r'^.*\W([a-zA-Z_]\w*)(?:\[\w*\])*\s*$')
     m = p_c_id.match(input_str)
     if (m is not None):
         ret_val = m.group(1)
@@ -177,6 +593,22 @@ def get_c_indentifier (input_str):
     return ret_val
 
 
+def get_member_decl (input_str):
+    """Get the declaration of a struct member copying an input, without the
+       qualifiers of the input itself (const int n, char *const s) which
+       would forbid assigning the member"""
+    star = input_str.rfind("*")
+    if (star < 0):
+        return (re.sub(r'\b(?:const|volatile)\b\s*', '', input_str))
+    return (input_str[:star + 1] +
+            re.sub(r'\b(?:const|volatile)\b\s*', '', input_str[star + 1:]))
+
+
+def get_feature_suffix (feature):
+    """Get the suffix of the version of a method for a CPU feature, e.g.
+       sse4_2 for sse4.2"""
+    return (re.sub(r'\W', '_', feature))
+
 def get_log_lines (raw_data):
     """Generator to join all lines with the continuation character '\'
     
@@ -196,11 +628,14 @@ class ParsedData:
     """Stores all the data parsed from the file into appropriate data
        structures and objects."""
 
-    def __init__ (self, intf_dict, class_dict, author=None, license=None):
+    def __init__ (self, intf_dict, class_dict, author=None, license=None,
+                  imports=None):
         self.author = author
         self.license = license
         self.intf_dict = intf_dict
         self.class_dict = class_dict
+        self.imports = imports if imports is not None else []
+        self.imported_intf_dict = OrderedDict()
 
 class Author:
     """Stores author info."""
@@ -233,8 +668,9 @@ class ParseError (Exception):
 def get_interface_objects (lines):
     """Get the dicts of interface and class objects from the file"""
 
-    if_dict = {}
-    class_dict = {}
+    # Ordered so the generated files follow the declaration order
+    if_dict = OrderedDict()
+    class_dict = OrderedDict()
     cur_if_obj = None
     cur_fn_obj = None
     cur_class_obj = None
@@ -243,17 +679,27 @@ def get_interface_objects (lines):
     cur_impl_name = None
     author_obj = None
     license_obj = None
+    imports = []
     in_block = False
 
-    p_if_start = re.compile(r'\s*INTERFACE\s+(\S+)\s*$')
+    p_if_start = re.compile(r'\s*INTERFACE\s+(\S+)(?:\s+EXTENDS\s+(\S+))?\s*$')
     p_if_end = re.compile(r'\s*END INTERFACE\s*$')
     p_fn_start = re.compile(r'\s*FUNCTION\s+(\S+)\s*$')
     p_fn_end = re.compile(r'\s*END FUNCTION\s*$')
     p_ret = re.compile(r'\s*RETURN\s+(\S+)\s*$')
     p_input = re.compile(r'\s*INPUT\s+(\S+.*)$')
     p_include = re.compile(r'\s*INCLUDE\s+(\S+)\s*$')
+    p_import = re.compile(r'\s*IMPORT\s+"([^"]+)"\s*$')
+    p_async = re.compile(r'\s*ASYNC(?:\s+(\d+))?\s*$')
+    p_shm = re.compile(r'\s*SHM_PROXY(?:\s+(\d+))?\s*$')
+    p_threadsafe = re.compile(r'\s*THREADSAFE\s*$')
+    p_readonly = re.compile(r'\s*READONLY\s*$')
     p_class_start = re.compile(r'\s*CLASS\s+(\S+)\s*$')
     p_class_end = re.compile(r'\s*END CLASS\s*$')
+    p_trivial_destroy = re.compile(r'\s*TRIVIAL_DESTROY\s*$')
+    p_lazy_data = re.compile(r'\s*LAZY_DATA\s*$')
+    p_batch = re.compile(r'\s*BATCH(?:\s+(\S+))?\s*$')
+    p_multiversion = re.compile(r'\s*MULTIVERSION\s+(\S+)((?:\s+\S+)+)\s*$')
     p_implements_start = re.compile(r'\s*IMPLEMENTS\s+(\S+)\s*$')
     p_implements_end = re.compile(r'\s*END IMPLEMENTS\s*$')
     p_author_start = re.compile(r'\s*AUTHOR\s*$')
@@ -291,6 +737,7 @@ def get_interface_objects (lines):
                                  Duplicate interface statement:
                                  {}""".format(line))
             cur_if_obj = Interface(m.group(1))
+            cur_if_obj.base_name = m.group(2)
             if_dict[cur_if_obj.name] = cur_if_obj
             continue
 
@@ -300,11 +747,37 @@ def get_interface_objects (lines):
                 raise ParseError("""
                                  Invalid interface statement:
                                  {}""".format(line))
-            # Add a delete function to all interfaces
-            fn = Function("delete")
-            fn.return_type = "void"
-            fn.add_input("void")
-            cur_if_obj.add_function(fn)
+            if (cur_if_obj.is_async()):
+                # Arguments are copied into the queue by assignment
+                for fn in cur_if_obj.functions.viewvalues():
+                    if any("[" in input for input in fn.inputs):
+                        raise ParseError("""
+                                         Array inputs are not supported by
+                                         async interfaces, use a pointer:
+                                         {}""".format(fn.name))
+            if (cur_if_obj.is_shm()):
+                # Only values can be passed to another process
+                for fn in cur_if_obj.functions.viewvalues():
+                    if (not all(is_scalar_input(input)
+                                for input in fn.inputs) or
+                        not is_scalar_input(fn.return_type)):
+                        raise ParseError("""
+                                         Pointers cannot be passed to another
+                                         process by shared memory proxies:
+                                         {}""".format(fn.name))
+            if ((cur_if_obj.base_name is not None) and
+                (cur_if_obj.is_async() or cur_if_obj.is_shm())):
+                raise ParseError("""
+                                 Proxies are not supported by interfaces
+                                 extending another:
+                                 {}""".format(cur_if_obj.name))
+            # Add a delete function to all interfaces, inherited by those
+            # extending another
+            if (cur_if_obj.base_name is None):
+                fn = Function("delete")
+                fn.return_type = "void"
+                fn.add_input("void")
+                cur_if_obj.add_function(fn)
             cur_if_obj = None
             continue
 
@@ -317,6 +790,63 @@ def get_interface_objects (lines):
             cur_if_obj.add_include(m.group(1))
             continue
 
+        m = p_async.match(line)
+        if (m is not None):
+            if (cur_if_obj is None or cur_fn_obj is not None):
+                raise ParseError("""
+                                 Invalid async statement:
+                                 {}""".format(line))
+            cur_if_obj.async_capacity = default_async_capacity
+            if (m.group(1) is not None):
+                cur_if_obj.async_capacity = int(m.group(1))
+            if (cur_if_obj.async_capacity < 1):
+                raise ParseError("""
+                                 Invalid async capacity:
+                                 {}""".format(line))
+            continue
+
+        m = p_shm.match(line)
+        if (m is not None):
+            if (cur_if_obj is None or cur_fn_obj is not None):
+                raise ParseError("""
+                                 Invalid shared memory proxy statement:
+                                 {}""".format(line))
+            cur_if_obj.shm_capacity = default_shm_capacity
+            if (m.group(1) is not None):
+                cur_if_obj.shm_capacity = int(m.group(1))
+            if (cur_if_obj.shm_capacity < 1):
+                raise ParseError("""
+                                 Invalid shared memory proxy capacity:
+                                 {}""".format(line))
+            continue
+
+        m = p_threadsafe.match(line)
+        if (m is not None):
+            if (cur_if_obj is None or cur_fn_obj is not None):
+                raise ParseError("""
+                                 Invalid threadsafe statement:
+                                 {}""".format(line))
+            cur_if_obj.threadsafe = True
+            continue
+
+        m = p_readonly.match(line)
+        if (m is not None):
+            if (cur_fn_obj is None):
+                raise ParseError("""
+                                 Invalid readonly statement:
+                                 {}""".format(line))
+            cur_fn_obj.readonly = True
+            continue
+
+        m = p_import.match(line)
+        if (m is not None):
+            if (in_block):
+                raise ParseError("""
+                                 Invalid import statement:
+                                 {}""".format(line))
+            imports.append(m.group(1))
+            continue
+
         m = p_fn_start.match(line)
         if (m is not None):
             if (cur_fn_obj is not None or cur_if_obj is None):
@@ -390,6 +920,46 @@ def get_interface_objects (lines):
             cur_class_obj = None
             continue
 
+        m = p_trivial_destroy.match(line)
+        if (m is not None):
+            if (cur_impl_name is not None or cur_class_obj is None):
+                raise ParseError("""
+                                 Invalid trivial destroy statement:
+                                 {}""".format(line))
+            cur_class_obj.trivial_destroy = True
+            continue
+
+        m = p_lazy_data.match(line)
+        if (m is not None):
+            if (cur_impl_name is not None or cur_class_obj is None):
+                raise ParseError("""
+                                 Invalid lazy data statement:
+                                 {}""".format(line))
+            cur_class_obj.lazy_data = True
+            continue
+
+        m = p_batch.match(line)
+        if (m is not None):
+            if (cur_fn_obj is not None and m.group(1) is None):
+                cur_fn_obj.batch = True
+            elif (cur_impl_name is not None and m.group(1) is not None):
+                cur_class_obj.add_batch_function(cur_impl_name, m.group(1))
+            else:
+                raise ParseError("""
+                                 Invalid batch statement:
+                                 {}""".format(line))
+            continue
+
+        m = p_multiversion.match(line)
+        if (m is not None):
+            if (cur_impl_name is None):
+                raise ParseError("""
+                                 Invalid multiversion statement:
+                                 {}""".format(line))
+            cur_class_obj.add_versions(cur_impl_name, m.group(1),
+                                       m.group(2).split())
+            continue
+
         m = p_implements_start.match(line)
         if (m is not None):
             if (cur_impl_name is not None or cur_class_obj is None):
@@ -482,24 +1052,194 @@ def get_interface_objects (lines):
                          Unknown format:
                          {}""".format(line))
 
-    # Make sure all the implemented interfaces are defined and convert
-    # the list of strings to a list of Interface objects.
+    return ParsedData(if_dict, class_dict, author_obj, license_obj, imports)
+
+def resolve_interfaces (parsed_data):
+    """Make sure all the implemented interfaces are defined, either locally or
+       by an imported file, and convert each class's list of strings to a list
+       of Interface objects."""
+
+    all_intfs = OrderedDict(parsed_data.imported_intf_dict)
+    all_intfs.update(parsed_data.intf_dict)
+    resolving = []
+
+    def resolve_base (intf):
+        if ((intf.base_name is None) or (intf.base is not None)):
+            return
+        if (intf.base_name not in all_intfs):
+            raise ParseError("""
+                             Non-existent interface {} extended by {}
+                             """.format(intf.base_name, intf.name))
+        if (intf.name in resolving):
+            raise ParseError("""
+                             Circular extension of:
+                             {}""".format(intf.name))
+        resolving.append(intf.name)
+        resolve_base(all_intfs[intf.base_name])
+        resolving.pop()
+        intf.base = all_intfs[intf.base_name]
+        intf.inherit_functions()
+        # The private data of the interfaces of an object is shared, so is
+        # its lock
+        if (intf.threadsafe and not intf.base.threadsafe):
+            raise ParseError("""
+                             THREADSAFE interface {} extending an interface
+                             which is not""".format(intf.name))
+        intf.threadsafe = intf.base.threadsafe
+
+    for intf in all_intfs.viewvalues():
+        resolve_base(intf)
+
+    for intf in all_intfs.viewvalues():
+        if (intf.threadsafe and
+            any(fn.batch for fn in intf.functions.viewvalues())):
+            raise ParseError("""
+                             BATCH functions are not supported by THREADSAFE
+                             interfaces:
+                             {}""".format(intf.name))
+        if (not intf.threadsafe and
+            any(fn.readonly for fn in intf.functions.viewvalues())):
+            raise ParseError("""
+                             READONLY functions need a THREADSAFE interface:
+                             {}""".format(intf.name))
+
     undefined_ifs = [] 
-    for key in class_dict.viewkeys():
+    non_batch_fns = []
+    undefined_fns = []
+    shared_ifs = []
+    for key in parsed_data.class_dict.viewkeys():
         class_ifs = []
-        for intf in class_dict[key].interfaces:
-            if intf not in if_dict.viewkeys():
-                undefined_ifs.append(intf)
+        for intf in parsed_data.class_dict[key].interfaces:
+            if intf in parsed_data.intf_dict.viewkeys():
+                class_ifs.append(parsed_data.intf_dict[intf])
+            elif intf in parsed_data.imported_intf_dict.viewkeys():
+                class_ifs.append(parsed_data.imported_intf_dict[intf])
             else:
-                class_ifs.append(if_dict[intf])
-        class_dict[key].interfaces = class_ifs
+                undefined_ifs.append(intf)
+                continue
+            for fn_name in parsed_data.class_dict[key].batch_fns.get(intf, []):
+                fn = class_ifs[-1].functions.get(fn_name)
+                if ((fn is None) or (not fn.batch)):
+                    non_batch_fns.append("{}.{}".format(intf, fn_name))
+            for fn_name in parsed_data.class_dict[key].versions.get(intf, {}):
+                if ((fn_name not in class_ifs[-1].functions) or
+                    (fn_name == "delete")):
+                    undefined_fns.append("{}.{}".format(intf, fn_name))
+        parsed_data.class_dict[key].interfaces = class_ifs
+        # Each interface is embedded once, with the ones it extends
+        ancestors = [ancestor.name for intf in class_ifs
+                     for ancestor in intf.get_ancestors()]
+        shared_ifs.extend(set(name for name in ancestors
+                              if ancestors.count(name) > 1))
 
     if (len(undefined_ifs) != 0):
         raise ParseError("""
                          Non-existent interfaces specified:
                          {}""".format(undefined_ifs))
 
-    return ParsedData(if_dict, class_dict, author_obj, license_obj)
+    if (len(shared_ifs) != 0):
+        raise ParseError("""
+                         Interfaces implemented more than once by a class,
+                         directly or through interfaces extending them:
+                         {}""".format(shared_ifs))
+
+    if (len(non_batch_fns) != 0):
+        raise ParseError("""
+                         Functions not marked BATCH in their interface:
+                         {}""".format(non_batch_fns))
+
+    if (len(undefined_fns) != 0):
+        raise ParseError("""
+                         Non-existent functions given versions:
+                         {}""".format(undefined_fns))
+
+def get_script_digest ():
+    """Digest of this script, so cached models are invalidated whenever the
+       parser changes."""
+    with open(os.path.abspath(__file__), "rb") as f:
+        return (hashlib.sha1(f.read()).hexdigest())
+
+def parse_desc_file (file_name, cache_dir=None):
+    """Parse a single description file without following its imports.  If a
+       cache directory is given, the parsed model is stored there keyed by the
+       hash of the file contents so an unchanged file is only parsed once."""
+
+    try:
+        with open(file_name, "r") as f:
+            content = f.read()
+    except IOError:
+        raise ParseError("""
+                         Could not open {}""".format(file_name))
+
+    cache_file_name = None
+    if (cache_dir is not None):
+        digest = hashlib.sha1(get_script_digest() + content).hexdigest()
+        cache_file_name = os.path.join(cache_dir, digest + ".pickle")
+        try:
+            with open(cache_file_name, "rb") as f:
+                return (pickle.load(f))
+        except Exception:
+            # Missing or unreadable cache entries are simply re-parsed
+            pass
+
+    parsed_data = get_interface_objects(
+                      get_log_lines(content.splitlines(True)))
+
+    if (cache_file_name is not None):
+        # Write to a temporary file first so concurrent runs never see a
+        # partially written entry.
+        tmp_file_name = "{}.{}.tmp".format(cache_file_name, os.getpid())
+        try:
+            if (not os.path.isdir(cache_dir)):
+                os.makedirs(cache_dir)
+            with open(tmp_file_name, "wb") as f:
+                pickle.dump(parsed_data, f, pickle.HIGHEST_PROTOCOL)
+            os.rename(tmp_file_name, cache_file_name)
+        except (IOError, OSError):
+            # The cache is only an optimization
+            if (os.path.exists(tmp_file_name)):
+                os.remove(tmp_file_name)
+
+    return (parsed_data)
+
+def load_desc_file (file_name, cache_dir=None):
+    """Parse the description file along with everything it imports.  The
+       interfaces of imported files are made available to the classes of the
+       given file through the imported_intf_dict of the returned data."""
+
+    loaded = OrderedDict()
+    loading = []
+
+    def load (path):
+        real_path = os.path.realpath(path)
+        if (real_path in loading):
+            raise ParseError("""
+                             Circular import of:
+                             {}""".format(path))
+        if (real_path in loaded):
+            return
+        loading.append(real_path)
+        data = parse_desc_file(path, cache_dir)
+        for import_name in data.imports:
+            load(os.path.join(os.path.dirname(path), import_name))
+        loading.pop()
+        loaded[real_path] = data
+
+    load(file_name)
+
+    parsed_data = loaded.pop(os.path.realpath(file_name))
+    for path in loaded.viewkeys():
+        for intf in loaded[path].intf_dict.viewvalues():
+            if (intf.name in parsed_data.intf_dict.viewkeys() or
+                intf.name in parsed_data.imported_intf_dict.viewkeys()):
+                raise ParseError("""
+                                 Duplicate interface {} imported from:
+                                 {}""".format(intf.name, path))
+            parsed_data.imported_intf_dict[intf.name] = intf
+
+    resolve_interfaces(parsed_data)
+
+    return (parsed_data)
 
 author_template_str = "@author{name}{email}"
 license_template_str ="@section LICENSE\n{license}"
@@ -514,7 +1254,21 @@ header_template_str = """\
  */
 """
 
-def write_header (file, desc_str, author=None, license=None):
+lean_header_template_str = """\
+/**
+ * @file
+ * {description}
+ */
+"""
+
+def write_header (file, desc_str, author=None, license=None, lean=False):
+
+    if (lean):
+        # Only the first sentence of the description, no author or license
+        brief = " ".join(desc_str.splitlines()).split(". ")[0].rstrip(".")
+        file.write("/* THIS IS A GENERATED FILE, DO NOT EDIT!!! */\n")
+        file.write(lean_header_template_str.format(description=brief + "."))
+        return
 
     author_str = ""
     if (author is not None):
@@ -544,637 +1298,8432 @@ def write_header (file, desc_str, author=None, license=None):
 
     file.write(header_str)
 
-def generate_interface_files (intf, parser_args, author=None, license=None):
+std_include_patterns = [
+    ("<stdbool.h>", re.compile(r'\bbool\b')),
+    ("<stdint.h>", re.compile(r'\bu?int(\d+|ptr|max)_t\b')),
+    ("<stddef.h>", re.compile(r'\b(size_t|ptrdiff_t|wchar_t)\b')),
+]
 
-    public_header_file_name = "{}/{}{}.h".format(parser_args.output_dir,
-                                                 intf.name, 
-                                                 parser_args.gen_file_suffix)
-    friend_header_file_name = \
-        "{}/{}_friend{}.h".format(parser_args.output_dir, intf.name,
-                                  parser_args.gen_file_suffix)
-    c_file_name = "{}/{}{}.c".format(parser_args.output_dir, intf.name,
-                                     parser_args.gen_file_suffix)
+def get_std_includes (intf):
+    """Get the standard headers needed for the types used in the function
+       signatures of the interface."""
+    types = []
+    for fn in intf.functions.viewvalues():
+        types.append(fn.return_type)
+        types.extend(fn.inputs)
+    return [include for (include, p) in std_include_patterns
+            if any(p.search(t) for t in types)]
+
+def write_handle_typedef (file, intf_name):
+    """Write the typedef for an interface handle, guarded so it can be
+       forward declared in several headers."""
+    file.write("""\
+#ifndef __{1}_HANDLE__
+#define __{1}_HANDLE__
+/** Opaque pointer to reference instances of the {0} interface */
+typedef struct {0}_st_ *{0}_handle;
+#endif
 
-    try:
-        f = open(public_header_file_name, "w")
-    except IOError:
-        print "ERROR: Could not open {} for writing".format(
-            public_header_file_name)
-        sys.exit(1)
+""".format(intf_name, intf_name.upper()))
 
-    # Write the public interface file
-    desc_str = "This is the public interface for " + \
-        "the {} class.".format(intf.name)
-    write_header(f, desc_str, author, license)
-    f.write("""\
-#ifndef __{0}_H__
-#define __{0}_H__
+runtime_alloc_h_str = """\
+/**
+ * Allocate size bytes of memory.  The memory does not need to be zeroed.
+ *
+ * @param ctx The context of the allocator
+ * @param size The number of bytes
+ * @return The memory or NULL on failure
+ */
+typedef void *
+(*c_intf_alloc_fn)(void *ctx, size_t size);
 
-""".format(re.sub(".h$", "", 
-        os.path.basename(public_header_file_name)).upper()))
-    f.write("#include <stdlib.h>\n")
-    f.write("#include <stdbool.h>\n")
-    f.write("#include <stdint.h>\n")
-    f.write("#include <stddef.h>\n")
-    for include in intf.includes:
-        f.write("#include {}\n".format(include))
-    f.write("\n")
-    f.write("/** Opaque pointer to reference instances of this class */\n")
-    f.write("typedef struct {0}_st_ *{0}_handle;\n\n".format(intf.name))
-    f.write("/* APIs below are documented in their implementation file */\n\n")
-    for fn in intf.functions.viewvalues():
-        f.write("extern {}\n".format(fn.return_type))
-        real_name = "{}_{}".format(intf.name, fn.name)
-        f.write("{1}({0}_handle {0}_h".format(intf.name, real_name))
-        if (not fn.is_void_input):
-            for input in fn.inputs:
-                f.write(",\n{}{} {}".format(" " * (len(real_name) + 1), 
-                                            input[0], input[1]))
-        f.write(");\n\n")
-    f.write("#endif\n")
-    f.close()
+/**
+ * Free memory returned by the matching c_intf_alloc_fn.
+ *
+ * @param ctx The context of the allocator
+ * @param ptr The memory, never NULL
+ */
+typedef void
+(*c_intf_free_fn)(void *ctx, void *ptr);
 
-    try:
-        f = open(friend_header_file_name, "w")
-    except IOError:
-        print "ERROR: Could not open {} for writing".format(
-            friend_header_file_name)
-        sys.exit(1)
+/** Allocator used for the objects of generated classes */
+typedef struct c_intf_allocator_st_ {
+    /** Allocation function */
+    c_intf_alloc_fn alloc_fn;
+    /** Free function */
+    c_intf_free_fn free_fn;
+    /** Opaque context passed to both functions */
+    void *ctx;
+} c_intf_allocator_st;
 
-    # Write the friend interface file
-    desc_str = "This is the friend interface for the " + \
-               "{} class.\n".format(intf.name) + \
-               "It should only be included by implementors of the\n" + \
-               "{} interface.".format(intf.name)
-    write_header(f, desc_str, author, license)
-    f.write("""\
-#ifndef __{0}_H__
-#define __{0}_H__
+/** The allocator using malloc() and free() */
+extern const c_intf_allocator_st c_intf_default_allocator;
 
-""".format(re.sub(".h$", "", 
-        os.path.basename(friend_header_file_name)).upper()))
-    f.write("#include \"{}\"\n\n".format(
-        os.path.basename(public_header_file_name)))
-    f.write("/** Opaque pointer to reference private data for the class */\n")
-    f.write("typedef struct {0}_private_st_ *{0}_private_handle;\n\n".format(
-                intf.name))
-    f.write("/** Friend accessible data for this class */\n" + \
-            "typedef struct {}_st_ {{\n".format(intf.name) + \
-            "    /** Reference to private data */\n" + \
-            "    {}_private_handle private_h;\n".format(intf.name) + \
-            "}} {}_st;\n\n".format(intf.name))
-    for fn in intf.functions.viewvalues():
-        f.write("/**\n" + \
-                " * Virtual function declaration.\n" + \
-                " */\n")
-        f.write("typedef {}\n".format(fn.return_type))
-        real_name = "(*{}_{}_fn)".format(intf.name, fn.name)
-        f.write("{1}({0}_handle {0}_h".format(intf.name, real_name))
-        if (not fn.is_void_input):
-            for input in fn.inputs:
-                f.write(",\n{}{} {}".format(" " * (len(real_name) + 1), 
-                                            input[0], input[1]))
-        f.write(");\n\n")
+/* APIs below are documented in their implementation file */
 
-    f.write("/**\n" + \
-            " * The virtual table to be specified by friend classes.\n" + \
-            " *\n" + \
-            " * @see {}_set_vtable()\n".format(intf.name) + \
-            " */\n");
-    f.write("typedef struct {}_vtable_st_ {{\n".format(intf.name))
-    for fn in intf.functions.viewvalues():
-        f.write("    /** Virtual function */\n" + \
-                "    {0}_{1}_fn {1}_fn;\n".format(intf.name, fn.name))
-    f.write("}} {}_vtable_st;\n\n".format(intf.name))
-    f.write("/* APIs below are documented in their implementation file */\n\n")
-    set_vtable_fn_name = "{}_set_vtable".format(intf.name)
-    f.write("extern bool\n" + \
-            "{0}({1}_handle {1}_h,\n".format(set_vtable_fn_name, intf.name) + \
-            "{}{}_vtable_st *vtable);\n\n".format(
-                " " * (len(set_vtable_fn_name) + 1), intf.name))
-    f.write("extern void\n" + \
-            "{0}_friend_delete({0}_handle {0}_h);\n\n".format(intf.name))
-    f.write("extern bool\n" + \
-            "{0}_init({0}_handle {0}_h);\n\n".format(intf.name))
-    f.write("#endif\n")
-    f.close()
+extern void
+c_intf_set_allocator(const c_intf_allocator_st *allocator);
 
-    try:
-        f = open(c_file_name, "w")
-    except IOError:
-        print "ERROR: Could not open {} for writing".format(c_file_name)
-        sys.exit(1)
+extern const c_intf_allocator_st *
+c_intf_get_allocator(void);
 
-    # Write the implementation file
-    desc_str = "This is the implementation of the " + \
-               "{} interface.".format(intf.name)
-    write_header(f, desc_str, author, license)
-    f.write("#include <assert.h>\n")
-    f.write("#include \"{}\"\n\n".format(
-        os.path.basename(friend_header_file_name)))
-    f.write("/**\n" + \
-            " * Private variables which cannot be directly accessed by\n" + \
-            " * any other class including children.\n" + \
-            " */\n")
-    f.write("typedef struct {}_private_st_ {{\n".format(intf.name) + \
-            "    /** Virtual function table */\n" + \
-            "    const {}_vtable_st *vtable;\n".format(intf.name) + \
-            "}} {}_private_st;\n\n".format(intf.name))
+extern void *
+c_intf_alloc(const c_intf_allocator_st *allocator, size_t size);
 
-    f.write("""\
+extern void
+c_intf_free(const c_intf_allocator_st *allocator, void *ptr);
+
+"""
+
+runtime_alloc_c_str = """\
 /**
- * The internal function to delete a {0} object.  Upon return, the
- * object is not longer valid.
+ * Allocation function of the default allocator.
  *
- * @param {0}_h The object.  If NULL, then this function is a no-op.
- * @param free_{0}_h Indicates whether the base object should be freed
- * or not.
+ * @param ctx Unused
+ * @param size The number of bytes
+ * @return The memory or NULL on failure
+ */
+static void *
+c_intf_default_alloc (void *ctx, size_t size)
+{
+    return (malloc(size));
+}
+
+/**
+ * Free function of the default allocator.
+ *
+ * @param ctx Unused
+ * @param ptr The memory
+ */
+static void
+c_intf_default_free (void *ctx, void *ptr)
+{
+    free(ptr);
+}
+
+const c_intf_allocator_st c_intf_default_allocator = {
+    c_intf_default_alloc,
+    c_intf_default_free,
+    NULL
+};
+
+/** The allocator used by classes without one of their own */
+static const c_intf_allocator_st *c_intf_global_allocator =
+    &c_intf_default_allocator;
+
+/**
+ * Set the allocator used by all classes which have not been given their
+ * own allocator.  Objects keep the allocator they were created with.
+ *
+ * @param allocator The allocator.  If NULL, the default allocator is used.
+ */
+void
+c_intf_set_allocator (const c_intf_allocator_st *allocator)
+{
+    if (NULL == allocator) {
+        allocator = &c_intf_default_allocator;
+    }
+
+    __atomic_store_n(&c_intf_global_allocator, allocator, __ATOMIC_RELEASE);
+}
+
+/**
+ * Get the allocator used by all classes which have not been given their
+ * own allocator.
+ *
+ * @return The allocator
+ */
+const c_intf_allocator_st *
+c_intf_get_allocator (void)
+{
+    return (__atomic_load_n(&c_intf_global_allocator, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * Allocate zeroed memory from the allocator.
+ *
+ * @param allocator The allocator.  If NULL, the default allocator is used.
+ * @param size The number of bytes
+ * @return The memory or NULL on failure
+ */
+void *
+c_intf_alloc (const c_intf_allocator_st *allocator, size_t size)
+{
+    void *ptr;
+
+    if (NULL == allocator) {
+        allocator = &c_intf_default_allocator;
+    }
+
+    ptr = allocator->alloc_fn(allocator->ctx, size);
+    if (NULL != ptr) {
+        memset(ptr, 0, size);
+    }
+
+    return (ptr);
+}
+
+/**
+ * Free memory from the allocator.
+ *
+ * @param allocator The allocator the memory came from.  If NULL, the default
+ * allocator is used.
+ * @param ptr The memory.  If NULL, then this function is a no-op.
+ */
+void
+c_intf_free (const c_intf_allocator_st *allocator, void *ptr)
+{
+    if (NULL == ptr) {
+        return;
+    }
+
+    if (NULL == allocator) {
+        allocator = &c_intf_default_allocator;
+    }
+
+    allocator->free_fn(allocator->ctx, ptr);
+}
+
+"""
+
+runtime_arena_h_str = """\
+/** Opaque pointer to reference arenas */
+typedef struct c_intf_arena_st_ *c_intf_arena_handle;
+
+/** Flag to back the arena with huge pages when possible */
+#define C_INTF_ARENA_HUGEPAGES 0x1
+
+/**
+ * Function run on an object when its arena is reset or deleted.
+ *
+ * @param obj The object
+ */
+typedef void
+(*c_intf_finalize_fn)(void *obj);
+
+/* APIs below are documented in their implementation file */
+
+extern c_intf_arena_handle
+c_intf_arena_new(size_t chunk_size, unsigned int flags);
+
+extern const c_intf_allocator_st *
+c_intf_arena_get_allocator(c_intf_arena_handle arena);
+
+extern bool
+c_intf_arena_add_finalizer(c_intf_arena_handle arena,
+                           c_intf_finalize_fn finalize_fn,
+                           void *obj);
+
+extern void
+c_intf_arena_reset(c_intf_arena_handle arena);
+
+extern void
+c_intf_arena_delete(c_intf_arena_handle arena);
+
+"""
+
+runtime_arena_c_str = """\
+/** Alignment of allocations from an arena */
+#define C_INTF_ARENA_ALIGN 16
+
+/** Size of huge pages assumed when rounding arena chunks */
+#define C_INTF_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+/** A chunk of memory mapped for an arena */
+typedef struct c_intf_arena_chunk_st_ {
+    /** The next chunk */
+    struct c_intf_arena_chunk_st_ *next;
+    /** The mapped size of the chunk including this header */
+    size_t size;
+} c_intf_arena_chunk_st;
+
+/** A finalizer registered with an arena */
+typedef struct c_intf_arena_finalizer_st_ {
+    /** The previously registered finalizer */
+    struct c_intf_arena_finalizer_st_ *prev;
+    /** The function to run */
+    c_intf_finalize_fn finalize_fn;
+    /** The object to run it on */
+    void *obj;
+} c_intf_arena_finalizer_st;
+
+/** A bump allocator whose memory is released all at once */
+typedef struct c_intf_arena_st_ {
+    /** The allocator handing out memory from this arena */
+    c_intf_allocator_st allocator;
+    /** Mapped chunks, in allocation order */
+    c_intf_arena_chunk_st *chunks;
+    /** The chunk currently allocated from */
+    c_intf_arena_chunk_st *cur_chunk;
+    /** Offset of the next allocation in the current chunk */
+    size_t offset;
+    /** The size of new chunks */
+    size_t chunk_size;
+    /** Flags given at creation */
+    unsigned int flags;
+    /** The most recently registered finalizer */
+    c_intf_arena_finalizer_st *finalizers;
+} c_intf_arena_st;
+
+/**
+ * Map a new chunk of at least the given size, using huge pages if requested.
+ *
+ * @param size The minimum size of the chunk
+ * @param flags The flags of the arena
+ * @return The chunk or NULL on failure
+ */
+static c_intf_arena_chunk_st *
+c_intf_arena_map_chunk (size_t size, unsigned int flags)
+{
+    c_intf_arena_chunk_st *chunk = MAP_FAILED;
+
+    if (flags & C_INTF_ARENA_HUGEPAGES) {
+        size = (size + C_INTF_HUGEPAGE_SIZE - 1) &
+            ~((size_t) C_INTF_HUGEPAGE_SIZE - 1);
+#ifdef MAP_HUGETLB
+        chunk = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    }
+
+    if (MAP_FAILED == chunk) {
+        /* Fall back to transparent huge pages if none are reserved */
+        chunk = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == chunk) {
+            return (NULL);
+        }
+#ifdef MADV_HUGEPAGE
+        if (flags & C_INTF_ARENA_HUGEPAGES) {
+            (void) madvise(chunk, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    chunk->next = NULL;
+    chunk->size = size;
+
+    return (chunk);
+}
+
+/**
+ * Allocation function of an arena.
+ *
+ * @param ctx The arena
+ * @param size The number of bytes
+ * @return The memory or NULL on failure
+ */
+static void *
+c_intf_arena_alloc (void *ctx, size_t size)
+{
+    c_intf_arena_st *arena = ctx;
+    c_intf_arena_chunk_st *chunk;
+    size_t header_size;
+    void *ptr;
+
+    header_size = (sizeof(c_intf_arena_chunk_st) + C_INTF_ARENA_ALIGN - 1) &
+        ~((size_t) C_INTF_ARENA_ALIGN - 1);
+    size = (size + C_INTF_ARENA_ALIGN - 1) &
+        ~((size_t) C_INTF_ARENA_ALIGN - 1);
+
+    while ((NULL == arena->cur_chunk) ||
+           (arena->offset + size > arena->cur_chunk->size)) {
+        if ((NULL != arena->cur_chunk) && (NULL != arena->cur_chunk->next)) {
+            /* Reuse the chunks kept from before the last reset */
+            arena->cur_chunk = arena->cur_chunk->next;
+            arena->offset = header_size;
+            continue;
+        }
+
+        chunk = c_intf_arena_map_chunk(
+                    (header_size + size > arena->chunk_size) ?
+                    header_size + size : arena->chunk_size,
+                    arena->flags);
+        if (NULL == chunk) {
+            return (NULL);
+        }
+
+        if (NULL == arena->cur_chunk) {
+            arena->chunks = chunk;
+        } else {
+            arena->cur_chunk->next = chunk;
+        }
+        arena->cur_chunk = chunk;
+        arena->offset = header_size;
+    }
+
+    ptr = (uint8_t *) arena->cur_chunk + arena->offset;
+    arena->offset += size;
+
+    return (ptr);
+}
+
+/**
+ * Free function of an arena.  Memory is only released when the arena is
+ * reset or deleted.
+ *
+ * @param ctx The arena
+ * @param ptr The memory
+ */
+static void
+c_intf_arena_free (void *ctx, void *ptr)
+{
+}
+
+/**
+ * Create a new arena.  Arenas are not thread-safe.
+ *
+ * @param chunk_size The size of the chunks of memory mapped for the arena.
+ * Allocations bigger than this get their own chunk.
+ * @param flags C_INTF_ARENA_HUGEPAGES or 0
+ * @return The arena or NULL if creation failed
+ */
+c_intf_arena_handle
+c_intf_arena_new (size_t chunk_size, unsigned int flags)
+{
+    c_intf_arena_st *arena;
+
+    arena = calloc(1, sizeof(*arena));
+    if (NULL == arena) {
+        return (NULL);
+    }
+
+    arena->allocator.alloc_fn = c_intf_arena_alloc;
+    arena->allocator.free_fn = c_intf_arena_free;
+    arena->allocator.ctx = arena;
+    arena->chunk_size = chunk_size;
+    arena->flags = flags;
+
+    return (arena);
+}
+
+/**
+ * Get the allocator handing out memory from the arena.
+ *
+ * @param arena The arena
+ * @return The allocator or NULL if the arena is NULL
+ */
+const c_intf_allocator_st *
+c_intf_arena_get_allocator (c_intf_arena_handle arena)
+{
+    if (NULL == arena) {
+        return (NULL);
+    }
+
+    return (&(arena->allocator));
+}
+
+/**
+ * Register a function to run on an object when the arena is reset or
+ * deleted.  Finalizers run in the reverse order of registration.
+ *
+ * @param arena The arena
+ * @param finalize_fn The function
+ * @param obj The object passed to the function
+ * @return TRUE on success, FALSE otherwise
+ */
+bool
+c_intf_arena_add_finalizer (c_intf_arena_handle arena,
+                            c_intf_finalize_fn finalize_fn,
+                            void *obj)
+{
+    c_intf_arena_finalizer_st *finalizer;
+
+    if ((NULL == arena) || (NULL == finalize_fn)) {
+        return (false);
+    }
+
+    finalizer = c_intf_arena_alloc(arena, sizeof(*finalizer));
+    if (NULL == finalizer) {
+        return (false);
+    }
+
+    finalizer->prev = arena->finalizers;
+    finalizer->finalize_fn = finalize_fn;
+    finalizer->obj = obj;
+    arena->finalizers = finalizer;
+
+    return (true);
+}
+
+/**
+ * Run the finalizers of the arena.
+ *
+ * @param arena The arena
+ */
+static void
+c_intf_arena_finalize (c_intf_arena_st *arena)
+{
+    c_intf_arena_finalizer_st *finalizer;
+
+    /* Finalizers may themselves be allocated in the arena, so unlink first */
+    while (NULL != arena->finalizers) {
+        finalizer = arena->finalizers;
+        arena->finalizers = finalizer->prev;
+        finalizer->finalize_fn(finalizer->obj);
+    }
+}
+
+/**
+ * Release all the objects allocated from the arena at once.  The chunks are
+ * kept mapped for reuse.
+ *
+ * @param arena The arena.  If NULL, then this function is a no-op.
+ */
+void
+c_intf_arena_reset (c_intf_arena_handle arena)
+{
+    if (NULL == arena) {
+        return;
+    }
+
+    c_intf_arena_finalize(arena);
+    arena->cur_chunk = NULL;
+    arena->offset = 0;
+    if (NULL != arena->chunks) {
+        arena->cur_chunk = arena->chunks;
+        arena->offset = (sizeof(c_intf_arena_chunk_st) +
+                         C_INTF_ARENA_ALIGN - 1) &
+                        ~((size_t) C_INTF_ARENA_ALIGN - 1);
+    }
+}
+
+/**
+ * Delete the arena and all the objects allocated from it.
+ *
+ * @param arena The arena.  If NULL, then this function is a no-op.
+ */
+void
+c_intf_arena_delete (c_intf_arena_handle arena)
+{
+    c_intf_arena_chunk_st *chunk;
+
+    if (NULL == arena) {
+        return;
+    }
+
+    c_intf_arena_finalize(arena);
+    while (NULL != arena->chunks) {
+        chunk = arena->chunks;
+        arena->chunks = chunk->next;
+        munmap(chunk, chunk->size);
+    }
+
+    free(arena);
+}
+
+"""
+
+runtime_pool_h_str = """\
+/** Opaque pointer to reference thread pools */
+typedef struct c_intf_pool_st_ *c_intf_pool_handle;
+
+/**
+ * Function run by a thread pool on a range of items.
+ *
+ * @param ctx The context given to c_intf_pool_run()
+ * @param begin The first item
+ * @param end One past the last item
+ */
+typedef void
+(*c_intf_range_fn)(void *ctx, size_t begin, size_t end);
+
+/* APIs below are documented in their implementation file */
+
+extern c_intf_pool_handle
+c_intf_pool_new(unsigned int num_threads);
+
+extern unsigned int
+c_intf_pool_get_num_threads(c_intf_pool_handle pool);
+
+extern void
+c_intf_pool_run(c_intf_pool_handle pool, size_t n, c_intf_range_fn range_fn,
+                void *ctx);
+
+extern void
+c_intf_pool_delete(c_intf_pool_handle pool);
+
+"""
+
+runtime_pool_c_str = """\
+/** Time a chunk of items should take once the cost per item is known */
+#define C_INTF_POOL_CHUNK_NS 20000
+
+/** The items left to a worker of a thread pool */
+typedef struct c_intf_pool_worker_st_ {
+    /** Protects the range */
+    pthread_spinlock_t lock;
+    /** The next item the worker takes */
+    size_t begin;
+    /** One past the last item of the worker, thieves take from here */
+    size_t end;
+    /** The number of items the worker takes at a time */
+    size_t grain;
+    /** The thread, unused for the worker run by the caller */
+    pthread_t thread;
+    /** The pool */
+    struct c_intf_pool_st_ *pool;
+} __attribute__((aligned(64))) c_intf_pool_worker_st;
+
+/** A work-stealing thread pool */
+typedef struct c_intf_pool_st_ {
+    /** The number of workers including the caller of c_intf_pool_run() */
+    unsigned int num_workers;
+    /** The workers, the first one is run by the caller */
+    c_intf_pool_worker_st *workers;
+    /** Serializes c_intf_pool_run() */
+    pthread_mutex_t run_lock;
+    /** Protects the job generation and the shutdown flag */
+    pthread_mutex_t lock;
+    /** Signalled when a job is started or the pool is shut down */
+    pthread_cond_t cond;
+    /** Incremented for each job */
+    uint64_t generation;
+    /** Set when the pool is deleted */
+    bool shutdown;
+    /** The function of the current job */
+    c_intf_range_fn range_fn;
+    /** The context of the current job */
+    void *ctx;
+    /** The number of items of the current job not run yet */
+    size_t remaining;
+    /** The number of background workers still in the current job */
+    unsigned int busy;
+} c_intf_pool_st;
+
+/**
+ * Get the current time in nanoseconds.
+ *
+ * @return The time
+ */
+static uint64_t
+c_intf_pool_now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec);
+}
+
+/**
+ * Take the next chunk of items from the front of the range of a worker.
+ *
+ * @param worker The worker
+ * @param begin Set to the first item of the chunk
+ * @param end Set to one past the last item of the chunk
+ * @return TRUE if a chunk was taken, FALSE if the range is empty
+ */
+static bool
+c_intf_pool_take (c_intf_pool_worker_st *worker, size_t *begin, size_t *end)
+{
+    size_t count;
+
+    pthread_spin_lock(&(worker->lock));
+    count = worker->end - worker->begin;
+    if (count > worker->grain) {
+        count = worker->grain;
+    }
+    *begin = worker->begin;
+    *end = worker->begin + count;
+    worker->begin += count;
+    pthread_spin_unlock(&(worker->lock));
+
+    return (count > 0);
+}
+
+/**
+ * Steal half of the items left to another worker.  The stolen items become
+ * the range of the thief.
+ *
+ * @param pool The pool
+ * @param thief The worker stealing
+ * @return TRUE if items were stolen, FALSE if no worker had items left
+ */
+static bool
+c_intf_pool_steal (c_intf_pool_st *pool, c_intf_pool_worker_st *thief)
+{
+    c_intf_pool_worker_st *victim;
+    unsigned int start;
+    unsigned int i;
+    size_t begin = 0;
+    size_t end = 0;
+    size_t grain = 1;
+
+    /* Start with the next worker so thieves spread over the victims */
+    start = (unsigned int) (thief - pool->workers) + 1;
+    for (i = 0; i < pool->num_workers - 1; i++) {
+        victim = &(pool->workers[(start + i) % pool->num_workers]);
+
+        pthread_spin_lock(&(victim->lock));
+        if (victim->end > victim->begin) {
+            end = victim->end;
+            begin = victim->end - (victim->end - victim->begin + 1) / 2;
+            victim->end = begin;
+            grain = __atomic_load_n(&(victim->grain), __ATOMIC_RELAXED);
+        }
+        pthread_spin_unlock(&(victim->lock));
+
+        if (end > begin) {
+            pthread_spin_lock(&(thief->lock));
+            thief->begin = begin;
+            thief->end = end;
+            /* The victim's cost per item is likely the thief's too */
+            thief->grain = grain;
+            pthread_spin_unlock(&(thief->lock));
+            return (true);
+        }
+    }
+
+    return (false);
+}
+
+/**
+ * Run the items of the current job, first those of the worker and then the
+ * ones stolen from others, until no items are left.
+ *
+ * @param pool The pool
+ * @param worker The worker
+ */
+static void
+c_intf_pool_work (c_intf_pool_st *pool, c_intf_pool_worker_st *worker)
+{
+    uint64_t start_ns;
+    uint64_t elapsed_ns;
+    size_t begin;
+    size_t end;
+    size_t grain;
+
+    for (;;) {
+        while (c_intf_pool_take(worker, &begin, &end)) {
+            start_ns = c_intf_pool_now_ns();
+            pool->range_fn(pool->ctx, begin, end);
+            elapsed_ns = c_intf_pool_now_ns() - start_ns;
+
+            /* Size the next chunks from the measured cost per item */
+            grain = (elapsed_ns > 0) ?
+                (size_t) (C_INTF_POOL_CHUNK_NS * (end - begin) / elapsed_ns) :
+                (end - begin) * 2;
+            if (grain < 1) {
+                grain = 1;
+            }
+            /* Thieves read it without the lock of the worker */
+            __atomic_store_n(&(worker->grain), grain, __ATOMIC_RELAXED);
+
+            __atomic_sub_fetch(&(pool->remaining), end - begin,
+                               __ATOMIC_RELEASE);
+        }
+
+        if (0 == __atomic_load_n(&(pool->remaining), __ATOMIC_ACQUIRE)) {
+            return;
+        }
+
+        if (!c_intf_pool_steal(pool, worker)) {
+            /* Everything left is already being run by other workers */
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * The loop of the background workers of a pool.
+ *
+ * @param arg The worker
+ * @return NULL
+ */
+static void *
+c_intf_pool_thread (void *arg)
+{
+    c_intf_pool_worker_st *worker = arg;
+    c_intf_pool_st *pool = worker->pool;
+    uint64_t generation = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&(pool->lock));
+        while ((generation == pool->generation) && !pool->shutdown) {
+            pthread_cond_wait(&(pool->cond), &(pool->lock));
+        }
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&(pool->lock));
+            return (NULL);
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&(pool->lock));
+
+        c_intf_pool_work(pool, worker);
+        __atomic_sub_fetch(&(pool->busy), 1, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * Create a new work-stealing thread pool.
+ *
+ * @param num_threads The number of threads running the items of a job,
+ * including the one calling c_intf_pool_run().  If 0, the number of online
+ * CPUs is used.
+ * @return The pool or NULL if creation failed
+ */
+c_intf_pool_handle
+c_intf_pool_new (unsigned int num_threads)
+{
+    c_intf_pool_st *pool;
+    unsigned int i;
+    long num_cpus;
+
+    if (0 == num_threads) {
+        num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = (num_cpus > 0) ? (unsigned int) num_cpus : 1;
+    }
+
+    pool = calloc(1, sizeof(*pool));
+    if (NULL == pool) {
+        return (NULL);
+    }
+
+    if (0 != posix_memalign((void **) &(pool->workers),
+                            sizeof(c_intf_pool_worker_st),
+                            num_threads * sizeof(c_intf_pool_worker_st))) {
+        free(pool);
+        return (NULL);
+    }
+    memset(pool->workers, 0, num_threads * sizeof(c_intf_pool_worker_st));
+
+    pthread_mutex_init(&(pool->run_lock), NULL);
+    pthread_mutex_init(&(pool->lock), NULL);
+    pthread_cond_init(&(pool->cond), NULL);
+    for (i = 0; i < num_threads; i++) {
+        pthread_spin_init(&(pool->workers[i].lock), PTHREAD_PROCESS_PRIVATE);
+        pool->workers[i].pool = pool;
+        pool->workers[i].grain = 1;
+    }
+
+    /* The first worker is run by the caller of c_intf_pool_run() */
+    pool->num_workers = 1;
+    for (i = 1; i < num_threads; i++) {
+        if (0 != pthread_create(&(pool->workers[i].thread), NULL,
+                                c_intf_pool_thread, &(pool->workers[i]))) {
+            c_intf_pool_delete(pool);
+            return (NULL);
+        }
+        pool->num_workers++;
+    }
+
+    return (pool);
+}
+
+/**
+ * Get the number of threads of a pool, including the caller of
+ * c_intf_pool_run().
+ *
+ * @param pool The pool
+ * @return The number of threads, 1 if the pool is NULL
+ */
+unsigned int
+c_intf_pool_get_num_threads (c_intf_pool_handle pool)
+{
+    return ((NULL == pool) ? 1 : pool->num_workers);
+}
+
+/**
+ * Run a function over n items spread over the threads of the pool and
+ * return once all of them were run.  Each thread starts with an equal share
+ * of the items, takes chunks sized from the measured cost per item and, once
+ * done, steals half of the items left to another thread.
+ *
+ * @param pool The pool.  If NULL, the items are run by the caller.
+ * @param n The number of items
+ * @param range_fn The function run on ranges of items
+ * @param ctx The context passed to the function
+ */
+void
+c_intf_pool_run (c_intf_pool_handle pool, size_t n, c_intf_range_fn range_fn,
+                 void *ctx)
+{
+    c_intf_pool_worker_st *worker;
+    unsigned int i;
+
+    if (0 == n) {
+        return;
+    }
+
+    if ((NULL == pool) || (1 == pool->num_workers)) {
+        range_fn(ctx, 0, n);
+        return;
+    }
+
+    pthread_mutex_lock(&(pool->run_lock));
+
+    pool->range_fn = range_fn;
+    pool->ctx = ctx;
+    pool->remaining = n;
+    pool->busy = pool->num_workers - 1;
+    for (i = 0; i < pool->num_workers; i++) {
+        worker = &(pool->workers[i]);
+        pthread_spin_lock(&(worker->lock));
+        worker->begin = n * i / pool->num_workers;
+        worker->end = n * (i + 1) / pool->num_workers;
+        worker->grain = 1;
+        pthread_spin_unlock(&(worker->lock));
+    }
+
+    pthread_mutex_lock(&(pool->lock));
+    pool->generation++;
+    pthread_cond_broadcast(&(pool->cond));
+    pthread_mutex_unlock(&(pool->lock));
+
+    c_intf_pool_work(pool, &(pool->workers[0]));
+
+    /* Make sure no worker still looks at this job before the next one */
+    while (0 != __atomic_load_n(&(pool->busy), __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+
+    pthread_mutex_unlock(&(pool->run_lock));
+}
+
+/**
+ * Delete the pool and stop its threads.
+ *
+ * @param pool The pool.  If NULL, then this function is a no-op.
+ */
+void
+c_intf_pool_delete (c_intf_pool_handle pool)
+{
+    unsigned int i;
+
+    if (NULL == pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&(pool->lock));
+    pool->shutdown = true;
+    pthread_cond_broadcast(&(pool->cond));
+    pthread_mutex_unlock(&(pool->lock));
+
+    for (i = 1; i < pool->num_workers; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    for (i = 0; i < pool->num_workers; i++) {
+        pthread_spin_destroy(&(pool->workers[i].lock));
+    }
+    pthread_cond_destroy(&(pool->cond));
+    pthread_mutex_destroy(&(pool->lock));
+    pthread_mutex_destroy(&(pool->run_lock));
+    free(pool->workers);
+    free(pool);
+}
+
+"""
+
+runtime_shm_h_str = """\
+/** Opaque pointer to reference shared memory channels */
+typedef struct c_intf_shm_st_ *c_intf_shm_handle;
+
+/* APIs below are documented in their implementation file */
+
+extern c_intf_shm_handle
+c_intf_shm_create(const char *name, uint32_t intf_id, size_t capacity,
+                  size_t payload_size);
+
+extern c_intf_shm_handle
+c_intf_shm_open(const char *name, uint32_t intf_id, size_t payload_size);
+
+extern void
+c_intf_shm_delete(c_intf_shm_handle shm);
+
+extern void *
+c_intf_shm_call_begin(c_intf_shm_handle shm, uint32_t fn_id, size_t *pos);
+
+extern void *
+c_intf_shm_call_wait(c_intf_shm_handle shm, size_t pos);
+
+extern void
+c_intf_shm_call_end(c_intf_shm_handle shm, size_t pos);
+
+extern void *
+c_intf_shm_serve_begin(c_intf_shm_handle shm, int timeout_ms,
+                       uint32_t *fn_id);
+
+extern void
+c_intf_shm_serve_end(c_intf_shm_handle shm);
+
+"""
+
+runtime_shm_c_str = """\
+/** Identifies memory laid out as a channel */
+#define C_INTF_SHM_MAGIC 0x63696e74U
+
+/** Times a waiter checks for progress before sleeping on the futex */
+#define C_INTF_SHM_SPINS 2000
+
+/** A call in the ring of a channel, followed by its payload */
+typedef struct c_intf_shm_slot_st_ {
+    /** Sequence number used to hand the slot between processes */
+    uint64_t seq;
+    /** The function to call */
+    uint32_t fn_id;
+    /** Futex set by the server once the call was run */
+    uint32_t done;
+    /** Set by the client before it sleeps on done */
+    uint32_t waiting;
+    /** The process which reserved the slot, 0 once it is released */
+    int32_t pid;
+} c_intf_shm_slot_st;
+
+/** The start of the shared memory of a channel */
+typedef struct c_intf_shm_header_st_ {
+    /** C_INTF_SHM_MAGIC once the channel is initialized */
+    uint32_t magic;
+    /** Identifies the interface and its function signatures */
+    uint32_t intf_id;
+    /** The size of the arguments and return value of a call */
+    uint64_t payload_size;
+    /** The size of a slot including its payload */
+    uint64_t slot_size;
+    /** The number of slots minus one */
+    uint64_t mask;
+    /** Position of the next call to be queued, shared by the clients */
+    uint64_t tail __attribute__((aligned(64)));
+    /** Position of the next call to be run, only used by the server */
+    uint64_t head __attribute__((aligned(64)));
+    /** Futex incremented for each call queued */
+    uint32_t doorbell __attribute__((aligned(64)));
+    /** Set by the server before it sleeps on the doorbell */
+    uint32_t server_waiting;
+} __attribute__((aligned(64))) c_intf_shm_header_st;
+
+/** A process's view of a channel */
+typedef struct c_intf_shm_st_ {
+    /** The shared memory */
+    c_intf_shm_header_st *header;
+    /** The size of the shared memory */
+    size_t map_size;
+    /** The number of slots minus one, checked against map_size */
+    uint64_t mask;
+    /** The size of a slot, checked against map_size */
+    uint64_t slot_size;
+    /** The name of the shared memory, set if this process created it */
+    char *name;
+} c_intf_shm_st;
+
+/**
+ * Get a slot of the ring of a channel.  The layout is taken from the copy of
+ * this process, since other processes may write to the header.
+ *
+ * @param shm The channel
+ * @param pos The position
+ * @return The slot
+ */
+static c_intf_shm_slot_st *
+c_intf_shm_get_slot (c_intf_shm_st *shm, uint64_t pos)
+{
+    return ((c_intf_shm_slot_st *)
+            ((char *) shm->header + sizeof(c_intf_shm_header_st) +
+             (pos & shm->mask) * shm->slot_size));
+}
+
+/**
+ * Sleep on a futex shared between processes while it has the given value.
+ *
+ * @param addr The futex
+ * @param val The value
+ * @param timeout_ms The maximum time to sleep, negative to not time out
+ */
+static void
+c_intf_shm_futex_wait (uint32_t *addr, uint32_t val, int timeout_ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    syscall(SYS_futex, addr, FUTEX_WAIT, val,
+            (timeout_ms < 0) ? NULL : &ts, NULL, 0);
+}
+
+/**
+ * Wake the processes sleeping on a futex.
+ *
+ * @param addr The futex
+ */
+static void
+c_intf_shm_futex_wake (uint32_t *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+/**
+ * Map a channel's shared memory.
+ *
+ * @param fd The shared memory
+ * @param map_size The size of the shared memory
+ * @return The channel or NULL if mapping failed
+ */
+static c_intf_shm_st *
+c_intf_shm_map (int fd, size_t map_size)
+{
+    c_intf_shm_st *shm;
+    void *base;
+
+    base = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == base) {
+        return (NULL);
+    }
+
+    shm = calloc(1, sizeof(*shm));
+    if (NULL == shm) {
+        munmap(base, map_size);
+        return (NULL);
+    }
+    shm->header = base;
+    shm->map_size = map_size;
+
+    return (shm);
+}
+
+/**
+ * Create a channel in shared memory, to be served by the calling process.
+ *
+ * @param name The name of the shared memory, e.g. "/my_channel"
+ * @param intf_id Identifies the interface and its function signatures
+ * @param capacity The number of calls which can be queued, rounded up to a
+ * power of two
+ * @param payload_size The size of the arguments and return value of a call
+ * @return The channel or NULL if creation failed, e.g. if the name exists
+ */
+c_intf_shm_handle
+c_intf_shm_create (const char *name, uint32_t intf_id, size_t capacity,
+                   size_t payload_size)
+{
+    c_intf_shm_st *shm = NULL;
+    c_intf_shm_header_st *header;
+    size_t slot_size;
+    size_t size = 1;
+    size_t i;
+    int fd;
+
+    if ((NULL == name) || (0 == capacity)) {
+        return (NULL);
+    }
+    while (size < capacity) {
+        size <<= 1;
+    }
+    slot_size = (sizeof(c_intf_shm_slot_st) + payload_size + 63) & ~63UL;
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return (NULL);
+    }
+
+    if (0 != ftruncate(fd, sizeof(c_intf_shm_header_st) + size * slot_size)) {
+        goto err_exit;
+    }
+
+    shm = c_intf_shm_map(fd, sizeof(c_intf_shm_header_st) + size * slot_size);
+    if (NULL == shm) {
+        goto err_exit;
+    }
+
+    shm->name = strdup(name);
+    if (NULL == shm->name) {
+        goto err_exit;
+    }
+
+    shm->mask = size - 1;
+    shm->slot_size = slot_size;
+    header = shm->header;
+    header->intf_id = intf_id;
+    header->payload_size = payload_size;
+    header->slot_size = slot_size;
+    header->mask = size - 1;
+    for (i = 0; i < size; i++) {
+        c_intf_shm_get_slot(shm, i)->seq = i;
+    }
+    /* Clients may open the channel once the header is complete */
+    __atomic_store_n(&(header->magic), C_INTF_SHM_MAGIC, __ATOMIC_RELEASE);
+    close(fd);
+
+    return (shm);
+
+err_exit:
+
+    if (NULL != shm) {
+        munmap(shm->header, shm->map_size);
+        free(shm);
+    }
+    close(fd);
+    shm_unlink(name);
+
+    return (NULL);
+}
+
+/**
+ * Open a channel created by another process to make calls on it.
+ *
+ * @param name The name given to c_intf_shm_create()
+ * @param intf_id Identifies the interface and its function signatures, which
+ * must be the same as the creator's
+ * @param payload_size The size of the arguments and return value of a call,
+ * which must be the same as the creator's
+ * @return The channel or NULL if it could not be opened
+ */
+c_intf_shm_handle
+c_intf_shm_open (const char *name, uint32_t intf_id, size_t payload_size)
+{
+    c_intf_shm_st *shm;
+    c_intf_shm_header_st *header;
+    struct stat st;
+    int fd;
+
+    if (NULL == name) {
+        return (NULL);
+    }
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return (NULL);
+    }
+
+    if ((0 != fstat(fd, &st)) ||
+        ((size_t) st.st_size < sizeof(c_intf_shm_header_st))) {
+        close(fd);
+        return (NULL);
+    }
+
+    shm = c_intf_shm_map(fd, st.st_size);
+    close(fd);
+    if (NULL == shm) {
+        return (NULL);
+    }
+
+    header = shm->header;
+    if ((C_INTF_SHM_MAGIC !=
+         __atomic_load_n(&(header->magic), __ATOMIC_ACQUIRE)) ||
+        (intf_id != header->intf_id) ||
+        (payload_size != header->payload_size)) {
+        c_intf_shm_delete(shm);
+        return (NULL);
+    }
+
+    /* Read once, so the ring stays in the mapping whatever is written later */
+    shm->mask = header->mask;
+    shm->slot_size = header->slot_size;
+    if ((shm->slot_size < sizeof(c_intf_shm_slot_st) + payload_size) ||
+        (0 != (shm->slot_size & 7)) ||
+        (0 != (shm->mask & (shm->mask + 1))) ||
+        (shm->mask >= (shm->map_size - sizeof(c_intf_shm_header_st)) /
+                      shm->slot_size)) {
+        c_intf_shm_delete(shm);
+        return (NULL);
+    }
+
+    return (shm);
+}
+
+/**
+ * Unmap the channel.  If this process created it, its name is also removed,
+ * which must only be done once the clients are done with it.
+ *
+ * @param shm The channel.  If NULL, then this function is a no-op.
+ */
+void
+c_intf_shm_delete (c_intf_shm_handle shm)
+{
+    if (NULL == shm) {
+        return;
+    }
+
+    if (NULL != shm->name) {
+        shm_unlink(shm->name);
+        free(shm->name);
+    }
+    munmap(shm->header, shm->map_size);
+    free(shm);
+}
+
+/**
+ * Reserve a slot for a call, waiting while the ring is full.  The arguments
+ * are then written to the returned payload before calling
+ * c_intf_shm_call_wait().
+ *
+ * @param shm The channel
+ * @param fn_id The function to call
+ * @param pos Set to the position of the slot
+ * @return The payload of the slot
+ */
+void *
+c_intf_shm_call_begin (c_intf_shm_handle shm, uint32_t fn_id, size_t *pos)
+{
+    c_intf_shm_slot_st *slot;
+    uint64_t tail;
+    uint64_t seq;
+
+    tail = __atomic_load_n(&(shm->header->tail), __ATOMIC_RELAXED);
+    for (;;) {
+        slot = c_intf_shm_get_slot(shm, tail);
+        seq = __atomic_load_n(&(slot->seq), __ATOMIC_ACQUIRE);
+        if (seq == tail) {
+            if (__atomic_compare_exchange_n(&(shm->header->tail), &tail,
+                    tail + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if ((int64_t) (seq - tail) < 0) {
+            /* Full, wait for calls to complete */
+            sched_yield();
+            tail = __atomic_load_n(&(shm->header->tail), __ATOMIC_RELAXED);
+        } else {
+            tail = __atomic_load_n(&(shm->header->tail), __ATOMIC_RELAXED);
+        }
+    }
+
+    /* Lets the server recover the slot if this process exits */
+    __atomic_store_n(&(slot->pid), (int32_t) getpid(), __ATOMIC_RELAXED);
+    slot->fn_id = fn_id;
+    slot->done = 0;
+    slot->waiting = 0;
+    *pos = tail;
+
+    return (slot + 1);
+}
+
+/**
+ * Queue the call filled in a reserved slot and wait until the server ran it.
+ *
+ * @param shm The channel
+ * @param pos The position of the slot
+ * @return The payload of the slot, holding the return value
+ */
+void *
+c_intf_shm_call_wait (c_intf_shm_handle shm, size_t pos)
+{
+    c_intf_shm_slot_st *slot = c_intf_shm_get_slot(shm, pos);
+    c_intf_shm_header_st *header = shm->header;
+    int i;
+
+    __atomic_store_n(&(slot->seq), pos + 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&(header->doorbell), 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(header->server_waiting), __ATOMIC_SEQ_CST)) {
+        c_intf_shm_futex_wake(&(header->doorbell));
+    }
+
+    for (i = 0; i < C_INTF_SHM_SPINS; i++) {
+        if (__atomic_load_n(&(slot->done), __ATOMIC_ACQUIRE)) {
+            return (slot + 1);
+        }
+    }
+
+    __atomic_store_n(&(slot->waiting), 1, __ATOMIC_SEQ_CST);
+    while (!__atomic_load_n(&(slot->done), __ATOMIC_SEQ_CST)) {
+        c_intf_shm_futex_wait(&(slot->done), 0, -1);
+    }
+
+    return (slot + 1);
+}
+
+/**
+ * Release the slot of a call once its return value was read.
+ *
+ * @param shm The channel
+ * @param pos The position of the slot
+ */
+void
+c_intf_shm_call_end (c_intf_shm_handle shm, size_t pos)
+{
+    c_intf_shm_slot_st *slot = c_intf_shm_get_slot(shm, pos);
+
+    __atomic_store_n(&(slot->pid), 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&(slot->seq), pos + shm->mask + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Recover the slot at the head of the ring from a client which exited
+ * between c_intf_shm_call_begin() and c_intf_shm_call_end(), which would
+ * otherwise stall the channel.  A slot it reserved is skipped and a slot it
+ * did not release is released.  A client exiting before it stored its pid
+ * in the slot, or whose pid was reused, is not detected.
+ *
+ * @param shm The channel
+ * @param slot The slot at the head of the ring
+ * @return TRUE if the head moved past the slot, FALSE otherwise
+ */
+static bool
+c_intf_shm_recover_slot (c_intf_shm_st *shm, c_intf_shm_slot_st *slot)
+{
+    c_intf_shm_header_st *header = shm->header;
+    uint64_t seq;
+    int32_t pid;
+
+    pid = __atomic_load_n(&(slot->pid), __ATOMIC_ACQUIRE);
+    if ((0 == pid) || (0 == kill(pid, 0)) || (ESRCH != errno)) {
+        return (false);
+    }
+
+    seq = __atomic_load_n(&(slot->seq), __ATOMIC_ACQUIRE);
+    __atomic_store_n(&(slot->pid), 0, __ATOMIC_RELAXED);
+    if (seq == header->head) {
+        /* Reserved but never queued, so there is no call to run */
+        __atomic_store_n(&(slot->seq), header->head + shm->mask + 1,
+                         __ATOMIC_RELEASE);
+        header->head++;
+        return (true);
+    }
+    if (seq == header->head - shm->mask) {
+        /* Run on the previous lap but never released */
+        __atomic_store_n(&(slot->seq), header->head, __ATOMIC_RELEASE);
+    }
+
+    return (false);
+}
+
+/**
+ * Wait for the next call queued on a channel.  Only one thread of the
+ * process which created the channel may serve it.  If none is queued in
+ * time, the slot of a client which exited mid-call is recovered, see
+ * c_intf_shm_recover_slot().
+ *
+ * @param shm The channel
+ * @param timeout_ms The maximum time to wait, negative to not time out
+ * @param fn_id Set to the function to call
+ * @return The payload holding the arguments of the call or NULL if none was
+ * queued in time.  The return value is written to it before calling
+ * c_intf_shm_serve_end().
+ */
+void *
+c_intf_shm_serve_begin (c_intf_shm_handle shm, int timeout_ms,
+                        uint32_t *fn_id)
+{
+    c_intf_shm_header_st *header = shm->header;
+    c_intf_shm_slot_st *slot;
+    uint32_t doorbell;
+    int i;
+
+    do {
+        slot = c_intf_shm_get_slot(shm, header->head);
+        for (i = 0; i < C_INTF_SHM_SPINS; i++) {
+            if (__atomic_load_n(&(slot->seq), __ATOMIC_ACQUIRE) ==
+                header->head + 1) {
+                *fn_id = slot->fn_id;
+                return (slot + 1);
+            }
+        }
+
+        doorbell = __atomic_load_n(&(header->doorbell), __ATOMIC_SEQ_CST);
+        __atomic_store_n(&(header->server_waiting), 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&(slot->seq), __ATOMIC_SEQ_CST) !=
+            header->head + 1) {
+            c_intf_shm_futex_wait(&(header->doorbell), doorbell, timeout_ms);
+        }
+        __atomic_store_n(&(header->server_waiting), 0, __ATOMIC_RELAXED);
+
+        if (__atomic_load_n(&(slot->seq), __ATOMIC_ACQUIRE) ==
+            header->head + 1) {
+            *fn_id = slot->fn_id;
+            return (slot + 1);
+        }
+    } while (c_intf_shm_recover_slot(shm, slot));
+
+    return (NULL);
+}
+
+/**
+ * Complete the call returned by c_intf_shm_serve_begin() and wake its
+ * client.
+ *
+ * @param shm The channel
+ */
+void
+c_intf_shm_serve_end (c_intf_shm_handle shm)
+{
+    c_intf_shm_header_st *header = shm->header;
+    c_intf_shm_slot_st *slot = c_intf_shm_get_slot(shm, header->head);
+
+    __atomic_store_n(&(slot->done), 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(slot->waiting), __ATOMIC_SEQ_CST)) {
+        c_intf_shm_futex_wake(&(slot->done));
+    }
+    header->head++;
+}
+
+"""
+
+runtime_record_h_str = """\
+/** A recorded call, followed by its packed scalar arguments */
+typedef struct c_intf_call_record_st_ {
+    /** CLOCK_MONOTONIC time of the call in nanoseconds */
+    uint64_t timestamp_ns;
+    /** Identifies the object during the recording */
+    uint64_t object_id;
+    /** The <CLASS>_RECORD_ID of the object, 0 if not a generated class */
+    uint32_t class_id;
+    /** The <INTF>_RECORD_ID of the interface */
+    uint32_t intf_id;
+    /** The <INTF>_RECORD_<FN> of the function */
+    uint32_t fn_id;
+    /** The size of the arguments */
+    uint32_t args_size;
+} c_intf_call_record_st;
+
+/** Opaque pointer to reference recorded call logs being read */
+typedef struct c_intf_replay_st_ *c_intf_replay_handle;
+
+/** Set while calls are being recorded, checked by every interface call */
+extern bool c_intf_record_enabled;
+
+/* APIs below are documented in their implementation file */
+
+extern bool
+c_intf_record_start(const char *path, size_t max_size, size_t segment_size);
+
+extern void
+c_intf_record_stop(void);
+
+extern void
+c_intf_record_append(uint64_t object_id, uint32_t class_id, uint32_t intf_id,
+                     uint32_t fn_id, const void *args, size_t args_size);
+
+extern c_intf_replay_handle
+c_intf_replay_open(const char *path);
+
+extern bool
+c_intf_replay_next(c_intf_replay_handle replay,
+                   const c_intf_call_record_st **record,
+                   const void **args);
+
+extern uint64_t
+c_intf_replay_get_dropped(c_intf_replay_handle replay);
+
+extern void
+c_intf_replay_close(c_intf_replay_handle replay);
+
+"""
+
+runtime_record_c_str = """\
+/** Identifies call logs */
+#define C_INTF_RECORD_MAGIC 0x31434552544e4943ULL
+
+/** The start of a call log, the segments follow */
+typedef struct c_intf_record_header_st_ {
+    /** C_INTF_RECORD_MAGIC */
+    uint64_t magic;
+    /** The size of a segment */
+    uint64_t segment_size;
+    /** The number of segments which fit in the log */
+    uint64_t max_segments;
+    /** The number of segments claimed by threads */
+    uint64_t num_segments;
+    /** The number of calls not recorded because the log was full */
+    uint64_t dropped;
+} __attribute__((aligned(64))) c_intf_record_header_st;
+
+/** The start of a segment, only appended to by the thread owning it */
+typedef struct c_intf_record_segment_st_ {
+    /** The number of bytes of records in the segment */
+    uint64_t used;
+    /** The thread owning the segment */
+    uint64_t thread_id;
+} c_intf_record_segment_st;
+
+/** The log calls are being recorded to */
+static c_intf_record_header_st *c_intf_recorder;
+
+/** The size of the mapping of the log */
+static size_t c_intf_recorder_size;
+
+/** The file of the log */
+static int c_intf_recorder_fd = -1;
+
+/** Incremented for each recording so threads drop their old segments */
+static uint64_t c_intf_recorder_generation;
+
+/** The number of threads appending calls, waited for to stop recording */
+static uint64_t c_intf_record_appenders;
+
+/** The segment of the thread */
+static __thread c_intf_record_segment_st *c_intf_record_segment;
+
+/** The recording the segment of the thread belongs to */
+static __thread uint64_t c_intf_record_segment_generation;
+
+bool c_intf_record_enabled;
+
+/**
+ * Start recording the calls made on interfaces to a memory-mapped log.  Each
+ * thread appends to its own segments of the log without synchronization.
+ * Calls made once the log is full are counted but not recorded.
+ *
+ * @param path The file of the log, replaced if it exists
+ * @param max_size The maximum size of the log
+ * @param segment_size The size of the segments claimed by threads
+ * @return TRUE on success, FALSE otherwise
+ */
+bool
+c_intf_record_start (const char *path, size_t max_size, size_t segment_size)
+{
+    c_intf_record_header_st *header;
+    size_t max_segments;
+    int fd;
+
+    if ((NULL == path) || (NULL != c_intf_recorder) ||
+        (segment_size < sizeof(c_intf_record_segment_st) +
+                        sizeof(c_intf_call_record_st)) ||
+        (max_size < sizeof(c_intf_record_header_st) + segment_size)) {
+        return (false);
+    }
+    segment_size &= ~7UL;
+    max_segments = (max_size - sizeof(c_intf_record_header_st)) /
+        segment_size;
+    max_size = sizeof(c_intf_record_header_st) + max_segments * segment_size;
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return (false);
+    }
+
+    /* Sparse, so only the segments written to use disk space */
+    if (0 != ftruncate(fd, max_size)) {
+        close(fd);
+        return (false);
+    }
+
+    header = mmap(NULL, max_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == header) {
+        close(fd);
+        return (false);
+    }
+
+    header->magic = C_INTF_RECORD_MAGIC;
+    c_intf_recorder_fd = fd;
+    header->segment_size = segment_size;
+    header->max_segments = max_segments;
+    c_intf_recorder_size = max_size;
+    __atomic_add_fetch(&c_intf_recorder_generation, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&c_intf_recorder, header, __ATOMIC_RELEASE);
+    __atomic_store_n(&c_intf_record_enabled, true, __ATOMIC_RELEASE);
+
+    return (true);
+}
+
+/**
+ * Stop recording calls and trim the log to the segments used.  Other threads
+ * may keep making calls on interfaces, the calls being appended when
+ * recording stops are waited for before the log is unmapped.  Must not be
+ * called concurrently with c_intf_record_start().
+ */
+void
+c_intf_record_stop (void)
+{
+    c_intf_record_header_st *header;
+    size_t size;
+
+    header = __atomic_load_n(&c_intf_recorder, __ATOMIC_ACQUIRE);
+    if (NULL == header) {
+        return;
+    }
+
+    __atomic_store_n(&c_intf_record_enabled, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&c_intf_recorder, NULL, __ATOMIC_SEQ_CST);
+
+    /*
+     * An appender either sees the log gone or is counted here, since both
+     * sides store before they load with sequential consistency.
+     */
+    while (0 != __atomic_load_n(&c_intf_record_appenders, __ATOMIC_SEQ_CST)) {
+        sched_yield();
+    }
+
+    size = sizeof(c_intf_record_header_st) +
+        header->num_segments * header->segment_size;
+    munmap(header, c_intf_recorder_size);
+    if (0 != ftruncate(c_intf_recorder_fd, size)) {
+        /* The log is still valid, only larger */
+    }
+    close(c_intf_recorder_fd);
+    c_intf_recorder_fd = -1;
+}
+
+/**
+ * Claim a new segment of the log for the calling thread.
+ *
+ * @param header The log
+ * @return The segment or NULL if the log is full
+ */
+static c_intf_record_segment_st *
+c_intf_record_claim_segment (c_intf_record_header_st *header)
+{
+    c_intf_record_segment_st *segment;
+    uint64_t index;
+
+    index = __atomic_fetch_add(&(header->num_segments), 1, __ATOMIC_RELAXED);
+    if (index >= header->max_segments) {
+        /* Keep the count at the number of segments actually in the log */
+        __atomic_fetch_sub(&(header->num_segments), 1, __ATOMIC_RELAXED);
+        return (NULL);
+    }
+
+    segment = (c_intf_record_segment_st *)
+        ((char *) header + sizeof(c_intf_record_header_st) +
+         index * header->segment_size);
+    segment->thread_id = (uint64_t) syscall(SYS_gettid);
+
+    return (segment);
+}
+
+/**
+ * Append a call to the segment of the calling thread.  This is called by the
+ * generated interface functions while c_intf_record_enabled is set.
+ *
+ * @param object_id Identifies the object
+ * @param class_id Identifies the class of the object
+ * @param intf_id Identifies the interface
+ * @param fn_id Identifies the function
+ * @param args The packed scalar arguments of the call
+ * @param args_size The size of the arguments
+ */
+void
+c_intf_record_append (uint64_t object_id, uint32_t class_id, uint32_t intf_id,
+                      uint32_t fn_id, const void *args, size_t args_size)
+{
+    c_intf_record_header_st *header;
+    c_intf_record_segment_st *segment = c_intf_record_segment;
+    c_intf_call_record_st *record;
+    struct timespec ts;
+    uint64_t generation;
+    size_t size;
+
+    /* Keeps c_intf_record_stop() from unmapping the log until we are done */
+    __atomic_fetch_add(&c_intf_record_appenders, 1, __ATOMIC_SEQ_CST);
+    header = __atomic_load_n(&c_intf_recorder, __ATOMIC_SEQ_CST);
+    if (NULL == header) {
+        __atomic_fetch_sub(&c_intf_record_appenders, 1, __ATOMIC_RELEASE);
+        return;
+    }
+    generation = __atomic_load_n(&c_intf_recorder_generation,
+                                 __ATOMIC_RELAXED);
+
+    size = (sizeof(*record) + args_size + 7) & ~7UL;
+    if ((NULL == segment) ||
+        (c_intf_record_segment_generation != generation) ||
+        (sizeof(*segment) + segment->used + size > header->segment_size)) {
+        segment = c_intf_record_claim_segment(header);
+        if ((NULL == segment) ||
+            (sizeof(*segment) + size > header->segment_size)) {
+            __atomic_fetch_add(&(header->dropped), 1, __ATOMIC_RELAXED);
+            c_intf_record_segment = NULL;
+            __atomic_fetch_sub(&c_intf_record_appenders, 1,
+                               __ATOMIC_RELEASE);
+            return;
+        }
+        c_intf_record_segment = segment;
+        c_intf_record_segment_generation = generation;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    record = (c_intf_call_record_st *)
+        ((char *) (segment + 1) + segment->used);
+    record->timestamp_ns = (uint64_t) ts.tv_sec * 1000000000ULL +
+        (uint64_t) ts.tv_nsec;
+    record->object_id = object_id;
+    record->class_id = class_id;
+    record->intf_id = intf_id;
+    record->fn_id = fn_id;
+    record->args_size = (uint32_t) args_size;
+    if (args_size > 0) {
+        memcpy(record + 1, args, args_size);
+    }
+    segment->used += size;
+    __atomic_fetch_sub(&c_intf_record_appenders, 1, __ATOMIC_RELEASE);
+}
+
+/** A call log being read */
+typedef struct c_intf_replay_st_ {
+    /** The log */
+    const c_intf_record_header_st *header;
+    /** The size of the log */
+    size_t size;
+    /** The number of segments in the log */
+    uint64_t num_segments;
+    /** The offset of the next record of each segment */
+    uint64_t *offsets;
+} c_intf_replay_st;
+
+/**
+ * Get a segment of a call log.
+ *
+ * @param replay The log
+ * @param index The index of the segment
+ * @return The segment
+ */
+static const c_intf_record_segment_st *
+c_intf_replay_get_segment (c_intf_replay_st *replay, uint64_t index)
+{
+    return ((const c_intf_record_segment_st *)
+            ((const char *) replay->header +
+             sizeof(c_intf_record_header_st) +
+             index * replay->header->segment_size));
+}
+
+/**
+ * Open a call log written by c_intf_record_start() to read its calls.
+ *
+ * @param path The file of the log
+ * @return The log or NULL if it could not be opened
+ */
+c_intf_replay_handle
+c_intf_replay_open (const char *path)
+{
+    c_intf_replay_st *replay;
+    const c_intf_record_header_st *header;
+    struct stat st;
+    uint64_t i;
+    int fd;
+
+    if (NULL == path) {
+        return (NULL);
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return (NULL);
+    }
+
+    if ((0 != fstat(fd, &st)) ||
+        ((size_t) st.st_size < sizeof(c_intf_record_header_st))) {
+        close(fd);
+        return (NULL);
+    }
+
+    header = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == header) {
+        return (NULL);
+    }
+
+    if ((C_INTF_RECORD_MAGIC != header->magic) ||
+        (sizeof(c_intf_record_header_st) +
+         header->num_segments * header->segment_size > (size_t) st.st_size)) {
+        munmap((void *) header, st.st_size);
+        return (NULL);
+    }
+
+    replay = calloc(1, sizeof(*replay));
+    if (NULL == replay) {
+        munmap((void *) header, st.st_size);
+        return (NULL);
+    }
+    replay->header = header;
+    replay->size = st.st_size;
+    replay->num_segments = header->num_segments;
+
+    replay->offsets = calloc(replay->num_segments + 1,
+                             sizeof(*(replay->offsets)));
+    if (NULL == replay->offsets) {
+        c_intf_replay_close(replay);
+        return (NULL);
+    }
+
+    for (i = 0; i < replay->num_segments; i++) {
+        if (c_intf_replay_get_segment(replay, i)->used >
+            header->segment_size - sizeof(c_intf_record_segment_st)) {
+            c_intf_replay_close(replay);
+            return (NULL);
+        }
+    }
+
+    return (replay);
+}
+
+/**
+ * Get the next call of a log, in the order the calls were made across all
+ * the threads.
+ *
+ * @param replay The log
+ * @param record Set to the call
+ * @param args Set to the packed scalar arguments of the call
+ * @return TRUE if a call was read, FALSE at the end of the log
+ */
+bool
+c_intf_replay_next (c_intf_replay_handle replay,
+                    const c_intf_call_record_st **record, const void **args)
+{
+    const c_intf_record_segment_st *segment;
+    const c_intf_call_record_st *cur;
+    const c_intf_call_record_st *next = NULL;
+    uint64_t next_index = 0;
+    uint64_t i;
+
+    if ((NULL == replay) || (NULL == record) || (NULL == args)) {
+        return (false);
+    }
+
+    /* The records of each segment are in order, take the oldest head */
+    for (i = 0; i < replay->num_segments; i++) {
+        segment = c_intf_replay_get_segment(replay, i);
+        if (replay->offsets[i] >= segment->used) {
+            continue;
+        }
+        cur = (const c_intf_call_record_st *)
+            ((const char *) (segment + 1) + replay->offsets[i]);
+        if ((NULL == next) || (cur->timestamp_ns < next->timestamp_ns)) {
+            next = cur;
+            next_index = i;
+        }
+    }
+
+    if (NULL == next) {
+        return (false);
+    }
+
+    replay->offsets[next_index] +=
+        (sizeof(*next) + next->args_size + 7) & ~7UL;
+    *record = next;
+    *args = next + 1;
+
+    return (true);
+}
+
+/**
+ * Get the number of calls which were not recorded because the log was full.
+ *
+ * @param replay The log
+ * @return The number of calls
+ */
+uint64_t
+c_intf_replay_get_dropped (c_intf_replay_handle replay)
+{
+    return ((NULL == replay) ? 0 : replay->header->dropped);
+}
+
+/**
+ * Close a call log.
+ *
+ * @param replay The log.  If NULL, then this function is a no-op.
+ */
+void
+c_intf_replay_close (c_intf_replay_handle replay)
+{
+    if (NULL == replay) {
+        return;
+    }
+
+    munmap((void *) replay->header, replay->size);
+    free(replay->offsets);
+    free(replay);
+}
+
+"""
+
+runtime_flight_h_str = """\
+/** A call recorded by the flight recorder */
+typedef struct c_intf_flight_event_st_ {
+    /** The index of the event plus one, 0 while it is being written */
+    uint64_t seq;
+    /** The time the call started, in c_intf_flight_now() ticks */
+    uint64_t start;
+    /** The duration of the call, in c_intf_flight_now() ticks */
+    uint64_t duration;
+    /** The interface and function, e.g. "button.paint" */
+    const char *fn_name;
+    /** The class of the object, NULL if not a generated class */
+    const char *class_name;
+} c_intf_flight_event_st;
+
+/** The ring of the last calls made by a thread */
+typedef struct c_intf_flight_ring_st_ {
+    /** The number of events recorded so far */
+    uint64_t head;
+    /** The thread */
+    uint64_t thread_id;
+    /** Indicates whether a thread uses this, cleared when it exits */
+    bool in_use;
+    /** The next ring in the list of all of them */
+    struct c_intf_flight_ring_st_ *next;
+    /** The last C_INTF_FLIGHT_EVENTS events */
+    c_intf_flight_event_st events[C_INTF_FLIGHT_EVENTS];
+} c_intf_flight_ring_st;
+
+/** The ring of the thread, created on its first call */
+extern __thread c_intf_flight_ring_st *c_intf_flight_ring;
+
+/* APIs below are documented in their implementation file */
+
+extern c_intf_flight_ring_st *
+c_intf_flight_new_ring(void);
+
+extern bool
+c_intf_flight_dump(int fd);
+
+extern bool
+c_intf_flight_dump_to_file(const char *path);
+
+extern bool
+c_intf_flight_dump_on_signal(int signo, const char *path);
+
+/**
+ * Get the current time in ticks of the time stamp counter, or in
+ * nanoseconds where there is none.
+ *
+ * @return The time
+ */
+static inline uint64_t
+c_intf_flight_now (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (__builtin_ia32_rdtsc());
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec);
+#endif
+}
+
+/**
+ * Add a call to the ring of the calling thread, overwriting the oldest one.
+ *
+ * @param fn_name The interface and function
+ * @param class_name The class of the object
+ * @param start The time the call started
+ */
+static inline void
+c_intf_flight_add (const char *fn_name, const char *class_name,
+                   uint64_t start)
+{
+    c_intf_flight_ring_st *ring = c_intf_flight_ring;
+    c_intf_flight_event_st *event;
+    uint64_t end = c_intf_flight_now();
+    uint64_t head;
+
+    if (NULL == ring) {
+        ring = c_intf_flight_new_ring();
+        if (NULL == ring) {
+            return;
+        }
+    }
+
+    /* Dumps may read the ring concurrently, they skip events with a seq
+     * changed while they were copied.  The fields are stored with release
+     * rather than after a fence, which ThreadSanitizer does not support, so
+     * a dump reading one also sees the seq cleared before it. */
+    head = ring->head;
+    event = &(ring->events[head & (C_INTF_FLIGHT_EVENTS - 1)]);
+    __atomic_store_n(&(event->seq), 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&(event->start), start, __ATOMIC_RELEASE);
+    __atomic_store_n(&(event->duration), end - start, __ATOMIC_RELEASE);
+    __atomic_store_n(&(event->fn_name), fn_name, __ATOMIC_RELEASE);
+    __atomic_store_n(&(event->class_name), class_name, __ATOMIC_RELEASE);
+    __atomic_store_n(&(event->seq), head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&(ring->head), head + 1, __ATOMIC_RELEASE);
+}
+
+"""
+
+runtime_flight_c_str = """\
+__thread c_intf_flight_ring_st *c_intf_flight_ring;
+
+/** The rings of all the threads, including those which exited */
+static c_intf_flight_ring_st *c_intf_flight_rings;
+
+/** Releases the rings of threads when they exit */
+static pthread_key_t c_intf_flight_key;
+
+/** Creates c_intf_flight_key once */
+static pthread_once_t c_intf_flight_key_once = PTHREAD_ONCE_INIT;
+
+/** The time in c_intf_flight_now() ticks when the first ring was created */
+static uint64_t c_intf_flight_base_ticks;
+
+/** The CLOCK_MONOTONIC time in nanoseconds at c_intf_flight_base_ticks */
+static uint64_t c_intf_flight_base_ns;
+
+/** The file written by the signal handler */
+static char c_intf_flight_signal_path[256];
+
+/**
+ * Get the CLOCK_MONOTONIC time in nanoseconds.
+ *
+ * @return The time
+ */
+static uint64_t
+c_intf_flight_now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec);
+}
+
+/**
+ * Set the time events are dumped relative to, once.
+ */
+static void
+c_intf_flight_set_base (void)
+{
+    uint64_t expected = 0;
+
+    if (__atomic_compare_exchange_n(&c_intf_flight_base_ns, &expected,
+            c_intf_flight_now_ns(), false, __ATOMIC_RELAXED,
+            __ATOMIC_RELAXED)) {
+        __atomic_store_n(&c_intf_flight_base_ticks, c_intf_flight_now(),
+                         __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * Set the base time before main() runs, so it precedes the start of the
+ * first call recorded.
+ */
+__attribute__((constructor))
+static void
+c_intf_flight_init (void)
+{
+    c_intf_flight_set_base();
+}
+
+/**
+ * Release the ring of a thread which exited, for another thread to reuse.
+ * Its events are kept until then.
+ *
+ * @param arg The ring
+ */
+static void
+c_intf_flight_release_ring (void *arg)
+{
+    c_intf_flight_ring_st *ring = arg;
+
+    __atomic_store_n(&(ring->in_use), false, __ATOMIC_RELEASE);
+}
+
+/**
+ * Create the key releasing the rings of threads.
+ */
+static void
+c_intf_flight_create_key (void)
+{
+    (void) pthread_key_create(&c_intf_flight_key, c_intf_flight_release_ring);
+}
+
+/**
+ * Get the ring of the calling thread, reusing the one of a thread which
+ * exited if any, so threads coming and going do not add a ring each.  Called
+ * on the first call made by the thread.
+ *
+ * @return The ring or NULL if creation failed
+ */
+c_intf_flight_ring_st *
+c_intf_flight_new_ring (void)
+{
+    c_intf_flight_ring_st *ring;
+    uint64_t i;
+    bool in_use;
+
+    (void) pthread_once(&c_intf_flight_key_once, c_intf_flight_create_key);
+
+    /* In case of calls made by constructors run before c_intf_flight_init */
+    c_intf_flight_set_base();
+
+    for (ring = __atomic_load_n(&c_intf_flight_rings, __ATOMIC_ACQUIRE);
+         NULL != ring; ring = ring->next) {
+        in_use = false;
+        if (__atomic_compare_exchange_n(&(ring->in_use), &in_use, true,
+                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    if (NULL != ring) {
+        /* The events of the thread which exited are dropped rather than
+         * dumped as made by this one */
+        for (i = 0; i < C_INTF_FLIGHT_EVENTS; i++) {
+            __atomic_store_n(&(ring->events[i].seq), 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&(ring->thread_id), (uint64_t) syscall(SYS_gettid),
+                         __ATOMIC_RELEASE);
+    } else {
+        ring = calloc(1, sizeof(*ring));
+        if (NULL == ring) {
+            return (NULL);
+        }
+        ring->thread_id = (uint64_t) syscall(SYS_gettid);
+        ring->in_use = true;
+        ring->next = __atomic_load_n(&c_intf_flight_rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&c_intf_flight_rings,
+                    &(ring->next), ring, true, __ATOMIC_RELEASE,
+                    __ATOMIC_RELAXED)) {
+        }
+    }
+
+    (void) pthread_setspecific(c_intf_flight_key, ring);
+    c_intf_flight_ring = ring;
+
+    return (ring);
+}
+
+/**
+ * A buffer of JSON written to a file without allocating, so it can be used
+ * from a signal handler.
+ */
+typedef struct c_intf_flight_writer_st_ {
+    /** The file */
+    int fd;
+    /** Cleared if a write failed */
+    bool ok;
+    /** The number of bytes in the buffer */
+    size_t used;
+    /** The buffer */
+    char buf[4096];
+} c_intf_flight_writer_st;
+
+/**
+ * Write the buffer to the file.
+ *
+ * @param w The writer
+ */
+static void
+c_intf_flight_flush (c_intf_flight_writer_st *w)
+{
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < w->used) {
+        n = write(w->fd, w->buf + done, w->used - done);
+        if (n < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            w->ok = false;
+            break;
+        }
+        done += n;
+    }
+    w->used = 0;
+}
+
+/**
+ * Append a string to the buffer.
+ *
+ * @param w The writer
+ * @param s The string
+ */
+static void
+c_intf_flight_put_str (c_intf_flight_writer_st *w, const char *s)
+{
+    while ('\\0' != *s) {
+        if (w->used == sizeof(w->buf)) {
+            c_intf_flight_flush(w);
+        }
+        w->buf[w->used++] = *s++;
+    }
+}
+
+/**
+ * Append a number to the buffer, optionally as a fixed point number.
+ *
+ * @param w The writer
+ * @param value The number
+ * @param decimals The number of digits after the decimal point
+ */
+static void
+c_intf_flight_put_num (c_intf_flight_writer_st *w, uint64_t value,
+                       int decimals)
+{
+    char digits[32];
+    char *p = &(digits[sizeof(digits) - 1]);
+    int i = 0;
+
+    *p = '\\0';
+    do {
+        if ((decimals > 0) && (i == decimals)) {
+            *--p = '.';
+        }
+        *--p = '0' + (value % 10);
+        value /= 10;
+        i++;
+    } while ((0 != value) || (i <= decimals));
+    c_intf_flight_put_str(w, p);
+}
+
+/**
+ * Convert c_intf_flight_now() ticks to nanoseconds.  Both the ticks and the
+ * ratio grow with the uptime, so their product does not fit 64 bits.
+ *
+ * @param value The ticks to convert
+ * @param ns The nanoseconds elapsed during ticks
+ * @param ticks The ticks elapsed during ns
+ * @return The nanoseconds
+ */
+static uint64_t
+c_intf_flight_to_ns (uint64_t value, uint64_t ns, uint64_t ticks)
+{
+#ifdef __SIZEOF_INT128__
+    return ((uint64_t) ((unsigned __int128) value * ns / ticks));
+#else
+    return ((uint64_t) ((double) value * ns / ticks));
+#endif
+}
+
+/**
+ * Write the events of all the threads as Chrome trace JSON, which can be
+ * loaded in chrome://tracing or Perfetto.  Only async-signal-safe functions
+ * are used, so this can be called from a signal handler.
+ *
+ * @param fd The file to write to
+ * @return TRUE on success, FALSE if a write failed
+ */
+bool
+c_intf_flight_dump (int fd)
+{
+    c_intf_flight_writer_st w;
+    c_intf_flight_ring_st *ring;
+    c_intf_flight_event_st event;
+    c_intf_flight_event_st *cur;
+    uint64_t base_ticks;
+    uint64_t base_ns;
+    uint64_t ticks;
+    uint64_t ns;
+    uint64_t head;
+    uint64_t i;
+    bool first = true;
+    int pid = getpid();
+
+    w.fd = fd;
+    w.ok = true;
+    w.used = 0;
+
+    /* Ticks per nanosecond from the time elapsed since the first ring */
+    base_ns = __atomic_load_n(&c_intf_flight_base_ns, __ATOMIC_ACQUIRE);
+    base_ticks = __atomic_load_n(&c_intf_flight_base_ticks, __ATOMIC_ACQUIRE);
+    ticks = c_intf_flight_now() - base_ticks;
+    ns = c_intf_flight_now_ns() - base_ns;
+    if ((0 == ticks) || (0 == ns)) {
+        ticks = ns = 1;
+    }
+
+    c_intf_flight_put_str(&w, "{\\"traceEvents\\":[");
+    for (ring = __atomic_load_n(&c_intf_flight_rings, __ATOMIC_ACQUIRE);
+         NULL != ring; ring = ring->next) {
+        head = __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE);
+        i = (head > C_INTF_FLIGHT_EVENTS) ? head - C_INTF_FLIGHT_EVENTS : 0;
+        for (; i < head; i++) {
+            cur = &(ring->events[i & (C_INTF_FLIGHT_EVENTS - 1)]);
+            if (__atomic_load_n(&(cur->seq), __ATOMIC_ACQUIRE) != i + 1) {
+                continue;
+            }
+            event.start = __atomic_load_n(&(cur->start), __ATOMIC_ACQUIRE);
+            event.duration = __atomic_load_n(&(cur->duration),
+                                             __ATOMIC_ACQUIRE);
+            event.fn_name = __atomic_load_n(&(cur->fn_name), __ATOMIC_ACQUIRE);
+            event.class_name = __atomic_load_n(&(cur->class_name),
+                                               __ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&(cur->seq), __ATOMIC_RELAXED) != i + 1) {
+                /* Overwritten while being copied */
+                continue;
+            }
+            if (event.start < base_ticks) {
+                /* Started before the base was set */
+                event.start = base_ticks;
+            }
+
+            c_intf_flight_put_str(&w, first ? "\\n" : ",\\n");
+            first = false;
+            c_intf_flight_put_str(&w, "{\\"name\\":\\"");
+            c_intf_flight_put_str(&w, event.fn_name);
+            c_intf_flight_put_str(&w, "\\",\\"cat\\":\\"");
+            c_intf_flight_put_str(&w, (NULL == event.class_name) ?
+                                  "none" : event.class_name);
+            c_intf_flight_put_str(&w, "\\",\\"ph\\":\\"X\\",\\"ts\\":");
+            c_intf_flight_put_num(&w,
+                c_intf_flight_to_ns(event.start - base_ticks, ns, ticks), 3);
+            c_intf_flight_put_str(&w, ",\\"dur\\":");
+            c_intf_flight_put_num(&w,
+                c_intf_flight_to_ns(event.duration, ns, ticks), 3);
+            c_intf_flight_put_str(&w, ",\\"pid\\":");
+            c_intf_flight_put_num(&w, pid, 0);
+            c_intf_flight_put_str(&w, ",\\"tid\\":");
+            c_intf_flight_put_num(&w, __atomic_load_n(&(ring->thread_id),
+                                                      __ATOMIC_ACQUIRE), 0);
+            c_intf_flight_put_str(&w, "}");
+        }
+    }
+    c_intf_flight_put_str(&w, "\\n]}\\n");
+    c_intf_flight_flush(&w);
+
+    return (w.ok);
+}
+
+/**
+ * Write the events of all the threads as Chrome trace JSON to a file.  Can
+ * be called from a signal handler.
+ *
+ * @param path The file, replaced if it exists
+ * @return TRUE on success, FALSE otherwise
+ */
+bool
+c_intf_flight_dump_to_file (const char *path)
+{
+    bool rc;
+    int fd;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return (false);
+    }
+
+    rc = c_intf_flight_dump(fd);
+    close(fd);
+
+    return (rc);
+}
+
+/**
+ * The signal handler installed by c_intf_flight_dump_on_signal().
+ *
+ * @param signo The signal
+ */
+static void
+c_intf_flight_signal_handler (int signo)
+{
+    int saved_errno = errno;
+
+    (void) signo;
+    c_intf_flight_dump_to_file(c_intf_flight_signal_path);
+    errno = saved_errno;
+}
+
+/**
+ * Dump the events of all the threads to a file whenever the process gets a
+ * signal, e.g. SIGUSR1.
+ *
+ * @param signo The signal
+ * @param path The file, replaced at each dump
+ * @return TRUE on success, FALSE otherwise
+ */
+bool
+c_intf_flight_dump_on_signal (int signo, const char *path)
+{
+    struct sigaction sa;
+
+    if ((NULL == path) || (strlen(path) >= sizeof(c_intf_flight_signal_path))) {
+        return (false);
+    }
+    strcpy(c_intf_flight_signal_path, path);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = c_intf_flight_signal_handler;
+    sigemptyset(&(sa.sa_mask));
+    sa.sa_flags = SA_RESTART;
+
+    return (0 == sigaction(signo, &sa, NULL));
+}
+
+"""
+
+runtime_snap_h_str = """\
+/** Defined when classes must define <class>_data_snapshot() and revive() */
+#define C_INTF_SNAPSHOT
+
+/** Opaque pointer to reference snapshots being written */
+typedef struct c_intf_snap_writer_st_ *c_intf_snap_writer_handle;
+
+/** Opaque pointer to reference snapshots mapped in memory */
+typedef struct c_intf_snap_st_ *c_intf_snap_handle;
+
+/** Revives the objects of a class, registered with c_intf_snap_register() */
+typedef struct c_intf_snap_class_st_ {
+    /** The <CLASS>_SNAPSHOT_ID of the class */
+    uint32_t class_id;
+    /** The size of the objects of the class */
+    size_t size;
+    /**
+     * Turn the offsets of an object mapped from a snapshot back into
+     * pointers.  Returns FALSE if the object is not valid.
+     */
+    bool (*fixup)(c_intf_snap_handle snap, void *obj);
+    /** The next registered class */
+    struct c_intf_snap_class_st_ *next;
+} c_intf_snap_class_st;
+
+/* APIs below are documented in their implementation file */
+
+extern c_intf_snap_writer_handle
+c_intf_snap_writer_new(void);
+
+extern void
+c_intf_snap_writer_delete(c_intf_snap_writer_handle writer);
+
+extern size_t
+c_intf_snap_alloc(c_intf_snap_writer_handle writer, size_t size);
+
+extern void *
+c_intf_snap_at(c_intf_snap_writer_handle writer, size_t offset);
+
+extern size_t
+c_intf_snap_lookup(c_intf_snap_writer_handle writer, const void *obj);
+
+extern bool
+c_intf_snap_add_object(c_intf_snap_writer_handle writer, const void *obj,
+                       uint32_t class_id, size_t size, size_t offset);
+
+extern bool
+c_intf_snap_write(c_intf_snap_writer_handle writer, const char *path,
+                  size_t root_offset);
+
+extern void
+c_intf_snap_register(c_intf_snap_class_st *snap_class);
+
+extern c_intf_snap_handle
+c_intf_snap_open(const char *path);
+
+extern void *
+c_intf_snap_get_root(c_intf_snap_handle snap, uint32_t class_id);
+
+extern void *
+c_intf_snap_get_ptr(c_intf_snap_handle snap, size_t offset, size_t size);
+
+extern void
+c_intf_snap_close(c_intf_snap_handle snap);
+
+"""
+
+runtime_snap_c_str = """\
+/** Identifies snapshot files and their version */
+#define C_INTF_SNAP_MAGIC 0x31504e5346544e49ULL
+
+/** Alignment of the blocks of a snapshot */
+#define C_INTF_SNAP_ALIGN 16
+
+/** The start of a snapshot */
+typedef struct c_intf_snap_header_st_ {
+    /** C_INTF_SNAP_MAGIC */
+    uint64_t magic;
+    /** The size of the snapshot */
+    uint64_t size;
+    /** The offset of the root object */
+    uint64_t root_offset;
+    /** The offset of the table of objects */
+    uint64_t table_offset;
+    /** The number of objects */
+    uint64_t num_objects;
+} __attribute__((aligned(C_INTF_SNAP_ALIGN))) c_intf_snap_header_st;
+
+/** An object of a snapshot, fixed up when the snapshot is opened */
+typedef struct c_intf_snap_object_st_ {
+    /** The <CLASS>_SNAPSHOT_ID of its class */
+    uint32_t class_id;
+    /** Unused */
+    uint32_t reserved;
+    /** The size of the object */
+    uint64_t size;
+    /** The offset of the object */
+    uint64_t offset;
+} c_intf_snap_object_st;
+
+/** An entry of the index of the objects written to a snapshot */
+typedef struct c_intf_snap_index_st_ {
+    /** The object, NULL if the entry is free */
+    const void *obj;
+    /** Its offset */
+    size_t offset;
+} c_intf_snap_index_st;
+
+/** A snapshot being written */
+typedef struct c_intf_snap_writer_st_ {
+    /** The blocks written so far, starting with room for the header */
+    uint8_t *buf;
+    /** The number of bytes used in buf */
+    size_t used;
+    /** The size of buf */
+    size_t size;
+    /** The objects written */
+    c_intf_snap_object_st *objects;
+    /** The number of objects written */
+    size_t num_objects;
+    /** The size of objects */
+    size_t max_objects;
+    /** Open addressing table from written objects to their offsets */
+    c_intf_snap_index_st *index;
+    /** The number of entries of index, a power of two */
+    size_t index_size;
+} c_intf_snap_writer_st;
+
+/** A snapshot mapped in memory */
+typedef struct c_intf_snap_st_ {
+    /** The mapping */
+    uint8_t *base;
+    /** The size of the mapping */
+    size_t size;
+} c_intf_snap_st;
+
+/** The classes whose objects can be revived */
+static c_intf_snap_class_st *c_intf_snap_classes;
+
+/**
+ * Create a snapshot writer.  Objects are added to it with the
+ * <class>_snapshot() of their class.
+ *
+ * @return The writer or NULL on failure
+ */
+c_intf_snap_writer_handle
+c_intf_snap_writer_new (void)
+{
+    c_intf_snap_writer_st *writer;
+
+    writer = calloc(1, sizeof(*writer));
+    if (NULL == writer) {
+        return (NULL);
+    }
+
+    /* Offset 0 is the header, so it can mean NULL in the blocks */
+    writer->used = sizeof(c_intf_snap_header_st);
+
+    return (writer);
+}
+
+/**
+ * Delete a snapshot writer.
+ *
+ * @param writer The writer.  If NULL, this is a no-op.
+ */
+void
+c_intf_snap_writer_delete (c_intf_snap_writer_handle writer)
+{
+    if (NULL == writer) {
+        return;
+    }
+
+    free(writer->buf);
+    free(writer->objects);
+    free(writer->index);
+    free(writer);
+}
+
+/**
+ * Allocate a zeroed block in a snapshot.
+ *
+ * @param writer The writer
+ * @param size The size of the block
+ * @return The offset of the block or 0 on failure
+ */
+size_t
+c_intf_snap_alloc (c_intf_snap_writer_handle writer, size_t size)
+{
+    size_t offset;
+    size_t new_size;
+    uint8_t *buf;
+
+    if (NULL == writer) {
+        return (0);
+    }
+
+    offset = writer->used;
+    size = (size + C_INTF_SNAP_ALIGN - 1) & ~((size_t) C_INTF_SNAP_ALIGN - 1);
+    if (offset + size > writer->size) {
+        new_size = (0 == writer->size) ? 4096 : writer->size;
+        while (offset + size > new_size) {
+            new_size *= 2;
+        }
+        buf = realloc(writer->buf, new_size);
+        if (NULL == buf) {
+            return (0);
+        }
+        writer->buf = buf;
+        writer->size = new_size;
+    }
+
+    memset(writer->buf + offset, 0, size);
+    writer->used += size;
+
+    return (offset);
+}
+
+/**
+ * Get a block of a snapshot being written.  The pointer is only valid until
+ * the next allocation.
+ *
+ * @param writer The writer
+ * @param offset The offset of the block
+ * @return The block
+ */
+void *
+c_intf_snap_at (c_intf_snap_writer_handle writer, size_t offset)
+{
+    return (writer->buf + offset);
+}
+
+/**
+ * Get the slot of the index of written objects for an object.
+ *
+ * @param writer The writer
+ * @param obj The object
+ * @return The slot, with the object or free
+ */
+static size_t
+c_intf_snap_index_slot (c_intf_snap_writer_st *writer, const void *obj)
+{
+    size_t mask = writer->index_size - 1;
+    size_t i = (((uintptr_t) obj) * 0x9e3779b97f4a7c15ULL >> 17) & mask;
+
+    while ((NULL != writer->index[i].obj) && (obj != writer->index[i].obj)) {
+        i = (i + 1) & mask;
+    }
+
+    return (i);
+}
+
+/**
+ * Get the offset of an object already written to a snapshot, so objects
+ * referenced more than once are only written once.
+ *
+ * @param writer The writer
+ * @param obj The object
+ * @return The offset of the object or 0 if not written yet
+ */
+size_t
+c_intf_snap_lookup (c_intf_snap_writer_handle writer, const void *obj)
+{
+    if ((NULL == writer) || (0 == writer->index_size)) {
+        return (0);
+    }
+
+    return (writer->index[c_intf_snap_index_slot(writer, obj)].offset);
+}
+
+/**
+ * Add an object written to a snapshot, so it is revived by its class when
+ * the snapshot is opened.
+ *
+ * @param writer The writer
+ * @param obj The object written
+ * @param class_id The <CLASS>_SNAPSHOT_ID of the class of the object
+ * @param size The size of the object
+ * @param offset The offset of the block the object was written to
+ * @return TRUE on success, FALSE otherwise
+ */
+bool
+c_intf_snap_add_object (c_intf_snap_writer_handle writer, const void *obj,
+                        uint32_t class_id, size_t size, size_t offset)
+{
+    c_intf_snap_object_st *objects;
+    c_intf_snap_index_st *index;
+    size_t old_size;
+    size_t slot;
+    size_t i;
+
+    if ((NULL == writer) || (NULL == obj)) {
+        return (false);
+    }
+
+    if (writer->num_objects == writer->max_objects) {
+        objects = realloc(writer->objects,
+                          (writer->max_objects + 64) * 2 * sizeof(*objects));
+        if (NULL == objects) {
+            return (false);
+        }
+        writer->objects = objects;
+        writer->max_objects = (writer->max_objects + 64) * 2;
+    }
+
+    /* The index is kept at most half full */
+    if (2 * (writer->num_objects + 1) > writer->index_size) {
+        old_size = writer->index_size;
+        index = writer->index;
+        writer->index_size = (0 == old_size) ? 256 : old_size * 2;
+        writer->index = calloc(writer->index_size, sizeof(*writer->index));
+        if (NULL == writer->index) {
+            writer->index = index;
+            writer->index_size = old_size;
+            return (false);
+        }
+        for (i = 0; i < old_size; i++) {
+            if (NULL != index[i].obj) {
+                slot = c_intf_snap_index_slot(writer, index[i].obj);
+                writer->index[slot] = index[i];
+            }
+        }
+        free(index);
+    }
+
+    slot = c_intf_snap_index_slot(writer, obj);
+    writer->index[slot].obj = obj;
+    writer->index[slot].offset = offset;
+
+    objects = &(writer->objects[writer->num_objects++]);
+    objects->class_id = class_id;
+    objects->reserved = 0;
+    objects->size = size;
+    objects->offset = offset;
+
+    return (true);
+}
+
+/**
+ * Write a snapshot to a file.
+ *
+ * @param writer The writer
+ * @param path The file, replaced if it exists
+ * @param root_offset The offset of the object returned by
+ * c_intf_snap_get_root()
+ * @return TRUE on success, FALSE otherwise
+ */
+bool
+c_intf_snap_write (c_intf_snap_writer_handle writer, const char *path,
+                   size_t root_offset)
+{
+    c_intf_snap_header_st *header;
+    size_t table_offset;
+    size_t table_size;
+    size_t done = 0;
+    ssize_t n;
+    int fd;
+
+    if ((NULL == writer) || (NULL == path) || (0 == root_offset)) {
+        return (false);
+    }
+
+    table_size = writer->num_objects * sizeof(c_intf_snap_object_st);
+    table_offset = c_intf_snap_alloc(writer, table_size);
+    if (0 == table_offset) {
+        return (false);
+    }
+    if (0 != table_size) {
+        memcpy(writer->buf + table_offset, writer->objects, table_size);
+    }
+
+    header = (c_intf_snap_header_st *) writer->buf;
+    memset(header, 0, sizeof(*header));
+    header->magic = C_INTF_SNAP_MAGIC;
+    header->size = writer->used;
+    header->root_offset = root_offset;
+    header->table_offset = table_offset;
+    header->num_objects = writer->num_objects;
+
+    /* The table is written again if more objects are added */
+    writer->used = table_offset;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return (false);
+    }
+    while (done < header->size) {
+        n = write(fd, writer->buf + done, header->size - done);
+        if (n <= 0) {
+            if ((n < 0) && (EINTR == errno)) {
+                continue;
+            }
+            close(fd);
+            return (false);
+        }
+        done += n;
+    }
+
+    return (0 == close(fd));
+}
+
+/**
+ * Register a class whose objects can be revived from snapshots.  Generated
+ * classes register themselves before main() runs.
+ *
+ * @param snap_class The class, which must outlive its registration
+ */
+void
+c_intf_snap_register (c_intf_snap_class_st *snap_class)
+{
+    snap_class->next = c_intf_snap_classes;
+    c_intf_snap_classes = snap_class;
+}
+
+/**
+ * Map a snapshot written by c_intf_snap_write() and revive its objects in a
+ * single pass over them, turning their offsets back into pointers.  The
+ * snapshot is mapped privately, so the file is left unchanged.  The objects
+ * must not be deleted, they are released by c_intf_snap_close().
+ *
+ * @param path The file
+ * @return The snapshot or NULL if it could not be opened or is not valid
+ */
+c_intf_snap_handle
+c_intf_snap_open (const char *path)
+{
+    const c_intf_snap_header_st *header;
+    const c_intf_snap_object_st *object;
+    const c_intf_snap_class_st *snap_class = NULL;
+    c_intf_snap_st *snap;
+    struct stat st;
+    size_t i;
+    int fd;
+
+    snap = calloc(1, sizeof(*snap));
+    if (NULL == snap) {
+        return (NULL);
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        free(snap);
+        return (NULL);
+    }
+    if ((0 != fstat(fd, &st)) ||
+        ((size_t) st.st_size < sizeof(c_intf_snap_header_st))) {
+        close(fd);
+        free(snap);
+        return (NULL);
+    }
+
+    snap->size = st.st_size;
+    snap->base = mmap(NULL, snap->size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd, 0);
+    close(fd);
+    if (MAP_FAILED == snap->base) {
+        free(snap);
+        return (NULL);
+    }
+
+    header = (const c_intf_snap_header_st *) snap->base;
+    if ((C_INTF_SNAP_MAGIC != header->magic) ||
+        (header->size != snap->size) ||
+        (header->table_offset > snap->size) ||
+        (header->num_objects >
+         (snap->size - header->table_offset) / sizeof(*object)) ||
+        (0 != (header->table_offset % sizeof(uint64_t)))) {
+        goto err_exit;
+    }
+
+    object = (const c_intf_snap_object_st *)
+        (snap->base + header->table_offset);
+    for (i = 0; i < header->num_objects; i++, object++) {
+        if ((NULL == snap_class) || (snap_class->class_id != object->class_id)) {
+            for (snap_class = c_intf_snap_classes; NULL != snap_class;
+                 snap_class = snap_class->next) {
+                if (snap_class->class_id == object->class_id) {
+                    break;
+                }
+            }
+        }
+        if ((NULL == snap_class) || (snap_class->size != object->size) ||
+            (NULL == c_intf_snap_get_ptr(snap, object->offset,
+                                         object->size)) ||
+            !snap_class->fixup(snap, snap->base + object->offset)) {
+            goto err_exit;
+        }
+    }
+
+    return (snap);
+
+err_exit:
+
+    munmap(snap->base, snap->size);
+    free(snap);
+
+    return (NULL);
+}
+
+/**
+ * Get the root object of a snapshot.
+ *
+ * @param snap The snapshot
+ * @param class_id The <CLASS>_SNAPSHOT_ID of the class expected
+ * @return The object or NULL if it is not of the class expected
+ */
+void *
+c_intf_snap_get_root (c_intf_snap_handle snap, uint32_t class_id)
+{
+    const c_intf_snap_header_st *header;
+    const c_intf_snap_object_st *object;
+    size_t i;
+
+    if (NULL == snap) {
+        return (NULL);
+    }
+
+    header = (const c_intf_snap_header_st *) snap->base;
+    object = (const c_intf_snap_object_st *)
+        (snap->base + header->table_offset);
+    for (i = 0; i < header->num_objects; i++, object++) {
+        if (object->offset == header->root_offset) {
+            return ((object->class_id == class_id) ?
+                    snap->base + object->offset : NULL);
+        }
+    }
+
+    return (NULL);
+}
+
+/**
+ * Turn an offset in a snapshot back into a pointer, checking the block is
+ * in the snapshot.  Used by fixups.
+ *
+ * @param snap The snapshot
+ * @param offset The offset of the block, 0 for NULL
+ * @param size The size of the block
+ * @return The block or NULL if the offset is 0 or not valid
+ */
+void *
+c_intf_snap_get_ptr (c_intf_snap_handle snap, size_t offset, size_t size)
+{
+    if ((offset < sizeof(c_intf_snap_header_st)) || (offset > snap->size) ||
+        (size > snap->size - offset) ||
+        (0 != (offset % C_INTF_SNAP_ALIGN))) {
+        return (NULL);
+    }
+
+    return (snap->base + offset);
+}
+
+/**
+ * Close a snapshot, releasing all its objects.
+ *
+ * @param snap The snapshot.  If NULL, this is a no-op.
+ */
+void
+c_intf_snap_close (c_intf_snap_handle snap)
+{
+    if (NULL == snap) {
+        return;
+    }
+
+    munmap(snap->base, snap->size);
+    free(snap);
+}
+
+"""
+
+runtime_numa_h_str = """\
+/** The maximum number of NUMA nodes objects can be placed on */
+#define C_INTF_NUMA_MAX_NODES 64
+
+/** Place an object on the node of the CPU creating it */
+#define C_INTF_NUMA_CURRENT (-1)
+
+/** Place objects on each node in turn */
+#define C_INTF_NUMA_INTERLEAVE (-2)
+
+/* APIs below are documented in their implementation file */
+
+extern int
+c_intf_numa_get_num_nodes(void);
+
+extern int
+c_intf_numa_get_current_node(void);
+
+extern int
+c_intf_numa_resolve(int placement);
+
+extern const c_intf_allocator_st *
+c_intf_numa_get_allocator(int node);
+
+extern int
+c_intf_numa_get_node(const void *ptr);
+
+"""
+
+runtime_numa_c_str = """\
+/** The size of the memory mapped at once for the pool of a node */
+#define C_INTF_NUMA_CHUNK_SIZE (1024 * 1024)
+
+/** The granularity of the sizes of the blocks of the pools */
+#define C_INTF_NUMA_QUANTUM 16
+
+/** The number of block sizes, larger blocks are mapped on their own */
+#define C_INTF_NUMA_NUM_SIZES 64
+
+/** The start of each block, keeping the blocks aligned to 16 bytes */
+typedef struct c_intf_numa_block_st_ {
+    /** The size index of the block, C_INTF_NUMA_NUM_SIZES if mapped alone */
+    size_t size_index;
+    /** The size mapped for a block mapped alone, else the next free block */
+    union {
+        size_t map_size;
+        struct c_intf_numa_block_st_ *next;
+    } u;
+} c_intf_numa_block_st;
+
+/** The pool of blocks of a node */
+typedef struct c_intf_numa_pool_st_ {
+    /** Protects the pool */
+    int lock;
+    /** The free blocks of each size */
+    c_intf_numa_block_st *free_blocks[C_INTF_NUMA_NUM_SIZES];
+    /** The unused part of the last chunk mapped */
+    uint8_t *next;
+    /** The end of the last chunk mapped */
+    uint8_t *end;
+} __attribute__((aligned(64))) c_intf_numa_pool_st;
+
+/** The pools of the nodes */
+static c_intf_numa_pool_st c_intf_numa_pools[C_INTF_NUMA_MAX_NODES];
+
+/** The allocators of the nodes */
+static c_intf_allocator_st c_intf_numa_allocators[C_INTF_NUMA_MAX_NODES];
+
+/** The number of nodes, 0 until read */
+static int c_intf_numa_num_nodes;
+
+/** The next node of interleaved placements */
+static unsigned int c_intf_numa_next_node;
+
+/**
+ * Get the number of NUMA nodes of the machine, 1 if it is not NUMA.
+ *
+ * @return The number of nodes
+ */
+int
+c_intf_numa_get_num_nodes (void)
+{
+    char buf[256];
+    ssize_t len;
+    char *p;
+    long last = 0;
+    int num_nodes;
+    int fd;
+
+    num_nodes = __atomic_load_n(&c_intf_numa_num_nodes, __ATOMIC_RELAXED);
+    if (0 != num_nodes) {
+        return (num_nodes);
+    }
+
+    /* A list of ranges, e.g. "0-1", the last node is the highest */
+    fd = open("/sys/devices/system/node/possible", O_RDONLY);
+    if (fd >= 0) {
+        len = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        if (len > 0) {
+            buf[len] = '\\0';
+            for (p = buf; '\\0' != *p; p++) {
+                if ((*p >= '0') && (*p <= '9') &&
+                    ((p == buf) || (*(p - 1) < '0') || (*(p - 1) > '9'))) {
+                    last = strtol(p, NULL, 10);
+                }
+            }
+        }
+    }
+
+    num_nodes = (last < C_INTF_NUMA_MAX_NODES) ? (int) last + 1 :
+                                                 C_INTF_NUMA_MAX_NODES;
+    __atomic_store_n(&c_intf_numa_num_nodes, num_nodes, __ATOMIC_RELAXED);
+
+    return (num_nodes);
+}
+
+/**
+ * Get the node of the CPU the calling thread runs on.
+ *
+ * @return The node, 0 if it cannot be found
+ */
+int
+c_intf_numa_get_current_node (void)
+{
+    unsigned int cpu;
+    unsigned int node;
+
+    if ((0 != syscall(SYS_getcpu, &cpu, &node, NULL)) ||
+        (node >= (unsigned int) c_intf_numa_get_num_nodes())) {
+        return (0);
+    }
+
+    return ((int) node);
+}
+
+/**
+ * Get the node an object is placed on.
+ *
+ * @param placement A node, C_INTF_NUMA_CURRENT or C_INTF_NUMA_INTERLEAVE
+ * @return The node or -1 if there is no such node
+ */
+int
+c_intf_numa_resolve (int placement)
+{
+    int num_nodes = c_intf_numa_get_num_nodes();
+
+    if (C_INTF_NUMA_CURRENT == placement) {
+        return (c_intf_numa_get_current_node());
+    }
+    if (C_INTF_NUMA_INTERLEAVE == placement) {
+        return ((int) (__atomic_fetch_add(&c_intf_numa_next_node, 1,
+                                          __ATOMIC_RELAXED) % num_nodes));
+    }
+    if ((placement < 0) || (placement >= num_nodes)) {
+        return (-1);
+    }
+
+    return (placement);
+}
+
+/**
+ * Map memory preferably backed by the pages of a node.  If the memory policy
+ * cannot be set, e.g. without NUMA support, the memory is used anyway.
+ *
+ * @param node The node
+ * @param size The size to map
+ * @return The memory or NULL on failure
+ */
+static void *
+c_intf_numa_map (int node, size_t size)
+{
+    unsigned long nodemask[C_INTF_NUMA_MAX_NODES / (8 * sizeof(long))];
+    void *ptr;
+
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == ptr) {
+        return (NULL);
+    }
+
+    /* The pages are allocated on the node when first touched */
+    memset(nodemask, 0, sizeof(nodemask));
+    nodemask[node / (8 * sizeof(long))] = 1UL << (node % (8 * sizeof(long)));
+    (void) syscall(SYS_mbind, ptr, size, MPOL_PREFERRED, nodemask,
+                   C_INTF_NUMA_MAX_NODES + 1, 0);
+
+    return (ptr);
+}
+
+/**
+ * Allocation function of the node allocators.
+ *
+ * @param ctx The pool of the node
+ * @param size The number of bytes
+ * @return The memory or NULL on failure
+ */
+static void *
+c_intf_numa_alloc (void *ctx, size_t size)
+{
+    c_intf_numa_pool_st *pool = ctx;
+    c_intf_numa_block_st *block;
+    int node = (int) (pool - c_intf_numa_pools);
+    size_t size_index;
+    size_t block_size;
+
+    size_index = (size + C_INTF_NUMA_QUANTUM - 1) / C_INTF_NUMA_QUANTUM;
+    if (size_index >= C_INTF_NUMA_NUM_SIZES) {
+        block_size = sizeof(*block) + size;
+        block = c_intf_numa_map(node, block_size);
+        if (NULL == block) {
+            return (NULL);
+        }
+        block->size_index = C_INTF_NUMA_NUM_SIZES;
+        block->u.map_size = block_size;
+        return (block + 1);
+    }
+    block_size = sizeof(*block) + size_index * C_INTF_NUMA_QUANTUM;
+
+    while (__atomic_exchange_n(&(pool->lock), 1, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+
+    block = pool->free_blocks[size_index];
+    if (NULL != block) {
+        pool->free_blocks[size_index] = block->u.next;
+    } else {
+        if ((size_t) (pool->end - pool->next) < block_size) {
+            /* The rest of the chunk is left unused */
+            pool->next = c_intf_numa_map(node, C_INTF_NUMA_CHUNK_SIZE);
+            if (NULL == pool->next) {
+                pool->end = NULL;
+                __atomic_store_n(&(pool->lock), 0, __ATOMIC_RELEASE);
+                return (NULL);
+            }
+            pool->end = pool->next + C_INTF_NUMA_CHUNK_SIZE;
+        }
+        block = (c_intf_numa_block_st *) pool->next;
+        pool->next += block_size;
+    }
+
+    __atomic_store_n(&(pool->lock), 0, __ATOMIC_RELEASE);
+
+    block->size_index = size_index;
+
+    return (block + 1);
+}
+
+/**
+ * Free function of the node allocators.
+ *
+ * @param ctx The pool of the node
+ * @param ptr The memory
+ */
+static void
+c_intf_numa_free (void *ctx, void *ptr)
+{
+    c_intf_numa_block_st *block = (c_intf_numa_block_st *) ptr - 1;
+    c_intf_numa_pool_st *pool = ctx;
+
+    if (C_INTF_NUMA_NUM_SIZES == block->size_index) {
+        munmap(block, block->u.map_size);
+        return;
+    }
+
+    while (__atomic_exchange_n(&(pool->lock), 1, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+    block->u.next = pool->free_blocks[block->size_index];
+    pool->free_blocks[block->size_index] = block;
+    __atomic_store_n(&(pool->lock), 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Get the allocator of the pool of a node.  Freed blocks are reused for
+ * blocks of the same size on the same node.
+ *
+ * @param node The node
+ * @return The allocator or NULL if there is no such node
+ */
+const c_intf_allocator_st *
+c_intf_numa_get_allocator (int node)
+{
+    c_intf_allocator_st *allocator;
+
+    if ((node < 0) || (node >= c_intf_numa_get_num_nodes())) {
+        return (NULL);
+    }
+
+    /* Setting the functions again from another thread is harmless */
+    allocator = &(c_intf_numa_allocators[node]);
+    if (NULL == __atomic_load_n(&(allocator->alloc_fn), __ATOMIC_ACQUIRE)) {
+        allocator->ctx = &(c_intf_numa_pools[node]);
+        allocator->free_fn = c_intf_numa_free;
+        __atomic_store_n(&(allocator->alloc_fn), c_intf_numa_alloc,
+                         __ATOMIC_RELEASE);
+    }
+
+    return (allocator);
+}
+
+/**
+ * Get the node the memory of an object is on.
+ *
+ * @param ptr The object
+ * @return The node or -1 if it cannot be found
+ */
+int
+c_intf_numa_get_node (const void *ptr)
+{
+    void *page = (void *) ((uintptr_t) ptr & ~((uintptr_t) getpagesize() - 1));
+    int status = -1;
+
+    if ((NULL == ptr) ||
+        (0 != syscall(SYS_move_pages, 0, 1UL, &page, NULL, &status, 0)) ||
+        (status < 0)) {
+        return (-1);
+    }
+
+    return (status);
+}
+
+"""
+
+runtime_mem_h_str = """\
+/** Defined when classes must define <class>_data_size() */
+#define C_INTF_MEM_STATS
+
+/** The number of buckets of the histograms of object lifetimes */
+#define C_INTF_MEM_LIFETIME_BUCKETS 64
+
+/** The memory usage of a class */
+typedef struct c_intf_mem_class_st_ {
+    /** The name of the class */
+    const char *name;
+    /** The number of live objects */
+    size_t live;
+    /** The highest number of live objects */
+    size_t peak_live;
+    /** The bytes held by the live objects */
+    size_t bytes;
+    /** The highest number of bytes held */
+    size_t peak_bytes;
+    /** The number of objects created */
+    uint64_t created;
+    /** The number of objects deleted */
+    uint64_t deleted;
+    /** The number of objects deleted by log2 of their lifetime in ns */
+    uint64_t lifetimes[C_INTF_MEM_LIFETIME_BUCKETS];
+    /** The number of objects created at the previous report */
+    uint64_t reported_created;
+    /** The next registered class */
+    struct c_intf_mem_class_st_ *next;
+} c_intf_mem_class_st;
+
+/* APIs below are documented in their implementation file */
+
+extern void
+c_intf_mem_register(c_intf_mem_class_st *mem_class);
+
+extern uint64_t
+c_intf_mem_now(void);
+
+extern void
+c_intf_mem_add_object(c_intf_mem_class_st *mem_class, size_t bytes);
+
+extern void
+c_intf_mem_add_bytes(c_intf_mem_class_st *mem_class, size_t bytes);
+
+extern void
+c_intf_mem_remove_object(c_intf_mem_class_st *mem_class, size_t bytes,
+                         uint64_t created_ns);
+
+extern void
+c_intf_mem_report(int fd);
+
+"""
+
+runtime_mem_c_str = """\
+/** The registered classes */
+static c_intf_mem_class_st *c_intf_mem_classes;
+
+/** The time of the previous report, or of the first registration */
+static uint64_t c_intf_mem_reported_ns;
+
+/**
+ * Register a class whose memory usage is reported by c_intf_mem_report().
+ * Generated classes register themselves before main() runs.
+ *
+ * @param mem_class The class, which must outlive its registration
+ */
+void
+c_intf_mem_register (c_intf_mem_class_st *mem_class)
+{
+    if (0 == c_intf_mem_reported_ns) {
+        c_intf_mem_reported_ns = c_intf_mem_now();
+    }
+
+    mem_class->next = c_intf_mem_classes;
+    c_intf_mem_classes = mem_class;
+}
+
+/**
+ * Get the time objects are created and deleted at.
+ *
+ * @return The monotonic time in ns
+ */
+uint64_t
+c_intf_mem_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/**
+ * Raise a peak to a value if it is higher.
+ *
+ * @param peak The peak
+ * @param value The value
+ */
+static void
+c_intf_mem_raise_peak (size_t *peak, size_t value)
+{
+    size_t old = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+    while ((value > old) &&
+           !__atomic_compare_exchange_n(peak, &old, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * Count an object created.
+ *
+ * @param mem_class The class of the object
+ * @param bytes The bytes held by the object
+ */
+void
+c_intf_mem_add_object (c_intf_mem_class_st *mem_class, size_t bytes)
+{
+    __atomic_fetch_add(&(mem_class->created), 1, __ATOMIC_RELAXED);
+    c_intf_mem_raise_peak(&(mem_class->peak_live),
+        __atomic_add_fetch(&(mem_class->live), 1, __ATOMIC_RELAXED));
+    c_intf_mem_add_bytes(mem_class, bytes);
+}
+
+/**
+ * Count bytes held by an object after it was created, e.g. data created
+ * on first use.
+ *
+ * @param mem_class The class of the object
+ * @param bytes The bytes
+ */
+void
+c_intf_mem_add_bytes (c_intf_mem_class_st *mem_class, size_t bytes)
+{
+    c_intf_mem_raise_peak(&(mem_class->peak_bytes),
+        __atomic_add_fetch(&(mem_class->bytes), bytes, __ATOMIC_RELAXED));
+}
+
+/**
+ * Count an object deleted and its lifetime.
+ *
+ * @param mem_class The class of the object
+ * @param bytes All the bytes counted for the object
+ * @param created_ns The c_intf_mem_now() of the creation of the object
+ */
+void
+c_intf_mem_remove_object (c_intf_mem_class_st *mem_class, size_t bytes,
+                          uint64_t created_ns)
+{
+    uint64_t lifetime = c_intf_mem_now() - created_ns;
+    int bucket = 63 - __builtin_clzll(lifetime | 1);
+
+    __atomic_fetch_sub(&(mem_class->live), 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&(mem_class->bytes), bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&(mem_class->deleted), 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&(mem_class->lifetimes[bucket]), 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Write a lifetime, rounded down to the largest unit it has at least one of.
+ *
+ * @param fd The file descriptor
+ * @param lifetime The lifetime in ns, a power of two
+ */
+static void
+c_intf_mem_write_lifetime (int fd, uint64_t lifetime)
+{
+    static const char *units[] = { "ns", "us", "ms", "s" };
+    unsigned int unit = 0;
+
+    while ((lifetime >= 1000) && (unit < 3)) {
+        lifetime /= 1000;
+        unit++;
+    }
+
+    dprintf(fd, "%5llu %-2s", (unsigned long long) lifetime, units[unit]);
+}
+
+/**
+ * Write the memory usage of all the registered classes: their live objects
+ * and the bytes held by them, the peaks of both, the objects created and
+ * deleted, the rate at which they were created since the previous report
+ * and the histogram of the lifetimes of the objects deleted.
+ *
+ * @param fd The file descriptor
+ */
+void
+c_intf_mem_report (int fd)
+{
+    c_intf_mem_class_st *mem_class;
+    uint64_t now = c_intf_mem_now();
+    uint64_t created;
+    uint64_t count;
+    double seconds;
+    int i;
+
+    seconds = (now - __atomic_exchange_n(&c_intf_mem_reported_ns, now,
+                                         __ATOMIC_RELAXED)) / 1e9;
+
+    for (mem_class = c_intf_mem_classes; NULL != mem_class;
+         mem_class = mem_class->next) {
+        created = __atomic_load_n(&(mem_class->created), __ATOMIC_RELAXED);
+        dprintf(fd, "%s: %zu live (peak %zu), %zu bytes (peak %zu), "
+                "%llu created, %llu deleted, %.1f created/s\\n",
+                mem_class->name,
+                __atomic_load_n(&(mem_class->live), __ATOMIC_RELAXED),
+                __atomic_load_n(&(mem_class->peak_live), __ATOMIC_RELAXED),
+                __atomic_load_n(&(mem_class->bytes), __ATOMIC_RELAXED),
+                __atomic_load_n(&(mem_class->peak_bytes), __ATOMIC_RELAXED),
+                (unsigned long long) created,
+                (unsigned long long) __atomic_load_n(&(mem_class->deleted),
+                                                     __ATOMIC_RELAXED),
+                (seconds > 0) ?
+                    (created - __atomic_exchange_n(
+                                   &(mem_class->reported_created),
+                                   created, __ATOMIC_RELAXED)) / seconds :
+                    0.0);
+
+        for (i = 0; i < C_INTF_MEM_LIFETIME_BUCKETS; i++) {
+            count = __atomic_load_n(&(mem_class->lifetimes[i]),
+                                    __ATOMIC_RELAXED);
+            if (0 == count) {
+                continue;
+            }
+            dprintf(fd, "    lifetime < ");
+            c_intf_mem_write_lifetime(fd, 2ULL << i);
+            dprintf(fd, ": %llu\\n", (unsigned long long) count);
+        }
+    }
+}
+
+"""
+
+runtime_handle_h_str = """\
+/** The bits of ids indexing the slots of a table, the others are generations */
+#define C_INTF_HANDLE_INDEX_BITS 22
+
+/** The bits of ids indexing the slots of a page of a table */
+#define C_INTF_HANDLE_PAGE_BITS 12
+
+/** The number of pages of a table */
+#define C_INTF_HANDLE_NUM_PAGES \\
+    (1U << (C_INTF_HANDLE_INDEX_BITS - C_INTF_HANDLE_PAGE_BITS))
+
+/** The id of no object, which is never resolved */
+#define C_INTF_HANDLE_NONE 0U
+
+/** A slot of a handle table */
+typedef struct c_intf_handle_slot_st_ {
+    /** The object, NULL if the slot is free */
+    void *obj;
+    /** Incremented each time the slot is freed */
+    uint32_t generation;
+    /** The index of the next free slot, 0 for none */
+    uint32_t next_free;
+} c_intf_handle_slot_st;
+
+/**
+ * Table giving 32-bit ids to objects.  An id is the index of the slot of the
+ * object and the generation of the slot, so the ids of deleted objects are
+ * not resolved to the objects reusing their slots.  Tables are zeroed, e.g.
+ * static, before use.
+ */
+typedef struct c_intf_handle_table_st_ {
+    /** Protects the free slots */
+    int lock;
+    /** The number of slots used so far, slot 0 is never used */
+    uint32_t num_slots;
+    /** The oldest free slot, 0 for none */
+    uint32_t free_head;
+    /** The newest free slot, 0 for none */
+    uint32_t free_tail;
+    /** The pages of slots, allocated as needed */
+    c_intf_handle_slot_st *pages[C_INTF_HANDLE_NUM_PAGES];
+} c_intf_handle_table_st;
+
+/* APIs below are documented in their implementation file */
+
+extern uint32_t
+c_intf_handle_add(c_intf_handle_table_st *table, void *obj);
+
+extern void
+c_intf_handle_remove(c_intf_handle_table_st *table, uint32_t id);
+
+extern void *
+c_intf_handle_resolve(c_intf_handle_table_st *table, uint32_t id);
+
+"""
+
+runtime_handle_c_str = """\
+/** The mask of the index of a slot in an id */
+#define C_INTF_HANDLE_INDEX_MASK ((1U << C_INTF_HANDLE_INDEX_BITS) - 1)
+
+/** The mask of the index of a slot in its page */
+#define C_INTF_HANDLE_PAGE_MASK ((1U << C_INTF_HANDLE_PAGE_BITS) - 1)
+
+/** The mask of the generations of slots */
+#define C_INTF_HANDLE_GENERATION_MASK \\
+    ((1U << (32 - C_INTF_HANDLE_INDEX_BITS)) - 1)
+
+/**
+ * Get a slot of a table.
+ *
+ * @param table The table
+ * @param index The index of the slot
+ * @return The slot or NULL if its page was never allocated
+ */
+static c_intf_handle_slot_st *
+c_intf_handle_get_slot (c_intf_handle_table_st *table, uint32_t index)
+{
+    c_intf_handle_slot_st *page;
+
+    page = __atomic_load_n(&(table->pages[index >> C_INTF_HANDLE_PAGE_BITS]),
+                           __ATOMIC_ACQUIRE);
+    if (NULL == page) {
+        return (NULL);
+    }
+
+    return (&(page[index & C_INTF_HANDLE_PAGE_MASK]));
+}
+
+/**
+ * Give an id to an object.  Free slots are reused oldest first, so an id is
+ * only taken again after its slot was freed as many times as there are
+ * generations, 1024.
+ *
+ * @param table The table
+ * @param obj The object
+ * @return The id or C_INTF_HANDLE_NONE if the table is full or on allocation
+ * failure
+ */
+uint32_t
+c_intf_handle_add (c_intf_handle_table_st *table, void *obj)
+{
+    c_intf_handle_slot_st *slot = NULL;
+    c_intf_handle_slot_st *page;
+    uint32_t index;
+    uint32_t id = C_INTF_HANDLE_NONE;
+
+    while (__atomic_exchange_n(&(table->lock), 1, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+
+    index = table->free_head;
+    if (0 != index) {
+        slot = c_intf_handle_get_slot(table, index);
+        table->free_head = slot->next_free;
+        if (0 == table->free_head) {
+            table->free_tail = 0;
+        }
+    } else if (table->num_slots < C_INTF_HANDLE_INDEX_MASK) {
+        index = table->num_slots + 1;
+        page = table->pages[index >> C_INTF_HANDLE_PAGE_BITS];
+        if (NULL == page) {
+            page = calloc(C_INTF_HANDLE_PAGE_MASK + 1, sizeof(*page));
+            __atomic_store_n(&(table->pages[index >> C_INTF_HANDLE_PAGE_BITS]),
+                             page, __ATOMIC_RELEASE);
+        }
+        if (NULL != page) {
+            table->num_slots = index;
+            slot = &(page[index & C_INTF_HANDLE_PAGE_MASK]);
+        }
+    }
+
+    if (NULL != slot) {
+        __atomic_store_n(&(slot->obj), obj, __ATOMIC_RELEASE);
+        id = (slot->generation << C_INTF_HANDLE_INDEX_BITS) | index;
+    }
+
+    __atomic_store_n(&(table->lock), 0, __ATOMIC_RELEASE);
+
+    return (id);
+}
+
+/**
+ * Free the slot of an id, after which the id is no longer resolved.
+ *
+ * @param table The table
+ * @param id The id.  If stale or C_INTF_HANDLE_NONE, this is a no-op.
+ */
+void
+c_intf_handle_remove (c_intf_handle_table_st *table, uint32_t id)
+{
+    uint32_t index = id & C_INTF_HANDLE_INDEX_MASK;
+    c_intf_handle_slot_st *slot;
+
+    if (0 == index) {
+        return;
+    }
+
+    while (__atomic_exchange_n(&(table->lock), 1, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+
+    slot = c_intf_handle_get_slot(table, index);
+    if ((NULL != slot) && (NULL != slot->obj) &&
+        (slot->generation == (id >> C_INTF_HANDLE_INDEX_BITS))) {
+        /* The generation changes first, so stale ids never see the slot
+           free or reused */
+        __atomic_store_n(&(slot->generation),
+                         (slot->generation + 1) &
+                             C_INTF_HANDLE_GENERATION_MASK,
+                         __ATOMIC_RELEASE);
+        __atomic_store_n(&(slot->obj), NULL, __ATOMIC_RELEASE);
+        slot->next_free = 0;
+        if (0 == table->free_tail) {
+            table->free_head = index;
+        } else {
+            c_intf_handle_get_slot(table, table->free_tail)->next_free = index;
+        }
+        table->free_tail = index;
+    }
+
+    __atomic_store_n(&(table->lock), 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Get the object of an id, without locking.
+ *
+ * @param table The table
+ * @param id The id
+ * @return The object or NULL if the id is stale, i.e. its object was deleted,
+ * or invalid
+ */
+void *
+c_intf_handle_resolve (c_intf_handle_table_st *table, uint32_t id)
+{
+    c_intf_handle_slot_st *slot;
+    void *obj;
+
+    slot = c_intf_handle_get_slot(table, id & C_INTF_HANDLE_INDEX_MASK);
+    if (NULL == slot) {
+        return (NULL);
+    }
+
+    /* Read before the generation, which changes before the object */
+    obj = __atomic_load_n(&(slot->obj), __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&(slot->generation), __ATOMIC_ACQUIRE) !=
+        (id >> C_INTF_HANDLE_INDEX_BITS)) {
+        return (NULL);
+    }
+
+    return (obj);
+}
+
+"""
+
+runtime_epoch_h_str = """\
+/**
+ * Free a retired object.
+ *
+ * @param obj The object
+ */
+typedef void
+(*c_intf_epoch_free_fn)(void *obj);
+
+/** The read sections of a thread */
+typedef struct c_intf_epoch_thread_st_ {
+    /** The epoch when the thread entered its read section, 0 outside */
+    uint64_t epoch;
+    /** The number of nested read sections of the thread */
+    unsigned int depth;
+    /** Indicates whether a thread uses this, cleared when it exits */
+    bool in_use;
+    /** The next thread */
+    struct c_intf_epoch_thread_st_ *next;
+} __attribute__((aligned(64))) c_intf_epoch_thread_st;
+
+/** The read sections of the calling thread, NULL until its first one */
+extern __thread c_intf_epoch_thread_st *c_intf_epoch_thread;
+
+/** The global epoch, starting at 1 */
+extern uint64_t c_intf_epoch_global;
+
+/* APIs below are documented in their implementation file */
+
+extern c_intf_epoch_thread_st *
+c_intf_epoch_new_thread(void);
+
+extern void
+c_intf_epoch_retire(c_intf_epoch_free_fn free_fn, void *obj);
+
+extern size_t
+c_intf_epoch_reclaim(void);
+
+extern void
+c_intf_epoch_synchronize(void);
+
+/**
+ * Enter a read section, in which the objects reachable by the thread are not
+ * freed even if another thread retires them.  Read sections nest and never
+ * block or lock, they only publish the epoch the thread is in.
+ *
+ * @return TRUE on success, FALSE if the first read section of the thread
+ * could not be allocated, in which case shared objects must not be used
+ */
+static inline bool
+c_intf_read_enter (void)
+{
+    c_intf_epoch_thread_st *thread = c_intf_epoch_thread;
+
+    if (NULL == thread) {
+        thread = c_intf_epoch_new_thread();
+        if (NULL == thread) {
+            return (false);
+        }
+    }
+
+    if (0 == thread->depth++) {
+        /* Published before any object is read */
+        __atomic_store_n(&(thread->epoch),
+                         __atomic_load_n(&c_intf_epoch_global,
+                                         __ATOMIC_RELAXED),
+                         __ATOMIC_SEQ_CST);
+        /* Keeps the loads of the objects from moving before the store */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+
+    return (true);
+}
+
+/**
+ * Exit a read section entered with c_intf_read_enter().  Objects read in the
+ * outermost section must not be used after it is exited.
+ */
+static inline void
+c_intf_read_exit (void)
+{
+    c_intf_epoch_thread_st *thread = c_intf_epoch_thread;
+
+    if (0 == --thread->depth) {
+        __atomic_store_n(&(thread->epoch), 0, __ATOMIC_RELEASE);
+    }
+}
+
+"""
+
+runtime_epoch_c_str = """\
+__thread c_intf_epoch_thread_st *c_intf_epoch_thread;
+
+uint64_t c_intf_epoch_global = 1;
+
+/** An object waiting for the readers which may use it */
+typedef struct c_intf_epoch_retired_st_ {
+    /** Frees the object */
+    c_intf_epoch_free_fn free_fn;
+    /** The object */
+    void *obj;
+    /** The global epoch when the object was retired */
+    uint64_t epoch;
+    /** The object retired next */
+    struct c_intf_epoch_retired_st_ *next;
+} c_intf_epoch_retired_st;
+
+/** The read sections of all the threads, including those which exited */
+static c_intf_epoch_thread_st *c_intf_epoch_threads;
+
+/** Releases the read sections of threads when they exit */
+static pthread_key_t c_intf_epoch_key;
+
+/** Creates c_intf_epoch_key once */
+static pthread_once_t c_intf_epoch_key_once = PTHREAD_ONCE_INIT;
+
+/** Protects the retired objects */
+static int c_intf_epoch_lock;
+
+/** The retired objects, oldest first */
+static c_intf_epoch_retired_st *c_intf_epoch_head;
+
+/** The newest retired object */
+static c_intf_epoch_retired_st *c_intf_epoch_tail;
+
+/**
+ * Release the read sections of a thread which exited, for another thread to
+ * reuse.
+ *
+ * @param arg The read sections
+ */
+static void
+c_intf_epoch_release_thread (void *arg)
+{
+    c_intf_epoch_thread_st *thread = arg;
+
+    thread->depth = 0;
+    __atomic_store_n(&(thread->epoch), 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&(thread->in_use), false, __ATOMIC_RELEASE);
+}
+
+/**
+ * Create the key releasing the read sections of threads.
+ */
+static void
+c_intf_epoch_create_key (void)
+{
+    (void) pthread_key_create(&c_intf_epoch_key, c_intf_epoch_release_thread);
+}
+
+/**
+ * Get read sections for the calling thread, reusing those of a thread which
+ * exited if any.  Called by the first read section of the thread.
+ *
+ * @return The read sections or NULL if allocation failed
+ */
+c_intf_epoch_thread_st *
+c_intf_epoch_new_thread (void)
+{
+    c_intf_epoch_thread_st *thread;
+    bool in_use;
+
+    (void) pthread_once(&c_intf_epoch_key_once, c_intf_epoch_create_key);
+
+    for (thread = __atomic_load_n(&c_intf_epoch_threads, __ATOMIC_ACQUIRE);
+         NULL != thread; thread = thread->next) {
+        in_use = false;
+        if (__atomic_compare_exchange_n(&(thread->in_use), &in_use, true,
+                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    if (NULL == thread) {
+        /* Aligned so that threads do not share the cache line of an epoch */
+        if (0 != posix_memalign((void **) &thread, sizeof(*thread),
+                                sizeof(*thread))) {
+            return (NULL);
+        }
+        memset(thread, 0, sizeof(*thread));
+        thread->in_use = true;
+        thread->next = __atomic_load_n(&c_intf_epoch_threads,
+                                       __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&c_intf_epoch_threads,
+                    &(thread->next), thread, true, __ATOMIC_RELEASE,
+                    __ATOMIC_RELAXED)) {
+        }
+    }
+
+    (void) pthread_setspecific(c_intf_epoch_key, thread);
+    c_intf_epoch_thread = thread;
+
+    return (thread);
+}
+
+/**
+ * Move the global epoch forward if every thread in a read section entered it
+ * in the current epoch.
+ *
+ * @return TRUE if the epoch moved, FALSE otherwise
+ */
+static bool
+c_intf_epoch_try_advance (void)
+{
+    c_intf_epoch_thread_st *thread;
+    uint64_t global;
+    uint64_t epoch;
+
+    global = __atomic_load_n(&c_intf_epoch_global, __ATOMIC_SEQ_CST);
+
+    for (thread = __atomic_load_n(&c_intf_epoch_threads, __ATOMIC_ACQUIRE);
+         NULL != thread; thread = thread->next) {
+        epoch = __atomic_load_n(&(thread->epoch), __ATOMIC_SEQ_CST);
+        if ((0 != epoch) && (global != epoch)) {
+            return (false);
+        }
+    }
+
+    return (__atomic_compare_exchange_n(&c_intf_epoch_global, &global,
+                global + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+}
+
+/**
+ * Free the retired objects no read section can use anymore, those retired
+ * two epochs ago or more.  Called by c_intf_epoch_retire(), or by idle
+ * threads to free objects sooner.
+ *
+ * @return The number of objects freed
+ */
+size_t
+c_intf_epoch_reclaim (void)
+{
+    c_intf_epoch_retired_st *retired = NULL;
+    c_intf_epoch_retired_st *last = NULL;
+    c_intf_epoch_retired_st *next;
+    uint64_t global;
+    size_t num_freed = 0;
+
+    (void) c_intf_epoch_try_advance();
+    global = __atomic_load_n(&c_intf_epoch_global, __ATOMIC_SEQ_CST);
+
+    while (__atomic_exchange_n(&c_intf_epoch_lock, 1, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+    /* The objects are in the order they were retired, so are their epochs */
+    while ((NULL != c_intf_epoch_head) &&
+           (c_intf_epoch_head->epoch + 2 <= global)) {
+        last = c_intf_epoch_head;
+        if (NULL == retired) {
+            retired = last;
+        }
+        c_intf_epoch_head = last->next;
+    }
+    if (NULL != last) {
+        last->next = NULL;
+        if (NULL == c_intf_epoch_head) {
+            c_intf_epoch_tail = NULL;
+        }
+    }
+    __atomic_store_n(&c_intf_epoch_lock, 0, __ATOMIC_RELEASE);
+
+    /* Freed without the lock since freeing may retire other objects */
+    for (; NULL != retired; retired = next) {
+        next = retired->next;
+        retired->free_fn(retired->obj);
+        free(retired);
+        num_freed++;
+    }
+
+    return (num_freed);
+}
+
+/**
+ * Wait until every read section entered before the call is exited.  Must
+ * not be called in a read section, which would wait for itself forever.
+ */
+void
+c_intf_epoch_synchronize (void)
+{
+    uint64_t target;
+
+    assert((NULL == c_intf_epoch_thread) ||
+           (0 == c_intf_epoch_thread->depth));
+    target = __atomic_load_n(&c_intf_epoch_global, __ATOMIC_SEQ_CST) + 2;
+
+    while (__atomic_load_n(&c_intf_epoch_global, __ATOMIC_SEQ_CST) <
+           target) {
+        if (!c_intf_epoch_try_advance()) {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * Free an object once the read sections which may use it are exited.  The
+ * object must already be unreachable for read sections entered from now on.
+ * Retiring also frees the objects retired earlier which no read section can
+ * use anymore.  To free all the retired objects, e.g. before exiting, call
+ * c_intf_epoch_synchronize() then c_intf_epoch_reclaim().  May be called in
+ * a read section, although if no memory is left to queue the object it is
+ * then never freed, since waiting for the readers would wait for the caller.
+ *
+ * @param free_fn Frees the object
+ * @param obj The object
+ */
+void
+c_intf_epoch_retire (c_intf_epoch_free_fn free_fn, void *obj)
+{
+    c_intf_epoch_retired_st *retired;
+
+    retired = malloc(sizeof(*retired));
+    if (NULL == retired) {
+        /* Waiting for the readers is slow but needs no memory */
+        if ((NULL == c_intf_epoch_thread) ||
+            (0 == c_intf_epoch_thread->depth)) {
+            c_intf_epoch_synchronize();
+            free_fn(obj);
+        }
+        return;
+    }
+    retired->free_fn = free_fn;
+    retired->obj = obj;
+    retired->next = NULL;
+
+    while (__atomic_exchange_n(&c_intf_epoch_lock, 1, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+    retired->epoch = __atomic_load_n(&c_intf_epoch_global, __ATOMIC_SEQ_CST);
+    if (NULL == c_intf_epoch_tail) {
+        c_intf_epoch_head = retired;
+    } else {
+        c_intf_epoch_tail->next = retired;
+    }
+    c_intf_epoch_tail = retired;
+    __atomic_store_n(&c_intf_epoch_lock, 0, __ATOMIC_RELEASE);
+
+    (void) c_intf_epoch_reclaim();
+}
+
+"""
+
+runtime_lock_h_str = """\
+/** Set in the state of a lock held by a writer */
+#define C_INTF_LOCK_WRITER (1U << 30)
+
+/** Set in the state of a lock which threads may be sleeping on */
+#define C_INTF_LOCK_WAITERS (1U << 31)
+
+/** The lock of an object of a THREADSAFE interface */
+typedef struct c_intf_lock_st_ {
+    /** The number of readers, C_INTF_LOCK_WRITER and C_INTF_LOCK_WAITERS */
+    uint32_t state;
+} c_intf_lock_st;
+
+/** The lock contention of a class */
+typedef struct c_intf_lock_class_st_ {
+    /** The name of the class */
+    const char *name;
+    /** The number of locks taken */
+    uint64_t acquisitions;
+    /** The number of locks taken after waiting for another thread */
+    uint64_t contended;
+    /** The time spent waiting in ns */
+    uint64_t wait_ns;
+    /** The next registered class */
+    struct c_intf_lock_class_st_ *next;
+} c_intf_lock_class_st;
+
+/* APIs below are documented in their implementation file */
+
+extern void
+c_intf_lock_register(c_intf_lock_class_st *lock_class);
+
+extern void
+c_intf_lock_write_slow(c_intf_lock_st *lock,
+                       c_intf_lock_class_st *lock_class);
+
+extern void
+c_intf_lock_read_slow(c_intf_lock_st *lock, c_intf_lock_class_st *lock_class);
+
+extern void
+c_intf_lock_wake(c_intf_lock_st *lock);
+
+extern void
+c_intf_lock_report(int fd);
+
+/**
+ * Lock an object for a call which may modify it.
+ *
+ * @param lock The lock of the object
+ * @param lock_class The class counting the contention or NULL
+ */
+static inline void
+c_intf_lock_write (c_intf_lock_st *lock, c_intf_lock_class_st *lock_class)
+{
+    uint32_t state = 0;
+
+    if (NULL != lock_class) {
+        __atomic_fetch_add(&(lock_class->acquisitions), 1, __ATOMIC_RELAXED);
+    }
+
+    if (!__atomic_compare_exchange_n(&(lock->state), &state,
+                                     C_INTF_LOCK_WRITER, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        c_intf_lock_write_slow(lock, lock_class);
+    }
+}
+
+/**
+ * Unlock an object locked with c_intf_lock_write().
+ *
+ * @param lock The lock of the object
+ */
+static inline void
+c_intf_unlock_write (c_intf_lock_st *lock)
+{
+    if (__atomic_exchange_n(&(lock->state), 0, __ATOMIC_RELEASE) &
+        C_INTF_LOCK_WAITERS) {
+        c_intf_lock_wake(lock);
+    }
+}
+
+/**
+ * Lock an object for a call which only reads it, along with other readers.
+ *
+ * @param lock The lock of the object
+ * @param lock_class The class counting the contention or NULL
+ */
+static inline void
+c_intf_lock_read (c_intf_lock_st *lock, c_intf_lock_class_st *lock_class)
+{
+    uint32_t state = __atomic_load_n(&(lock->state), __ATOMIC_RELAXED);
+
+    if (NULL != lock_class) {
+        __atomic_fetch_add(&(lock_class->acquisitions), 1, __ATOMIC_RELAXED);
+    }
+
+    /* Readers queue behind waiting writers so they are not starved */
+    if ((0 != (state & (C_INTF_LOCK_WRITER | C_INTF_LOCK_WAITERS))) ||
+        !__atomic_compare_exchange_n(&(lock->state), &state, state + 1,
+                                     false, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED)) {
+        c_intf_lock_read_slow(lock, lock_class);
+    }
+}
+
+/**
+ * Unlock an object locked with c_intf_lock_read().
+ *
+ * @param lock The lock of the object
+ */
+static inline void
+c_intf_unlock_read (c_intf_lock_st *lock)
+{
+    uint32_t state = C_INTF_LOCK_WAITERS;
+
+    /* The last reader wakes the threads waiting for the readers, unless a
+     * writer took the lock meanwhile, which wakes them when releasing it */
+    if ((C_INTF_LOCK_WAITERS == __atomic_sub_fetch(&(lock->state), 1,
+                                                   __ATOMIC_RELEASE)) &&
+        __atomic_compare_exchange_n(&(lock->state), &state, 0, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        c_intf_lock_wake(lock);
+    }
+}
+
+"""
+
+runtime_lock_c_str = """\
+/** The number of times a lock is checked before sleeping on it */
+#define C_INTF_LOCK_SPINS 100
+
+/** The registered classes */
+static c_intf_lock_class_st *c_intf_lock_classes;
+
+/**
+ * Register a class whose lock contention is reported by c_intf_lock_report().
+ * Generated classes register themselves before main() runs.
+ *
+ * @param lock_class The class, which must outlive its registration
+ */
+void
+c_intf_lock_register (c_intf_lock_class_st *lock_class)
+{
+    lock_class->next = c_intf_lock_classes;
+    c_intf_lock_classes = lock_class;
+}
+
+/**
+ * Get the time threads start and stop waiting for locks at.
+ *
+ * @return The monotonic time in ns
+ */
+static uint64_t
+c_intf_lock_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/**
+ * Wait for a lock to be taken, spinning a while before sleeping.
+ *
+ * @param lock The lock
+ * @param busy The state bits which prevent taking the lock
+ * @param increment Added to the state to take the lock
+ * @param lock_class The class counting the contention or NULL
+ */
+static void
+c_intf_lock_wait (c_intf_lock_st *lock, uint32_t busy, uint32_t increment,
+                  c_intf_lock_class_st *lock_class)
+{
+    uint64_t start = 0;
+    uint32_t state;
+    int spins = 0;
+
+    if (NULL != lock_class) {
+        __atomic_fetch_add(&(lock_class->contended), 1, __ATOMIC_RELAXED);
+        start = c_intf_lock_now();
+    }
+
+    for (;;) {
+        state = __atomic_load_n(&(lock->state), __ATOMIC_RELAXED);
+        if (0 == (state & busy)) {
+            if (__atomic_compare_exchange_n(&(lock->state), &state,
+                                            state + increment, false,
+                                            __ATOMIC_ACQUIRE,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+            continue;
+        }
+        if (spins < C_INTF_LOCK_SPINS) {
+            spins++;
+            continue;
+        }
+        /* Whoever holds the lock wakes the waiters when releasing it */
+        if ((0 == (state & C_INTF_LOCK_WAITERS)) &&
+            !__atomic_compare_exchange_n(&(lock->state), &state,
+                                         state | C_INTF_LOCK_WAITERS, false,
+                                         __ATOMIC_RELAXED,
+                                         __ATOMIC_RELAXED)) {
+            continue;
+        }
+        syscall(SYS_futex, &(lock->state), FUTEX_WAIT_PRIVATE,
+                state | C_INTF_LOCK_WAITERS, NULL, NULL, 0);
+    }
+
+    if (NULL != lock_class) {
+        __atomic_fetch_add(&(lock_class->wait_ns), c_intf_lock_now() - start,
+                           __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Lock an object for writing once c_intf_lock_write() found it locked.
+ *
+ * @param lock The lock of the object
+ * @param lock_class The class counting the contention or NULL
+ */
+void
+c_intf_lock_write_slow (c_intf_lock_st *lock,
+                        c_intf_lock_class_st *lock_class)
+{
+    c_intf_lock_wait(lock, ~C_INTF_LOCK_WAITERS, C_INTF_LOCK_WRITER,
+                     lock_class);
+}
+
+/**
+ * Lock an object for reading once c_intf_lock_read() found it locked by a
+ * writer or waited for.
+ *
+ * @param lock The lock of the object
+ * @param lock_class The class counting the contention or NULL
+ */
+void
+c_intf_lock_read_slow (c_intf_lock_st *lock, c_intf_lock_class_st *lock_class)
+{
+    c_intf_lock_wait(lock, C_INTF_LOCK_WRITER | C_INTF_LOCK_WAITERS, 1,
+                     lock_class);
+}
+
+/**
+ * Wake the threads sleeping on a lock released with C_INTF_LOCK_WAITERS
+ * cleared.  Those which cannot take it set C_INTF_LOCK_WAITERS again before
+ * sleeping again.
+ *
+ * @param lock The lock
+ */
+void
+c_intf_lock_wake (c_intf_lock_st *lock)
+{
+    syscall(SYS_futex, &(lock->state), FUTEX_WAKE_PRIVATE, INT_MAX, NULL,
+            NULL, 0);
+}
+
+/**
+ * Write the lock contention of all the registered classes: the locks taken
+ * on their objects, how many had to wait for another thread and the time
+ * spent waiting.
+ *
+ * @param fd The file descriptor
+ */
+void
+c_intf_lock_report (int fd)
+{
+    c_intf_lock_class_st *lock_class;
+    uint64_t acquisitions;
+    uint64_t contended;
+
+    for (lock_class = c_intf_lock_classes; NULL != lock_class;
+         lock_class = lock_class->next) {
+        acquisitions = __atomic_load_n(&(lock_class->acquisitions),
+                                       __ATOMIC_RELAXED);
+        contended = __atomic_load_n(&(lock_class->contended),
+                                    __ATOMIC_RELAXED);
+        dprintf(fd, "%s: %llu locks, %llu contended (%.1f%%), "
+                "%.3f ms waited\\n", lock_class->name,
+                (unsigned long long) acquisitions,
+                (unsigned long long) contended,
+                (0 == acquisitions) ? 0.0 :
+                    100.0 * contended / acquisitions,
+                __atomic_load_n(&(lock_class->wait_ns), __ATOMIC_RELAXED) /
+                    1e6);
+    }
+}
+
+"""
+
+def get_runtime_sections (parser_args):
+    """Get the (includes, header, implementation) code of the runtime support
+       needed by the options given."""
+    sections = []
+    if (parser_args.alloc_hooks):
+        sections.append(([], runtime_alloc_h_str, runtime_alloc_c_str))
+    if (parser_args.arena):
+        sections.append((["<sys/mman.h>"], runtime_arena_h_str,
+                         runtime_arena_c_str))
+    if (parser_args.numa):
+        sections.append((["<fcntl.h>", "<sched.h>", "<unistd.h>",
+                          "<sys/mman.h>", "<sys/syscall.h>",
+                          "<linux/mempolicy.h>"],
+                         runtime_numa_h_str, runtime_numa_c_str))
+    if (parser_args.parallel_calls):
+        sections.append((["<pthread.h>", "<sched.h>", "<time.h>",
+                          "<unistd.h>"], runtime_pool_h_str,
+                         runtime_pool_c_str))
+    if (parser_args.record):
+        sections.append((["<fcntl.h>", "<sched.h>", "<time.h>", "<unistd.h>",
+                          "<sys/mman.h>", "<sys/stat.h>", "<sys/syscall.h>"],
+                         runtime_record_h_str, runtime_record_c_str))
+    if (parser_args.shm_proxies):
+        sections.append((["<errno.h>", "<sched.h>", "<signal.h>",
+                          "<time.h>", "<unistd.h>",
+                          "<fcntl.h>", "<sys/mman.h>", "<sys/stat.h>",
+                          "<sys/syscall.h>", "<linux/futex.h>"],
+                         runtime_shm_h_str, runtime_shm_c_str))
+    if (parser_args.mem_stats):
+        sections.append((["<stdio.h>", "<time.h>"], runtime_mem_h_str,
+                         runtime_mem_c_str))
+    if (parser_args.snapshot):
+        sections.append((["<errno.h>", "<fcntl.h>", "<unistd.h>",
+                          "<sys/mman.h>", "<sys/stat.h>"],
+                         runtime_snap_h_str, runtime_snap_c_str))
+    if (parser_args.handle_table):
+        sections.append((["<sched.h>"], runtime_handle_h_str,
+                         runtime_handle_c_str))
+    if (parser_args.epochs):
+        sections.append((["<assert.h>", "<pthread.h>", "<sched.h>"],
+                         runtime_epoch_h_str,
+                         runtime_epoch_c_str))
+    if (parser_args.threadsafe):
+        sections.append((["<limits.h>", "<stdio.h>", "<time.h>",
+                          "<unistd.h>", "<sys/syscall.h>", "<linux/futex.h>"],
+                         runtime_lock_h_str, runtime_lock_c_str))
+    if (parser_args.flight_recorder):
+        flight_h_str = """\\
+#include <time.h>
+
+/** The number of calls kept per thread by the flight recorder */
+#define C_INTF_FLIGHT_EVENTS {}
+
+""".format(parser_args.flight_events) + runtime_flight_h_str
+        sections.append((["<errno.h>", "<fcntl.h>", "<pthread.h>",
+                          "<signal.h>", "<unistd.h>", "<sys/syscall.h>"],
+                         flight_h_str, runtime_flight_c_str))
+    return (sections)
+
+def uses_runtime (parser_args):
+    """Indicates whether the generated code needs the runtime support files"""
+    return (len(get_runtime_sections(parser_args)) > 0)
+
+def get_runtime_name (parser_args):
+    """Get the base name of the runtime support files"""
+    return ("c_intf_runtime{}".format(parser_args.gen_file_suffix))
+
+def generate_runtime_files (unused, parser_args, author=None, license=None):
+    """Generate the runtime support shared by all generated interfaces and
+       classes.  The first argument is unused so this has the same signature
+       as the other generate functions."""
+
+    header_file_name = "{}/{}.h".format(parser_args.output_dir,
+                                        get_runtime_name(parser_args))
+    c_file_name = "{}/{}.c".format(parser_args.output_dir,
+                                   get_runtime_name(parser_args))
+    sections = get_runtime_sections(parser_args)
+
+    try:
+        f = open(header_file_name, "w")
+    except IOError:
+        print "ERROR: Could not open {} for writing".format(
+            header_file_name)
+        sys.exit(1)
+
+    desc_str = "This is the runtime support for the generated interfaces\n" + \
+        "and classes."
+    write_header(f, desc_str, author, license, parser_args.lean_headers)
+    f.write("""\
+#ifndef __{0}_H__
+#define __{0}_H__
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+""".format(get_runtime_name(parser_args).upper()))
+    for (includes, header_str, c_str) in sections:
+        f.write(header_str)
+    f.write("#endif\n")
+    f.close()
+
+    try:
+        f = open(c_file_name, "w")
+    except IOError:
+        print "ERROR: Could not open {} for writing".format(c_file_name)
+        sys.exit(1)
+
+    desc_str = "This is the implementation of the runtime support for the\n" + \
+        "generated interfaces and classes."
+    write_header(f, desc_str, author, license)
+    c_includes = ["<string.h>"]
+    for (includes, header_str, c_str) in sections:
+        c_includes.extend(i for i in includes if i not in c_includes)
+    for include in c_includes:
+        f.write("#include {}\n".format(include))
+    f.write("#include \"{}.h\"\n\n".format(get_runtime_name(parser_args)))
+    for (includes, header_str, c_str) in sections:
+        f.write(c_str)
+    f.close()
+
+def write_private_struct (f, intf, parser_args):
+    """Write the private data of the interface, which is in the friend
+       header with --static-init and in the implementation file otherwise"""
+    if (parser_args.static_init):
+        f.write("/**\n" + \
+                " * Private variables which must only be accessed by the\n" + \
+                " * interface, visible so friend classes can statically\n" + \
+                " * initialize objects.\n" + \
+                " */\n")
+    else:
+        f.write("/**\n" + \
+                " * Private variables which cannot be directly accessed by\n" + \
+                " * any other class including children.\n" + \
+                " */\n")
+    f.write("typedef struct {}_private_st_ {{\n".format(intf.name) + \
+            "    /** Virtual function table */\n" + \
+            "    const {}_vtable_st *vtable;\n".format(intf.name))
+    if (parser_args.hot_swap):
+        f.write("    /** Where calls read the vtable, vtable or the one " + \
+                "shared by the class */\n" + \
+                "    const {}_vtable_st **shared_vtable;\n".format(intf.name))
+    if (parser_args.alloc_hooks):
+        f.write("    /** Allocator of this block */\n" + \
+                "    const c_intf_allocator_st *allocator;\n")
+    if (parser_args.record):
+        f.write("    /** Identifies the object in recorded calls */\n" + \
+                "    uint64_t record_object_id;\n" + \
+                "    /** Identifies the class of the object in recorded " + \
+                "calls */\n" + \
+                "    uint32_t record_class_id;\n" + \
+                "    /** Set for proxies, whose calls are recorded when " + \
+                "run on the target */\n" + \
+                "    bool record_skip;\n")
+    if (parser_args.flight_recorder):
+        f.write("    /** The class of the object in flight recorder " + \
+                "events */\n" + \
+                "    const char *flight_class;\n")
+    if (parser_args.handle_table):
+        f.write("    /** The id of the object, 0 until first asked for */\n" + \
+                "    uint32_t handle_id;\n")
+    if (parser_args.bulk):
+        f.write("    /** Indicates whether this is in memory managed by the " + \
+                "friend class */\n" + \
+                "    bool embedded;\n")
+    if (intf.is_threadsafe()):
+        f.write("    /** Serializes the calls on the object */\n" + \
+                "    c_intf_lock_st lock;\n")
+        if (parser_args.lock_stats):
+            f.write("    /** Counts the contention of the lock, NULL " + \
+                    "if not counted */\n" + \
+                    "    c_intf_lock_class_st *lock_class;\n")
+    f.write("}} {}_private_st;\n\n".format(intf.name))
+
+def generate_interface_files (intf, parser_args, author=None, license=None):
+
+    public_header_file_name = "{}/{}{}.h".format(parser_args.output_dir,
+                                                 intf.name, 
+                                                 parser_args.gen_file_suffix)
+    friend_header_file_name = \
+        "{}/{}_friend{}.h".format(parser_args.output_dir, intf.name,
+                                  parser_args.gen_file_suffix)
+    c_file_name = "{}/{}{}.c".format(parser_args.output_dir, intf.name,
+                                     parser_args.gen_file_suffix)
+
+    try:
+        f = open(public_header_file_name, "w")
+    except IOError:
+        print "ERROR: Could not open {} for writing".format(
+            public_header_file_name)
+        sys.exit(1)
+
+    # Write the public interface file
+    desc_str = "This is the public interface for " + \
+        "the {} class.".format(intf.name)
+    write_header(f, desc_str, author, license, parser_args.lean_headers)
+    f.write("""\
+#ifndef __{0}_H__
+#define __{0}_H__
+
+""".format(re.sub(".h$", "", 
+        os.path.basename(public_header_file_name)).upper()))
+    if (parser_args.lean_headers):
+        std_includes = get_std_includes(intf)
+        if ((intf.is_async() or len(get_batch_functions(intf)) > 0) and
+            "<stddef.h>" not in std_includes):
+            std_includes.append("<stddef.h>")
+        if (parser_args.record):
+            # Used by <intf>_set_record_info() and <intf>_replay_call()
+            std_includes.extend([include for include in
+                                    ["<stdbool.h>", "<stdint.h>", "<stddef.h>"]
+                                 if include not in std_includes])
+        if (parser_args.handle_table and "<stdint.h>" not in std_includes):
+            std_includes.append("<stdint.h>")
+    else:
+        std_includes = ["<stdlib.h>", "<stdbool.h>", "<stdint.h>",
+                        "<stddef.h>"]
+    if (parser_args.parallel_calls or intf.is_shm()):
+        std_includes.append("\"{}.h\"".format(get_runtime_name(parser_args)))
+    if (intf.base is not None):
+        std_includes.append("\"{}{}.h\"".format(intf.base.name,
+                                                parser_args.gen_file_suffix))
+    for include in std_includes + intf.includes:
+        f.write("#include {}\n".format(include))
+    if (len(std_includes + intf.includes) > 0):
+        f.write("\n")
+    if (parser_args.lean_headers):
+        write_handle_typedef(f, intf.name)
+    else:
+        f.write("/** Opaque pointer to reference instances of this class */\n")
+        f.write("typedef struct {0}_st_ *{0}_handle;\n\n".format(intf.name))
+    for ancestor in intf.get_ancestors()[1:]:
+        f.write("""\
+/**
+ * Get the {1} interface of a {0} object.  As {0} extends {1} and its vtable
+ * starts with the one of {1}, this is only a cast.
+ *
+ * @param {0}_h The object
+ * @return The {1} object
+ */
+static inline {1}_handle
+{0}_to_{1} ({0}_handle {0}_h)
+{{
+    return (({1}_handle) {0}_h);
+}}
+
+""".format(intf.name, ancestor.name))
+    if (parser_args.handle_table and intf.base is None):
+        f.write("/** 32-bit id of an object, see {}_get_id() */\n".format(
+                    intf.name) + \
+                "typedef uint32_t {}_id;\n\n".format(intf.name))
+    if (parser_args.record):
+        write_record_ids(f, intf)
+    f.write("/* APIs below are documented in their implementation file */\n\n")
+    for fn in intf.functions.viewvalues():
+        f.write("extern {}\n".format(fn.return_type))
+        real_name = "{}_{}".format(intf.name, fn.name)
+        f.write("{1}({0}_handle {0}_h".format(intf.name, real_name))
+        if (not fn.is_void_input()):
+            for input in fn.inputs:
+                f.write(",\n{}{}".format(" " * (len(real_name) + 1), input))
+        f.write(");\n\n")
+    for fn in get_batch_functions(intf):
+        real_name = "{}_{}_n".format(intf.name, fn.name)
+        f.write("extern void\n" + \
+                "{}({});\n\n".format(real_name,
+                    get_batch_params_str(intf, fn,
+                        ",\n" + " " * (len(real_name) + 1))))
+    if (intf.is_async()):
+        f.write("""\
+extern {0}_handle
+{0}_async_new({0}_handle target_h, size_t capacity);
+
+extern size_t
+{0}_async_drain({0}_handle proxy_h, size_t max_calls);
+
+""".format(intf.name))
+    if (parser_args.record):
+        f.write("""\
+extern bool
+{0}_replay_call({0}_handle {0}_h, uint32_t fn_id, const void *args,
+{1}size_t args_size);
+
+""".format(intf.name, " " * (len(intf.name) + 13)))
+    if (parser_args.handle_table and intf.base is None):
+        f.write("""\
+extern {0}_id
+{0}_get_id({0}_handle {0}_h);
+
+extern {0}_handle
+{0}_resolve({0}_id id);
+
+""".format(intf.name))
+    if (parser_args.epochs):
+        f.write("""\
+extern void
+{0}_retire({0}_handle {0}_h);
+
+""".format(intf.name))
+    if (parser_args.bulk):
+        f.write("""\
+extern void
+{0}_delete_n({0}_handle *{0}_handles, size_t num_handles);
+
+""".format(intf.name))
+    if (intf.is_shm()):
+        f.write("""\
+extern {0}_handle
+{0}_shm_client_new(const char *name);
+
+extern c_intf_shm_handle
+{0}_shm_create(const char *name, size_t capacity);
+
+extern size_t
+{0}_shm_serve(c_intf_shm_handle shm, {0}_handle target_h,
+{1}size_t max_calls, int timeout_ms);
+
+""".format(intf.name, " " * (len(intf.name) + 11)))
+    if (parser_args.parallel_calls):
+        for fn in get_parallel_functions(intf):
+            real_name = "{}_{}_parallel".format(intf.name, fn.name)
+            f.write("extern void\n" + \
+                    "{}({});\n\n".format(real_name,
+                        get_parallel_params_str(intf, fn,
+                            ",\n" + " " * (len(real_name) + 1))))
+    f.write("#endif\n")
+    f.close()
+
+    try:
+        f = open(friend_header_file_name, "w")
+    except IOError:
+        print "ERROR: Could not open {} for writing".format(
+            friend_header_file_name)
+        sys.exit(1)
+
+    # Write the friend interface file
+    desc_str = "This is the friend interface for the " + \
+               "{} class.\n".format(intf.name) + \
+               "It should only be included by implementors of the\n" + \
+               "{} interface.".format(intf.name)
+    write_header(f, desc_str, author, license, parser_args.lean_headers)
+    f.write("""\
+#ifndef __{0}_H__
+#define __{0}_H__
+
+""".format(re.sub(".h$", "", 
+        os.path.basename(friend_header_file_name)).upper()))
+    if (parser_args.lean_headers):
+        f.write("#include <stdbool.h>\n")
+    if (uses_runtime(parser_args)):
+        f.write("#include \"{}.h\"\n".format(get_runtime_name(parser_args)))
+    if (intf.base is not None):
+        f.write("#include \"{}_friend{}.h\"\n".format(
+                    intf.base.name, parser_args.gen_file_suffix))
+    f.write("#include \"{}\"\n\n".format(
+        os.path.basename(public_header_file_name)))
+    f.write("/** Opaque pointer to reference private data for the class */\n")
+    f.write("typedef struct {0}_private_st_ *{0}_private_handle;\n\n".format(
+                intf.name))
+    f.write("/** Friend accessible data for this class */\n" + \
+            "typedef struct {}_st_ {{\n".format(intf.name) + \
+            "    /** Reference to private data */\n" + \
+            "    {}_private_handle private_h;\n".format(intf.name) + \
+            "}} {}_st;\n\n".format(intf.name))
+    for fn in get_own_functions(intf):
+        f.write("/**\n" + \
+                " * Virtual function declaration.\n" + \
+                " */\n")
+        f.write("typedef {}\n".format(fn.return_type))
+        real_name = "(*{}_{}_fn)".format(intf.name, fn.name)
+        f.write("{1}({0}_handle {0}_h".format(intf.name, real_name))
+        if (not fn.is_void_input()):
+            for input in fn.inputs:
+                f.write(",\n{}{}".format(" " * (len(real_name) + 1), input))
+        f.write(");\n\n")
+    for fn in get_batch_functions(intf):
+        f.write("/**\n" + \
+                " * Virtual function declaration of the batch version of " + \
+                "{}.\n".format(fn.name) + \
+                " */\n")
+        real_name = "(*{}_{}_n_fn)".format(intf.name, fn.name)
+        f.write("typedef void\n" + \
+                "{}({});\n\n".format(real_name,
+                    get_batch_params_str(intf, fn,
+                        ",\n" + " " * (len(real_name) + 1))))
+
+    f.write("/**\n" + \
+            " * The virtual table to be specified by friend classes.\n" + \
+            " *\n" + \
+            " * @see {}_set_vtable()\n".format(intf.name) + \
+            " */\n");
+    f.write("typedef struct {}_vtable_st_ {{\n".format(intf.name))
+    for slot in get_vtable_slots(intf):
+        (owner, fn, is_batch) = slot
+        if (owner is not intf):
+            f.write("    /** Virtual function of {} */\n".format(owner.name))
+        elif (is_batch):
+            f.write("    /** Batch version of {} */\n".format(fn.name))
+        else:
+            f.write("    /** Virtual function */\n")
+        f.write("    {0}_{1}_fn {1}_fn;\n".format(owner.name,
+                                                  get_slot_name(slot)))
+    f.write("}} {}_vtable_st;\n\n".format(intf.name))
+    if (parser_args.static_init):
+        write_private_struct(f, intf, parser_args)
+    f.write("/* APIs below are documented in their implementation file */\n\n")
+    set_vtable_fn_name = "{}_set_vtable".format(intf.name)
+    f.write("extern bool\n" + \
+            "{0}({1}_handle {1}_h,\n".format(set_vtable_fn_name, intf.name) + \
+            "{}{}{}_vtable_st *vtable);\n\n".format(
+                " " * (len(set_vtable_fn_name) + 1),
+                "const " if parser_args.static_init else "", intf.name))
+    f.write("extern void\n" + \
+            "{0}_friend_delete({0}_handle {0}_h);\n\n".format(intf.name))
+    for fn in get_batch_functions(intf):
+        real_name = "{}_{}_n_default".format(intf.name, fn.name)
+        f.write("extern void\n" + \
+                "{}({});\n\n".format(real_name,
+                    get_batch_params_str(intf, fn,
+                        ",\n" + " " * (len(real_name) + 1))))
+    f.write("extern bool\n" + \
+            "{0}_init({0}_handle {0}_h);\n\n".format(intf.name))
+    if (parser_args.alloc_hooks):
+        init_fn_name = "{}_init_with_allocator".format(intf.name)
+        f.write("extern bool\n" + \
+                "{0}({1}_handle {1}_h,\n".format(init_fn_name, intf.name) + \
+                "{}const c_intf_allocator_st *allocator);\n\n".format(
+                    " " * (len(init_fn_name) + 1)))
+    if (parser_args.record):
+        f.write("""\
+extern void
+{0}_set_record_info({0}_handle {0}_h, uint32_t class_id,
+{1}uint64_t object_id);
+
+""".format(intf.name, " " * (len(intf.name) + 17)))
+    if (parser_args.flight_recorder):
+        f.write("""\
+extern void
+{0}_set_flight_class({0}_handle {0}_h, const char *class_name);
+
+""".format(intf.name))
+    if (parser_args.lock_stats and intf.is_threadsafe()):
+        f.write("""\
+extern void
+{0}_set_lock_class({0}_handle {0}_h, c_intf_lock_class_st *lock_class);
+
+""".format(intf.name))
+    if (parser_args.hot_swap):
+        f.write("""\
+extern void
+{0}_set_shared_vtable({0}_handle {0}_h,
+{1}const {0}_vtable_st **shared_vtable);
+
+extern const {0}_vtable_st *
+{0}_prepare_vtable(const {0}_vtable_st *parent_vtable,
+{2}const {0}_vtable_st *vtable);
+
+""".format(intf.name, " " * (len(intf.name) + 21),
+           " " * (len(intf.name) + 17)))
+    if (parser_args.mem_stats or parser_args.bulk):
+        f.write("""\
+extern size_t
+{0}_get_private_size(void);
+
+""".format(intf.name))
+    if (parser_args.bulk):
+        f.write("""\
+extern bool
+{0}_init_n({0}_handle {0}_h, size_t stride, size_t count,
+{1}void *private_mem, {2}{0}_vtable_st *vtable);
+
+""".format(intf.name, " " * (len(intf.name) + 8),
+           "const " if parser_args.static_init else ""))
+    if (parser_args.handle_table and intf.base is None):
+        f.write("""\
+/** The ids of the objects, shared with the interfaces extending this one */
+extern c_intf_handle_table_st {0}_handle_table;
+
+""".format(intf.name))
+    if (parser_args.snapshot):
+        f.write("""\
+extern size_t
+{0}_snapshot_private({0}_handle {0}_h, c_intf_snap_writer_handle writer);
+
+extern bool
+{0}_revive_private({0}_handle {0}_h, c_intf_snap_handle snap);
+
+""".format(intf.name))
+    f.write("#endif\n")
+    f.close()
+
+    try:
+        f = open(c_file_name, "w")
+    except IOError:
+        print "ERROR: Could not open {} for writing".format(c_file_name)
+        sys.exit(1)
+
+    # Write the implementation file
+    desc_str = "This is the implementation of the " + \
+               "{} interface.".format(intf.name)
+    write_header(f, desc_str, author, license)
+    f.write("#include <assert.h>\n")
+    if (intf.is_async()):
+        f.write("#include <sched.h>\n")
+    if (parser_args.record):
+        f.write("#include <string.h>\n")
+    if (parser_args.lean_headers):
+        f.write("#include <stdlib.h>\n")
+        f.write("#include <stddef.h>\n")
+        if (parser_args.bulk):
+            f.write("#include <stdint.h>\n")
+    f.write("#include \"{}\"\n\n".format(
+        os.path.basename(friend_header_file_name)))
+    if (not parser_args.static_init):
+        write_private_struct(f, intf, parser_args)
+
+    record_init_str = ""
+    if (parser_args.record):
+        generate_interface_record_code(f, intf)
+        record_init_str += \
+            "    {0}_h->private_h->record_object_id = (uintptr_t) {0}_h;\n"
+    if (parser_args.flight_recorder):
+        generate_interface_flight_code(f, intf)
+        record_init_str += "    {0}_h->private_h->flight_class = NULL;\n"
+    if (parser_args.handle_table):
+        record_init_str += "    {0}_h->private_h->handle_id = 0;\n"
+    if (parser_args.bulk):
+        record_init_str += "    {0}_h->private_h->embedded = false;\n"
+    if (parser_args.hot_swap):
+        record_init_str += "    {0}_h->private_h->shared_vtable =\n" + \
+                           "        &({0}_h->private_h->vtable);\n"
+    if (intf.is_threadsafe()):
+        record_init_str += "    {0}_h->private_h->lock.state = 0;\n"
+        if (parser_args.lock_stats):
+            generate_interface_lock_stats_code(f, intf)
+            record_init_str += "    {0}_h->private_h->lock_class = NULL;\n"
+    if (parser_args.snapshot):
+        generate_interface_snapshot_code(f, intf)
+    if (parser_args.handle_table and intf.base is None):
+        generate_interface_handle_table_code(f, intf)
+    if (parser_args.epochs):
+        generate_interface_epoch_code(f, intf)
+    if (parser_args.mem_stats or parser_args.bulk):
+        f.write("""\
+/**
+ * Get the size of the private data of objects, for friend classes counting
+ * the memory held by their objects or allocating it with them.
+ *
+ * @return The size
+ */
+size_t
+{0}_get_private_size (void)
+{{
+    return (sizeof({0}_private_st));
+}}
+
+""".format(intf.name))
+
+    if (parser_args.alloc_hooks):
+        free_private_str = "        c_intf_free(allocator, {0}_h->private_h);\n"
+        free_str = "c_intf_free(allocator, {0}_h)"
+        allocator_str = """\
+    const c_intf_allocator_st *allocator = NULL;
+
+"""
+        get_allocator_str = """\
+        allocator = {0}_h->private_h->allocator;
+"""
+    else:
+        free_private_str = "        free({0}_h->private_h);\n"
+        free_str = "free({0}_h)"
+        allocator_str = ""
+        get_allocator_str = ""
+    if (parser_args.bulk):
+        # The memory of objects created together is freed by their class
+        free_private_str = "        if (!{0}_h->private_h->embedded) {{\n" + \
+                           "    " + free_private_str + \
+                           "        }}\n"
+    release_id_str = ""
+    if (parser_args.handle_table):
+        release_id_str = """\
+        c_intf_handle_remove(&{1}_handle_table,
+                             {0}_h->private_h->handle_id);
+""".format(intf.name, intf.get_ancestors()[-1].name)
+
+    f.write("""\
+/**
+ * The internal function to delete a {0} object.  Upon return, the
+ * object is not longer valid.
+ *
+ * @param {0}_h The object.  If NULL, then this function is a no-op.
+ * @param free_{0}_h Indicates whether the base object should be freed
+ * or not.
+ * @see {0}_delete()
+ * @see {0}_friend_delete()
+ * @see {0}_private_delete()
+ */
+static void
+{0}_delete_internal ({0}_handle {0}_h, 
+    bool free_{0}_h)
+{{
+{allocator}\
+    if (NULL == {0}_h) {{
+        return;
+    }}
+
+    if (NULL != {0}_h->private_h) {{
+{release_id}\
+{get_allocator}\
+{free_private}\
+        {0}_h->private_h = NULL;
+    }}
+
+    if (free_{0}_h) {{
+        {free};
+    }}
+}}
+
+/**
+ * Allow a friend class to delete the {0} object.  It is assumed that
+ * the friend class is managing the memory for the {0} object and, thus,
+ * the object will not be freed.  However, members within the {0} object
+ * may be freed.  This does not call the virtual function table version of
+ * delete, but rather the delete specifically for type {0}.
+ *
+ * @param {0}_h The object.  If NULL, then this function is a no-op.
+ * @see {0}_delete()
+ */
+void
+{0}_friend_delete ({0}_handle {0}_h)
+{{
+    {0}_delete_internal({0}_h, false);
+}}
+
+""".format(intf.name, allocator=allocator_str.format(intf.name),
+           get_allocator=get_allocator_str.format(intf.name),
+           release_id=release_id_str,
+           free_private=free_private_str.format(intf.name),
+           free=free_str.format(intf.name)))
+
+    if (parser_args.hot_swap):
+        f.write("""\
+/**
+ * Get the vtable calls on an object use, which its class may swap at any
+ * time.
+ *
+ * @param {0}_h The object
+ * @return The vtable
+ */
+static inline const {0}_vtable_st *
+{0}_get_vtable ({0}_handle {0}_h)
+{{
+    return (__atomic_load_n({0}_h->private_h->shared_vtable,
+                            __ATOMIC_ACQUIRE));
+}}
+
+""".format(intf.name))
+
+    for fn in intf.functions.viewvalues():
+        f.write("""\
+/**
+ * {0} from {1}.
+ *
+ * @param {1}_h The object
+""".format(fn.name, intf.name))
+
+        if (not fn.is_void_input()):
+            for input in fn.inputs:
+                f.write(" * @param {} Input parameter\n".format(
+                    get_c_indentifier(input)))
+        f.write(" * @return {}\n".format(fn.return_type) + \
+                " */\n")
+
+        f.write("{}\n".format(fn.return_type))
+        real_name = "{}_{}".format(intf.name, fn.name)
+        f.write("{1} ({0}_handle {0}_h".format(intf.name, real_name))
+        if (not fn.is_void_input()):
+            for input in fn.inputs:
+                f.write(",\n{}{}".format(" " * (len(real_name) + 2), input))
+        f.write(")\n" + \
+                "{\n")
+        # Inherited functions take the handle of the declaring interface
+        owner = intf.get_owner(fn)
+        self_arg = "{}_h".format(intf.name)
+        if (owner is not intf):
+            self_arg = "({}_handle) {}".format(owner.name, self_arg)
+        # Deleting frees the lock, so it must not race with other calls
+        locked = intf.is_threadsafe() and (fn.name != "delete")
+        lock_mode = "read" if fn.readonly else "write"
+        vtable_str = get_vtable_str(intf, "{}_h".format(intf.name),
+                                    parser_args)
+        ret_name = "flight_ret" if parser_args.flight_recorder else "ret"
+        if (parser_args.flight_recorder):
+            f.write("    const char *flight_class;\n" + \
+                    "    uint64_t flight_start;\n")
+            if (fn.return_type != "void"):
+                f.write("    {} flight_ret;\n".format(fn.return_type))
+            f.write("\n")
+        elif (locked and (fn.return_type != "void")):
+            f.write("    {} ret;\n\n".format(fn.return_type))
+        f.write("""\
+    assert((NULL != {0}_h) &&
+           (NULL != {0}_h->private_h) &&
+           (NULL != {2}) &&
+           (NULL != {2}->{1}_fn));
+
+""".format(intf.name, fn.name, vtable_str))
+        if (parser_args.record):
+            f.write("""\
+    if (__atomic_load_n(&c_intf_record_enabled, __ATOMIC_RELAXED)) {{
+        {0}_record_{1}({2});
+    }}
+
+""".format(intf.name, fn.name,
+           ", ".join(["{}_h".format(intf.name)] +
+                     [get_c_indentifier(input)
+                      for input in get_scalar_inputs(fn)])))
+        # Get input parameters for function call
+        if (not parser_args.flight_recorder and not locked):
+            f.write("    return ({0}->{1}_fn({2}".format(
+                        vtable_str, fn.name, self_arg))
+            indent = 12
+        else:
+            if (parser_args.flight_recorder):
+                # Read before the call since delete frees the private data
+                f.write("""\
+    flight_class = {0}_h->private_h->flight_class;
+    flight_start = c_intf_flight_now();
+""".format(intf.name))
+            if (locked):
+                lock_str = "    c_intf_lock_{}(&({}_h->private_h->lock),"
+                lock_str = lock_str.format(lock_mode, intf.name)
+                f.write("{}\n{}{});\n".format(lock_str,
+                    " " * (lock_str.index("(") + 1),
+                    "{}_h->private_h->lock_class".format(intf.name)
+                        if parser_args.lock_stats else "NULL"))
+            call_prefix = "    {}{}->{}_fn(".format(
+                "{} = ".format(ret_name) if fn.return_type != "void" else "",
+                vtable_str, fn.name)
+            f.write("{}{}".format(call_prefix, self_arg))
+            indent = len(call_prefix)
+        for name in fn.get_input_names():
+            f.write(",\n{}{}".format(" " * indent, name))
+        if (not parser_args.flight_recorder and not locked):
+            f.write("));\n")
+        else:
+            f.write(");\n")
+            if (locked):
+                f.write("    c_intf_unlock_{}(&({}_h->private_h->lock));\n".
+                        format(lock_mode, intf.name))
+            if (parser_args.flight_recorder):
+                add_str = "    c_intf_flight_add(\"{}.{}\", flight_class,".\
+                          format(intf.name, fn.name)
+                if (len(add_str) + len(" flight_start);") > 79):
+                    add_str += "\n" + " " * 22
+                f.write("{} flight_start);\n".format(add_str))
+            if (fn.return_type != "void"):
+                f.write("\n    return ({});\n".format(ret_name))
+        f.write("}\n\n")
+
+    generate_interface_batch_code(f, intf, parser_args)
+
+    if (parser_args.static_init or parser_args.hot_swap):
+        generate_interface_check_vtable_code(f, intf)
+    if (not parser_args.static_init):
+        generate_interface_inherit_vtable_code(f, intf)
+
+    f.write("""\
+/**
+ * This is a function used by implementing classes to set the virtual table
+ * according with their methods.
+ *
+ * @param {0}_h The object
+ * @param vtable The virtual table specification for the implementing class.  If
+ * any function pointer is NULL, an error is returned.
+ * @return TRUE on success, FALSE otherwise
+ */
+bool
+{0}_set_vtable ({0}_handle {0}_h, 
+    {1}{0}_vtable_st *vtable)
+{{
+    bool rc;
+
+    if (((NULL == {0}_h) || (NULL == vtable) ||
+         (NULL == {0}_h->private_h))) {{
+        return (false);
+    }}
+    
+    rc = {2};
+
+    if (rc) {{
+        {0}_h->private_h->vtable = vtable;
+    }}
+
+    return (rc);
+}}
+
+""".format(intf.name, "const " if parser_args.static_init else "",
+           "{}_check_vtable(vtable)".format(intf.name)
+               if parser_args.static_init else
+               "{}_inherit_vtable(&{}_vtable, vtable, true)".format(
+                   intf.name, intf.name)))
+
+    if (parser_args.hot_swap):
+        generate_interface_hot_swap_code(f, intf, parser_args)
+
+    if (parser_args.alloc_hooks):
+        f.write("""\
+/**
+ * Allows a friend class to initialize their inner {0} object with the
+ * private data allocated from the given allocator.  Must be called before the
+ * {0} object is used.  If an error is returned, any clean-up was handled
+ * internally and there is no need to call a delete function.
+ *
+ * @param {0}_h The object
+ * @param allocator The allocator.  If NULL, the default allocator is used.
+ * @return TRUE on success, FALSE otherwise
+ * @see {0}_delete()
+ * @see {0}_friend_delete()
+ */
+bool
+{0}_init_with_allocator ({0}_handle {0}_h,
+    const c_intf_allocator_st *allocator)
+{{
+    if (NULL == {0}_h) {{
+        return (false);
+    }}
+
+    {0}_h->private_h = c_intf_alloc(allocator, sizeof(*{0}_h->private_h));
+    if (NULL == {0}_h->private_h) {{
+        return (false);
+    }}
+
+    {0}_h->private_h->vtable = NULL;
+    {0}_h->private_h->allocator = allocator;
+{record_init}\
+
+    return (true);
+}}
+
+/**
+ * Allows a friend class to initialize their inner {0} object with the
+ * private data allocated from the global allocator.
+ *
+ * @param {0}_h The object
+ * @return TRUE on success, FALSE otherwise
+ * @see {0}_init_with_allocator()
+ */
+bool
+{0}_init ({0}_handle {0}_h)
+{{
+    return ({0}_init_with_allocator({0}_h, c_intf_get_allocator()));
+}}
+""".format(intf.name, record_init=record_init_str.format(intf.name)))
+    else:
+        f.write("""\
+/**
+ * Allows a friend class to initialize their inner {0} object.  Must be
+ * called before the {0} object is used.  If an error is returned, any
+ * clean-up was handled internally and there is no need to call a delete
+ * function.
+ *
+ * @param {0}_h The object
+ * @return TRUE on success, FALSE otherwise
+ * @see {0}_delete()
+ * @see {0}_friend_delete()
+ */
+bool
+{0}_init ({0}_handle {0}_h)
+{{
+    if (NULL == {0}_h) {{
+        return (false);
+    }}
+
+    {0}_h->private_h = calloc(1, sizeof(*{0}_h->private_h));
+    if (NULL == {0}_h->private_h) {{
+        goto err_exit;
+    }}
+
+    {0}_h->private_h->vtable = NULL;
+{record_init}\
+
+    return (true);
+
+err_exit:
+
+    if (NULL != {0}_h->private_h) {{
+        free({0}_h->private_h);
+        {0}_h->private_h = NULL;
+    }}
+
+    return (false);
+}}
+""".format(intf.name, record_init=record_init_str.format(intf.name)))
+
+    if (parser_args.bulk):
+        generate_interface_bulk_code(f, intf, parser_args)
+
+    if (intf.is_async()):
+        generate_interface_async_code(f, intf, parser_args)
+
+    if (intf.is_shm()):
+        generate_interface_shm_code(f, intf)
+
+    if (parser_args.parallel_calls):
+        generate_interface_parallel_code(f, intf)
+
+    f.close()
+
+def get_own_functions (intf):
+    """Get the functions declared by the interface rather than inherited from
+       the interface it extends"""
+    return [fn for fn in intf.functions.viewvalues()
+            if intf.get_owner(fn) is intf]
+
+def get_batch_functions (intf):
+    """Get the functions declared by the interface marked BATCH"""
+    return [fn for fn in get_own_functions(intf) if fn.batch]
+
+def get_vtable_slots (intf):
+    """Get the (declaring interface, function, is batch version) of each slot
+       of the vtable of the interface.  The slots of the interface it extends
+       come first, in the same order, so its vtable is a prefix of this one.
+       The batch versions of the functions declared by an interface come
+       after all its other functions."""
+    slots = []
+    if (intf.base is not None):
+        slots = get_vtable_slots(intf.base)
+    own = get_own_functions(intf)
+    return (slots + [(intf, fn, False) for fn in own] +
+            [(intf, fn, True) for fn in own if fn.batch])
+
+def get_vtable_str (intf, handle_str, parser_args):
+    """Get the expression of the vtable the calls on an object use"""
+    if (parser_args.hot_swap):
+        return ("{}_get_vtable({})".format(intf.name, handle_str))
+    return ("{}->private_h->vtable".format(handle_str))
+
+def get_slot_name (slot):
+    """Get the name of a vtable slot, without the _fn suffix"""
+    (owner, fn, is_batch) = slot
+    return ("{}_n".format(fn.name) if is_batch else fn.name)
+
+def get_batch_defaults (intf):
+    """Get the vtable entries of the default batch functions, for vtables
+       which do not implement them"""
+    return ["    {}_{}_n_default".format(intf.name, fn.name)
+            for fn in get_batch_functions(intf)]
+
+def get_batch_params_str (intf, fn, sep):
+    """Get the parameters of the batch version of a function"""
+    params = ["const {0}_handle *{0}_handles".format(intf.name),
+              "size_t num_handles"]
+    if (fn.return_type != "void"):
+        params.append("{} *results".format(fn.return_type))
+    if (not fn.is_void_input()):
+        params.extend(fn.inputs)
+    return (sep.join(params))
+
+def get_batch_args_str (intf, fn, offset_str=""):
+    """Get the arguments of a call to the batch version of a function passing
+       the parameters through, with the arrays offset by offset_str"""
+    args = ["{}_handles{}".format(intf.name, offset_str),
+            "num_handles" if offset_str == "" else "end - start"]
+    if (fn.return_type != "void"):
+        args.append("results{}".format(offset_str))
+    return (", ".join(args + fn.get_input_names()))
+
+def generate_interface_batch_code (f, intf, parser_args):
+    """Generate the batch versions of the functions marked BATCH, which call
+       the batch function of each run of objects sharing a vtable, and the
+       default batch functions calling the function on each object"""
+
+    for fn in get_batch_functions(intf):
+        real_name = "{}_{}_n_default".format(intf.name, fn.name)
+        f.write("""\
+/**
+ * The batch version of {1} for classes which do not implement it, calling
+ * {1} on each object in turn.
+ *
+ * @param {0}_handles The objects
+ * @param num_handles The number of objects
+""".format(intf.name, fn.name))
+        if (fn.return_type != "void"):
+            f.write(" * @param results Where the return value of each " + \
+                    "object is stored\n")
+        for name in fn.get_input_names():
+            f.write(" * @param {} Input parameter\n".format(name))
+        f.write("""\
+ */
+void
+{1} ({2})
+{{
+    size_t i;
+
+    for (i = 0; i < num_handles; i++) {{
+        {3}{6}->{4}_fn({5});
+    }}
+}}
+
+""".format(intf.name, real_name,
+           get_batch_params_str(intf, fn,
+                                ",\n" + " " * (len(real_name) + 2)),
+           "results[i] = " if fn.return_type != "void" else "", fn.name,
+           fn.get_args_str("{}_handles[i]".format(intf.name)),
+           get_vtable_str(intf, "{}_handles[i]".format(intf.name),
+                          parser_args)))
+
+        real_name = "{}_{}_n".format(intf.name, fn.name)
+        f.write("""\
+/**
+ * {1} from {0} on many objects.  The objects are split into runs of objects
+ * of the same class, each passed to the batch function of its class with a
+ * single call.
+ *
+ * @param {0}_handles The objects
+ * @param num_handles The number of objects
+""".format(intf.name, fn.name))
+        if (fn.return_type != "void"):
+            f.write(" * @param results Where the return value of each " + \
+                    "object is stored\n")
+        for name in fn.get_input_names():
+            f.write(" * @param {} Input parameter\n".format(name))
+        f.write("""\
+ */
+void
+{1} ({2})
+{{
+    const {0}_vtable_st *vtable;
+    size_t start;
+    size_t end;
+""".format(intf.name, real_name,
+           get_batch_params_str(intf, fn,
+                                ",\n" + " " * (len(real_name) + 2))))
+        if (parser_args.record):
+            f.write("    size_t i;\n")
+        if (parser_args.flight_recorder):
+            f.write("    const char *flight_class;\n" + \
+                    "    uint64_t flight_start;\n")
+        f.write("""
+    if (0 == num_handles) {{
+        return;
+    }}
+    assert((NULL != {0}_handles) &&
+           (NULL != {0}_handles[0]) &&
+           (NULL != {0}_handles[0]->private_h));
+
+""".format(intf.name))
+        if (parser_args.record):
+            f.write("""\
+    /* Recorded as calls on each object, so they can be replayed one by one */
+    if (__atomic_load_n(&c_intf_record_enabled, __ATOMIC_RELAXED)) {{
+        for (i = 0; i < num_handles; i++) {{
+            {0}_record_{1}({2});
+        }}
+    }}
+
+""".format(intf.name, fn.name,
+           ", ".join(["{}_handles[i]".format(intf.name)] +
+                     [get_c_indentifier(input)
+                      for input in get_scalar_inputs(fn)])))
+        if (parser_args.flight_recorder):
+            f.write("""\
+    flight_class = {0}_handles[0]->private_h->flight_class;
+    flight_start = c_intf_flight_now();
+
+""".format(intf.name))
+        f.write("""\
+    for (start = 0; start < num_handles; start = end) {{
+        vtable = {3};
+        assert((NULL != vtable) && (NULL != vtable->{1}_n_fn));
+        for (end = start + 1;
+             (end < num_handles) &&
+             ({4} == vtable);
+             end++) {{
+        }}
+        vtable->{1}_n_fn({2});
+    }}
+""".format(intf.name, fn.name, get_batch_args_str(intf, fn, " + start"),
+           get_vtable_str(intf, "{}_handles[start]".format(intf.name),
+                          parser_args),
+           get_vtable_str(intf, "{}_handles[end]".format(intf.name),
+                          parser_args)))
+        if (parser_args.flight_recorder):
+            f.write("""
+    c_intf_flight_add("{0}.{1}_n", flight_class, flight_start);
+""".format(intf.name, fn.name))
+        f.write("}\n\n")
+
+def generate_interface_inherit_vtable_code (f, intf):
+    """Generate the function inheriting the functions of the interface vtable
+       into a child vtable"""
+
+    f.write("""\
+/**
+ * The virtual function table used for objects of type {0}.  As this is
+ * an interface, all functions should be NULL{1}.
+ */
+static const {0}_vtable_st {0}_vtable = {{
+""".format(intf.name,
+           ", except for the batch functions\n * calling the function " + \
+           "on each object" if any(slot[2] for slot in get_vtable_slots(intf))
+               else ""))
+    f.write(",\n".join(["    {}_{}_n_default".format(owner.name, fn.name)
+                        if is_batch else "    NULL"
+                        for (owner, fn, is_batch) in get_vtable_slots(intf)]))
+    f.write("\n};\n\n")
+
+    f.write("""\
+/**
+ * Fill in the child vtable with values inherited from the parent_vtable for all
+ * functions left NULL in the child vtable.
+ *
+ * @param parent_vtable The parent vtable from which to inherit.
+ * @param child_vtable The child vtable to which functions may be inherited.
+ * @param do_null_check Indicates whether an error should be thrown if a
+ * function in the child vtable is NULL after inheritance.
+ * @return TRUE on success, FALSE otherwise
+ */
+static bool
+{0}_inherit_vtable (const {0}_vtable_st *parent_vtable,
+    {0}_vtable_st *child_vtable,
+    bool do_null_check)
+{{
+    if ((NULL == parent_vtable) || (NULL == child_vtable)) {{
+        return (false);
+    }}
+
+""".format(intf.name))
+
+    for slot in map(get_slot_name, get_vtable_slots(intf)):
+        f.write("""\
+    if (NULL == child_vtable->{0}_fn) {{
+        child_vtable->{0}_fn = parent_vtable->{0}_fn;
+        if (do_null_check && (NULL == child_vtable->{0}_fn)) {{
+            return (false);
+        }}
+    }}
+
+""".format(slot))
+    f.write("    return (true);\n" + \
+            "}\n\n")
+
+def generate_interface_hot_swap_code (f, intf, parser_args):
+    """Generate the functions letting friend classes swap the vtable of all
+       their objects at once"""
+
+    f.write("""\
+/**
+ * Make calls on an object read its vtable from one shared by all the
+ * objects of a friend class, which can swap it for all of them at once.
+ * Must be called after {0}_set_vtable().
+ *
+ * @param {0}_h The object
+ * @param shared_vtable The vtable shared by the objects of the class, which
+ * must outlive the object
+ */
+void
+{0}_set_shared_vtable ({0}_handle {0}_h,
+    const {0}_vtable_st **shared_vtable)
+{{
+    if ((NULL == {0}_h) || (NULL == {0}_h->private_h) ||
+        (NULL == shared_vtable)) {{
+        return;
+    }}
+
+    {0}_h->private_h->shared_vtable = shared_vtable;
+}}
+
+/** A vtable swapped in, with the functions it left NULL inherited */
+typedef struct {0}_vtable_copy_st_ {{
+    /** The vtable of the class the functions were inherited from */
+    const {0}_vtable_st *parent_vtable;
+    /** The vtable swapped in */
+    const {0}_vtable_st *vtable;
+    /** The vtable with the inherited functions */
+    {0}_vtable_st copy;
+    /** The next copy */
+    struct {0}_vtable_copy_st_ *next;
+}} {0}_vtable_copy_st;
+
+/** The copies made by {0}_prepare_vtable(), never freed */
+static {0}_vtable_copy_st *{0}_vtable_copies;
+
+/**
+ * Find the copy made for a vtable swapped in.
+ *
+ * @param first The first copy to look at
+ * @param last The copy to stop at, NULL to look at all of them
+ * @param parent_vtable The vtable of the class
+ * @param vtable The vtable swapped in
+ * @return The copy or NULL if there is none
+ */
+static {0}_vtable_copy_st *
+{0}_find_vtable_copy ({0}_vtable_copy_st *first,
+    {0}_vtable_copy_st *last,
+    const {0}_vtable_st *parent_vtable,
+    const {0}_vtable_st *vtable)
+{{
+    {0}_vtable_copy_st *copy;
+
+    for (copy = first; last != copy; copy = copy->next) {{
+        if ((parent_vtable == copy->parent_vtable) &&
+            (vtable == copy->vtable)) {{
+            return (copy);
+        }}
+    }}
+
+    return (NULL);
+}}
+
+/**
+ * Get the vtable a friend class swaps in for the one shared by its objects.
+ * A complete vtable is used as is, otherwise the functions left NULL are
+ * inherited in a copy, so the vtable given is never written and must not
+ * change.  The copy is made once per vtable and kept, so switching back and
+ * forth between implementations does not allocate each time.
+ *
+ * @param parent_vtable The vtable of the class, from which the functions
+ * left NULL are inherited
+ * @param vtable The new vtable
+ * @return The vtable to swap in, NULL if it is incomplete or could not be
+ * copied
+ */
+const {0}_vtable_st *
+{0}_prepare_vtable (const {0}_vtable_st *parent_vtable,
+    const {0}_vtable_st *vtable)
+{{
+    {0}_vtable_copy_st *head;
+    {0}_vtable_copy_st *copy;
+    {0}_vtable_copy_st *found;
+
+    if ((NULL == parent_vtable) || (NULL == vtable)) {{
+        return (NULL);
+    }}
+
+    if ({0}_check_vtable(vtable)) {{
+        return (vtable);
+    }}
+
+    head = __atomic_load_n(&{0}_vtable_copies, __ATOMIC_ACQUIRE);
+    copy = {0}_find_vtable_copy(head, NULL, parent_vtable, vtable);
+    if (NULL != copy) {{
+        return (&(copy->copy));
+    }}
+
+    copy = malloc(sizeof(*copy));
+    if (NULL == copy) {{
+        return (NULL);
+    }}
+    copy->parent_vtable = parent_vtable;
+    copy->vtable = vtable;
+    copy->copy = *vtable;
+
+""".format(intf.name))
+
+    for slot in map(get_slot_name, get_vtable_slots(intf)):
+        f.write("""\
+    if (NULL == copy->copy.{0}_fn) {{
+        copy->copy.{0}_fn = parent_vtable->{0}_fn;
+    }}
+""".format(slot))
+    f.write("""
+    if (!{0}_check_vtable(&(copy->copy))) {{
+        free(copy);
+        return (NULL);
+    }}
+
+    /* A copy of the same vtable added meanwhile is used instead */
+    copy->next = head;
+    while (!__atomic_compare_exchange_n(&{0}_vtable_copies,
+                &(copy->next), copy, true, __ATOMIC_RELEASE,
+                __ATOMIC_ACQUIRE)) {{
+        found = {0}_find_vtable_copy(copy->next, head, parent_vtable,
+                                     vtable);
+        if (NULL != found) {{
+            free(copy);
+            return (&(found->copy));
+        }}
+        head = copy->next;
+    }}
+
+    return (&(copy->copy));
+}}
+
+""".format(intf.name))
+
+def generate_interface_lock_stats_code (f, intf):
+    """Generate the function setting the class counting the lock contention
+       of objects"""
+
+    f.write("""\
+/**
+ * Set the class whose lock contention counts the calls on an object.  By
+ * default, they are not counted.
+ *
+ * @param {0}_h The object
+ * @param lock_class The class, which must outlive the object
+ */
+void
+{0}_set_lock_class ({0}_handle {0}_h, c_intf_lock_class_st *lock_class)
+{{
+    if ((NULL == {0}_h) || (NULL == {0}_h->private_h)) {{
+        return;
+    }}
+
+    {0}_h->private_h->lock_class = lock_class;
+}}
+
+""".format(intf.name))
+
+def generate_interface_snapshot_code (f, intf):
+    """Generate the functions writing the private data of the interface to
+       snapshots and reviving it"""
+
+    f.write("""\
+/**
+ * Write the private data of an object to a snapshot.  Called by the
+ * <class>_snapshot() of friend classes, which store the offset returned in
+ * place of the private data pointer.
+ *
+ * @param {0}_h The object
+ * @param writer The snapshot
+ * @return The offset of the private data or 0 on failure
+ */
+size_t
+{0}_snapshot_private ({0}_handle {0}_h, c_intf_snap_writer_handle writer)
+{{
+    if ((NULL == {0}_h) || (NULL == {0}_h->private_h)) {{
+        return (0);
+    }}
+
+    /* The block is zeroed, the class sets the private data again when the
+     * object is revived */
+    return (c_intf_snap_alloc(writer, sizeof({0}_private_st)));
+}}
+
+/**
+ * Turn the offset of the private data of an object mapped from a snapshot
+ * back into a pointer.  Called by the fixup of friend classes, which then
+ * set the vtable.
+ *
+ * @param {0}_h The object
+ * @param snap The snapshot
+ * @return TRUE on success, FALSE if the offset is not valid
+ */
+bool
+{0}_revive_private ({0}_handle {0}_h, c_intf_snap_handle snap)
+{{
+    {0}_h->private_h = c_intf_snap_get_ptr(snap,
+                           (size_t) (uintptr_t) {0}_h->private_h,
+                           sizeof(*{0}_h->private_h));
+    if (NULL == {0}_h->private_h) {{
+        return (false);
+    }}
+
+    return (true);
+}}
+
+""".format(intf.name))
+
+def generate_interface_handle_table_code (f, intf):
+    """Generate the functions giving 32-bit ids to the objects of the
+       interface and resolving them"""
+
+    f.write("""\
+/** The ids of the objects */
+c_intf_handle_table_st {0}_handle_table;
+
+/**
+ * Get the id of an object, giving it one the first time.  The id is valid
+ * until the object is deleted.
+ *
+ * @param {0}_h The object
+ * @return The id or C_INTF_HANDLE_NONE if the table is full or on allocation
+ * failure
+ */
+{0}_id
+{0}_get_id ({0}_handle {0}_h)
+{{
+    uint32_t expected = C_INTF_HANDLE_NONE;
+    uint32_t id;
+
+    if ((NULL == {0}_h) || (NULL == {0}_h->private_h)) {{
+        return (C_INTF_HANDLE_NONE);
+    }}
+
+    id = __atomic_load_n(&({0}_h->private_h->handle_id), __ATOMIC_ACQUIRE);
+    if (C_INTF_HANDLE_NONE != id) {{
+        return (id);
+    }}
+
+    id = c_intf_handle_add(&{0}_handle_table, {0}_h);
+    if (C_INTF_HANDLE_NONE == id) {{
+        return (C_INTF_HANDLE_NONE);
+    }}
+
+    /* Another thread may have given the object an id first */
+    if (!__atomic_compare_exchange_n(&({0}_h->private_h->handle_id),
+                                     &expected, id, false, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE)) {{
+        c_intf_handle_remove(&{0}_handle_table, id);
+        id = expected;
+    }}
+
+    return (id);
+}}
+
+/**
+ * Get the object of an id in O(1), without locking.
+ *
+ * @param id The id from {0}_get_id()
+ * @return The object or NULL if it was deleted or the id is invalid
+ */
+{0}_handle
+{0}_resolve ({0}_id id)
+{{
+    return (c_intf_handle_resolve(&{0}_handle_table, id));
+}}
+
+""".format(intf.name))
+
+def generate_interface_epoch_code (f, intf):
+    """Generate the function deleting an object of the interface once the
+       read sections which may use it are exited"""
+
+    f.write("""\
+/**
+ * Delete a retired object.
+ *
+ * @param obj The object
+ */
+static void
+{0}_delete_retired (void *obj)
+{{
+    {0}_delete(obj);
+}}
+
+/**
+ * Delete an object once the read sections of other threads which may use it
+ * are exited, without waiting for them.  The object must already be
+ * unreachable for read sections entered from now on, e.g. replaced in the
+ * structure readers get it from.
+ *
+ * @param {0}_h The object
+ */
+void
+{0}_retire ({0}_handle {0}_h)
+{{
+    if (NULL == {0}_h) {{
+        return;
+    }}
+
+    c_intf_epoch_retire({0}_delete_retired, {0}_h);
+}}
+
+""".format(intf.name))
+
+def generate_interface_bulk_code (f, intf, parser_args):
+    """Generate the functions initializing and deleting many objects of the
+       interface at once"""
+
+    f.write("""\
+
+/**
+ * Allows a friend class to initialize the inner {0} objects of many objects
+ * at once, with their private data in memory the friend class manages and
+ * the same vtable, which is checked only once.  Must be called before the
+ * {0} objects are used.  Nothing needs to be cleaned up on failure.
+ *
+ * @param {0}_h The {0} object of the first object
+ * @param stride The distance in bytes between the {0} objects
+ * @param count The number of objects
+ * @param private_mem The memory of the private data, count times
+ * {0}_get_private_size() bytes aligned for any type, which the friend class
+ * frees after deleting the objects
+ * @param vtable The virtual table specification for the implementing class
+ * @return TRUE on success, FALSE otherwise
+ * @see {0}_set_vtable()
+ */
+bool
+{0}_init_n ({0}_handle {0}_h, size_t stride, size_t count,
+    void *private_mem, {1}{0}_vtable_st *vtable)
+{{
+    {0}_private_st *private_h = private_mem;
+    size_t i;
+
+    if ((NULL == {0}_h) || (NULL == private_mem) || (NULL == vtable) ||
+        !{2}) {{
+        return (false);
+    }}
+
+    for (i = 0; i < count; i++) {{
+        private_h[i] = ({0}_private_st) {{ .vtable = vtable,
+                                          .embedded = true }};
+{3}\
+        {0}_h->private_h = &(private_h[i]);
+        {0}_h = ({0}_handle) ((uint8_t *) {0}_h + stride);
+    }}
+
+    return (true);
+}}
+
+/**
+ * Delete many {0} objects, e.g. ones created together.  The handles are set
+ * to NULL.
+ *
+ * @param {0}_handles The objects, NULL ones are skipped
+ * @param num_handles The number of objects
  * @see {0}_delete()
- * @see {0}_friend_delete()
- * @see {0}_private_delete()
  */
-static void
-{0}_delete_internal ({0}_handle {0}_h, 
-    bool free_{0}_h)
+void
+{0}_delete_n ({0}_handle *{0}_handles, size_t num_handles)
+{{
+    size_t i;
+
+    if (NULL == {0}_handles) {{
+        return;
+    }}
+
+    for (i = 0; i < num_handles; i++) {{
+        if (i + 1 < num_handles) {{
+            /* Start loading the next object while this one is deleted */
+            __builtin_prefetch({0}_handles[i + 1]);
+        }}
+        if (NULL != {0}_handles[i]) {{
+            {0}_delete({0}_handles[i]);
+            {0}_handles[i] = NULL;
+        }}
+    }}
+}}
+""".format(intf.name, "const " if parser_args.static_init else "",
+           "{}_check_vtable(vtable)".format(intf.name)
+               if parser_args.static_init else
+               "{0}_inherit_vtable(&{0}_vtable, vtable, true)".format(
+                   intf.name),
+           ("        private_h[i].record_object_id = (uintptr_t) {}_h;\n".
+               format(intf.name) if parser_args.record else "") +
+           ("        private_h[i].shared_vtable = &(private_h[i].vtable);\n"
+               if parser_args.hot_swap else "")))
+
+def generate_interface_check_vtable_code (f, intf):
+    """Generate the function checking that a vtable is complete, for the
+       vtables nothing can be inherited into since they are const, with
+       --static-init or swapped in with --hot-swap"""
+
+    f.write("""\
+/**
+ * Check that a child vtable has all its functions.  As this is an interface,
+ * there is nothing to inherit, so a complete vtable can be used as is.
+ *
+ * @param vtable The child vtable
+ * @return TRUE if no function is NULL, FALSE otherwise
+ */
+static bool
+{0}_check_vtable (const {0}_vtable_st *vtable)
+{{
+    return ({1});
+}}
+
+""".format(intf.name,
+           " &&\n            ".join("(NULL != vtable->{}_fn)".format(slot)
+                                    for slot in map(get_slot_name,
+                                                    get_vtable_slots(intf)))))
+
+def generate_interface_async_code (f, intf, parser_args):
+    """Generate the asynchronous proxy of the interface"""
+
+    fns = [fn for fn in intf.functions.viewvalues() if fn.name != "delete"]
+
+    f.write("""\
+
+/** Identifiers of the functions which can be queued */
+typedef enum {0}_async_fn_id_ {{
+""".format(intf.name))
+    f.write(",\n".join("    {}_ASYNC_{}".format(intf.name.upper(),
+                                               fn.name.upper())
+                       for fn in fns))
+    f.write("""
+}} {0}_async_fn_id;
+
+/** A queued call */
+typedef struct {0}_async_call_st_ {{
+    /** Sequence number used to hand the slot between threads */
+    size_t seq;
+    /** The function to call */
+    {0}_async_fn_id fn_id;
+    /** Where to store the return value, NULL if the caller does not wait */
+    void *ret;
+    /** Set when the call was run if the caller waits */
+    int *done;
+    /** Copies of the arguments */
+    union {{
+        /** Placeholder so the union is never empty */
+        char unused;
+""".format(intf.name))
+    for fn in fns:
+        if (len(fn.get_input_names()) == 0):
+            continue
+        f.write("        /** Arguments of {} */\n".format(fn.name) + \
+                "        struct {\n")
+        for input in fn.inputs:
+            f.write("            {};\n".format(get_member_decl(input)))
+        f.write("        }} {};\n".format(fn.name))
+    f.write("""\
+    }} args;
+}} {0}_async_call_st;
+
+/** A proxy queueing calls to be run on the target by another thread */
+typedef struct {0}_async_st_ {{
+    /** The proxy, must be first */
+    {0}_st {0};
+    /** The object the calls are run on */
+    {0}_handle target_h;
+    /** The number of slots in the ring minus one */
+    size_t mask;
+    /** Position of the next call to be queued */
+    size_t tail;
+    /** Position of the next call to be run */
+    size_t head;
+    /** The ring of queued calls */
+    {0}_async_call_st *ring;
+}} {0}_async_st;
+
+/**
+ * Reserve a slot in the ring of the proxy, waiting while it is full.
+ *
+ * @param {0}_async The proxy
+ * @param pos Set to the position of the slot
+ * @return The slot
+ */
+static {0}_async_call_st *
+{0}_async_reserve ({0}_async_st *{0}_async, size_t *pos)
+{{
+    {0}_async_call_st *call;
+    size_t seq;
+    intptr_t dif;
+
+    *pos = __atomic_load_n(&({0}_async->tail), __ATOMIC_RELAXED);
+    for (;;) {{
+        call = &({0}_async->ring[*pos & {0}_async->mask]);
+        seq = __atomic_load_n(&(call->seq), __ATOMIC_ACQUIRE);
+        dif = (intptr_t) seq - (intptr_t) *pos;
+        if (0 == dif) {{
+            if (__atomic_compare_exchange_n(&({0}_async->tail), pos,
+                    *pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {{
+                return (call);
+            }}
+        }} else if (dif < 0) {{
+            /* Full, wait for the owner to drain */
+            sched_yield();
+            *pos = __atomic_load_n(&({0}_async->tail), __ATOMIC_RELAXED);
+        }} else {{
+            *pos = __atomic_load_n(&({0}_async->tail), __ATOMIC_RELAXED);
+        }}
+    }}
+}}
+
+/**
+ * Publish a call filled in a reserved slot and, if the caller waits for it,
+ * wait until it was run.
+ *
+ * @param call The slot
+ * @param pos The position of the slot
+ * @param done The flag set when the call was run, NULL to not wait
+ */
+static void
+{0}_async_publish ({0}_async_call_st *call, size_t pos, int *done)
+{{
+    call->done = done;
+    __atomic_store_n(&(call->seq), pos + 1, __ATOMIC_RELEASE);
+
+    if (NULL != done) {{
+        while (!__atomic_load_n(done, __ATOMIC_ACQUIRE)) {{
+            sched_yield();
+        }}
+    }}
+}}
+
+""".format(intf.name))
+
+    for fn in fns:
+        real_name = "{}_async_{}".format(intf.name, fn.name)
+        is_void = (fn.return_type == "void")
+        f.write("""\
+/**
+ * Queue a call to {1} on the target of the proxy.
+ *
+ * @param {0}_h The proxy
+""".format(intf.name, fn.name))
+        for name in fn.get_input_names():
+            f.write(" * @param {} Input parameter\n".format(name))
+        if (is_void):
+            f.write(" */\n")
+        else:
+            f.write(" * @return The return value once the call was run\n" + \
+                    " */\n")
+        f.write("""\
+static {1}
+{2} ({3})
+{{
+    {0}_async_st *{0}_async = ({0}_async_st *) {0}_h;
+    {0}_async_call_st *call;
+""".format(intf.name, fn.return_type, real_name,
+           fn.get_params_str("{}_handle".format(intf.name),
+                             "{}_h".format(intf.name),
+                             ",\n" + " " * (len(real_name) + 2))))
+        if (not is_void):
+            f.write("    {} ret;\n".format(fn.return_type) + \
+                    "    int done = 0;\n")
+        f.write("""\
+    size_t pos;
+
+    call = {0}_async_reserve({0}_async, &pos);
+    call->fn_id = {1}_ASYNC_{2};
+    call->ret = {3};
+""".format(intf.name, intf.name.upper(), fn.name.upper(),
+           "NULL" if is_void else "&ret"))
+        for name in fn.get_input_names():
+            f.write("    call->args.{0}.{1} = {1};\n".format(fn.name, name))
+        if (is_void):
+            f.write("    {}_async_publish(call, pos, NULL);\n".format(
+                        intf.name))
+        else:
+            f.write("    {}_async_publish(call, pos, &done);\n\n".format(
+                        intf.name) + \
+                    "    return (ret);\n")
+        f.write("}\n\n")
+
+    f.write("""\
+/**
+ * Run up to max_calls queued calls on the target of the proxy.  Must only be
+ * called by the thread owning the target.
+ *
+ * @param proxy_h The proxy
+ * @param max_calls The maximum number of calls to run
+ * @return The number of calls run
+ */
+size_t
+{0}_async_drain ({0}_handle proxy_h, size_t max_calls)
+{{
+    {0}_async_st *{0}_async = ({0}_async_st *) proxy_h;
+    {0}_async_call_st *call;
+    size_t count = 0;
+    size_t pos;
+
+    if (NULL == {0}_async) {{
+        return (0);
+    }}
+
+    pos = {0}_async->head;
+    while (count < max_calls) {{
+        call = &({0}_async->ring[pos & {0}_async->mask]);
+        if (__atomic_load_n(&(call->seq), __ATOMIC_ACQUIRE) != pos + 1) {{
+            break;
+        }}
+
+        switch (call->fn_id) {{
+""".format(intf.name))
+    for fn in fns:
+        f.write("        case {}_ASYNC_{}:\n".format(intf.name.upper(),
+                                                   fn.name.upper()))
+        call_str = "{}_{}({})".format(intf.name, fn.name,
+                                      fn.get_args_str(
+                                          "{}_async->target_h".format(
+                                              intf.name),
+                                          "call->args.{}.".format(fn.name),
+                                          ",\n" + " " * 16))
+        if (fn.return_type == "void"):
+            f.write("            {};\n".format(call_str))
+        else:
+            f.write("            *(({} *) call->ret) =\n".format(
+                        fn.return_type) + \
+                    "                {};\n".format(call_str))
+        f.write("            break;\n")
+    f.write("""\
+        }}
+
+        if (NULL != call->done) {{
+            __atomic_store_n(call->done, 1, __ATOMIC_RELEASE);
+        }}
+        __atomic_store_n(&(call->seq), pos + {0}_async->mask + 1,
+                         __ATOMIC_RELEASE);
+        pos++;
+        count++;
+    }}
+    {0}_async->head = pos;
+
+    return (count);
+}}
+
+/**
+ * Delete the proxy, but not its target.  Must only be called once no other
+ * thread uses the proxy and its queue was drained.
+ *
+ * @param {0}_h The proxy
+ */
+static void
+{0}_async_delete ({0}_handle {0}_h)
+{{
+    {0}_async_st *{0}_async = ({0}_async_st *) {0}_h;
+
+    if (NULL == {0}_async) {{
+        return;
+    }}
+
+    {0}_friend_delete(&({0}_async->{0}));
+    free({0}_async->ring);
+    free({0}_async);
+}}
+
+/** The virtual function table of proxies */
+static {0}_vtable_st {0}_async_vtable = {{
+""".format(intf.name))
+    f.write(",\n".join(["    {}_async_{}".format(intf.name, fn.name)
+                        for fn in intf.functions.viewvalues()] +
+                       get_batch_defaults(intf)))
+    f.write("""
+}};
+
+/**
+ * Create a proxy implementing the {0} interface which queues the calls made
+ * on it until the thread owning the target runs them with
+ * {0}_async_drain().
+ *
+ * @param target_h The object the calls are run on
+ * @param capacity The number of calls which can be queued, rounded up to a
+ * power of two.  If 0, the capacity from the description file is used.
+ * @return The proxy or NULL if creation failed
+ */
+{0}_handle
+{0}_async_new ({0}_handle target_h, size_t capacity)
+{{
+    {0}_async_st *{0}_async = NULL;
+    size_t size = 1;
+    size_t i;
+
+    if (NULL == target_h) {{
+        return (NULL);
+    }}
+
+    if (0 == capacity) {{
+        capacity = {1};
+    }}
+    while (size < capacity) {{
+        size <<= 1;
+    }}
+
+    {0}_async = calloc(1, sizeof(*{0}_async));
+    if (NULL == {0}_async) {{
+        return (NULL);
+    }}
+
+    {0}_async->ring = calloc(size, sizeof(*({0}_async->ring)));
+    if (NULL == {0}_async->ring) {{
+        free({0}_async);
+        return (NULL);
+    }}
+    for (i = 0; i < size; i++) {{
+        {0}_async->ring[i].seq = i;
+    }}
+    {0}_async->mask = size - 1;
+    {0}_async->target_h = target_h;
+
+    if (!{0}_init(&({0}_async->{0}))) {{
+        free({0}_async->ring);
+        free({0}_async);
+        return (NULL);
+    }}
+
+    if (!{0}_set_vtable(&({0}_async->{0}), &{0}_async_vtable)) {{
+        {0}_async_delete(&({0}_async->{0}));
+        return (NULL);
+    }}
+""".format(intf.name, intf.async_capacity))
+    if (parser_args.record):
+        f.write("    {}_async->{}.private_h->record_skip = true;\n".format(
+                    intf.name, intf.name))
+    f.write("""
+    return (&({0}_async->{0}));
+}}
+""".format(intf.name))
+
+def get_fnv1a_hash (s):
+    """Get the 32-bit FNV-1a hash of a string"""
+    h = 0x811c9dc5
+    for c in s:
+        h = ((h ^ ord(c)) * 0x01000193) & 0xffffffff
+    return (h)
+
+def get_interface_id (intf):
+    """Get a 32-bit hash of the interface name and its function signatures,
+       so processes built from different descriptions of an interface don't
+       talk to each other"""
+    sig = intf.name
+    for fn in intf.functions.viewvalues():
+        sig += ";{} {}({})".format(fn.return_type, fn.name,
+                                   ",".join(fn.inputs))
+    return (get_fnv1a_hash(sig))
+
+def generate_interface_shm_code (f, intf):
+    """Generate the client stub and server skeleton used to call objects in
+       another process through shared memory"""
+
+    fns = [fn for fn in intf.functions.viewvalues() if fn.name != "delete"]
+
+    f.write("""
+/** Identifies the {0} interface and its function signatures */
+#define {1}_SHM_ID 0x{2:08x}U
+
+/** Identifiers of the functions which can be called through shared memory */
+typedef enum {0}_shm_fn_id_ {{
+""".format(intf.name, intf.name.upper(), get_interface_id(intf)))
+    f.write(",\n".join("    {}_SHM_{}".format(intf.name.upper(),
+                                             fn.name.upper())
+                       for fn in fns))
+    f.write("""
+}} {0}_shm_fn_id;
+
+/** The arguments and return value of a call, stored in its slot */
+typedef union {0}_shm_payload_un_ {{
+    /** Placeholder so the union is never empty */
+    char unused;
+""".format(intf.name))
+    for fn in fns:
+        if (len(fn.get_input_names()) == 0 and fn.return_type == "void"):
+            continue
+        f.write("    /** Arguments and return value of {} */\n".format(
+                    fn.name) + \
+                "    struct {\n")
+        for input in fn.inputs if not fn.is_void_input() else []:
+            f.write("        {};\n".format(get_member_decl(input)))
+        if (fn.return_type != "void"):
+            f.write("        {} ret;\n".format(fn.return_type))
+        f.write("    }} {};\n".format(fn.name))
+    f.write("""\
+}} {0}_shm_payload_un;
+
+/** A client stub calling an object in another process */
+typedef struct {0}_shm_client_st_ {{
+    /** The stub, must be first */
+    {0}_st {0};
+    /** The channel to the server */
+    c_intf_shm_handle shm;
+}} {0}_shm_client_st;
+
+""".format(intf.name))
+
+    for fn in fns:
+        real_name = "{}_shm_client_{}".format(intf.name, fn.name)
+        is_void = (fn.return_type == "void")
+        has_payload = (not is_void) or (len(fn.get_input_names()) > 0)
+        f.write("""\
+/**
+ * Call {1} on the object served by the other process.
+ *
+ * @param {0}_h The stub
+""".format(intf.name, fn.name))
+        for name in fn.get_input_names():
+            f.write(" * @param {} Input parameter\n".format(name))
+        if (not is_void):
+            f.write(" * @return The return value of the call\n")
+        f.write("""\
+ */
+static {1}
+{2} ({3})
+{{
+    {0}_shm_client_st *{0}_shm_client = ({0}_shm_client_st *) {0}_h;
+""".format(intf.name, fn.return_type, real_name,
+           fn.get_params_str("{}_handle".format(intf.name),
+                             "{}_h".format(intf.name),
+                             ",\n" + " " * (len(real_name) + 2))))
+        if (has_payload):
+            f.write("    {}_shm_payload_un *payload;\n".format(intf.name))
+        if (not is_void):
+            f.write("    {} ret;\n".format(fn.return_type))
+        f.write("    size_t pos;\n\n")
+        prefix = "payload = " if has_payload else ""
+        f.write("    {0}c_intf_shm_call_begin({1}_shm_client->shm,\n" \
+                "{2}{3}_SHM_{4}, &pos);\n".format(
+                    prefix, intf.name, " " * (len(prefix) + 26),
+                    intf.name.upper(), fn.name.upper()))
+        for name in fn.get_input_names():
+            f.write("    payload->{0}.{1} = {1};\n".format(fn.name, name))
+        wait_str = "c_intf_shm_call_wait({}_shm_client->shm, pos)".format(
+                       intf.name)
+        if (is_void):
+            f.write("    {};\n".format(wait_str))
+        else:
+            f.write("    payload = {};\n".format(wait_str) + \
+                    "    ret = payload->{}.ret;\n".format(fn.name))
+        f.write("    c_intf_shm_call_end({}_shm_client->shm, pos);\n".format(
+                    intf.name))
+        if (not is_void):
+            f.write("\n    return (ret);\n")
+        f.write("}\n\n")
+
+    f.write("""\
+/**
+ * Delete the stub.  The object served by the other process is not deleted.
+ *
+ * @param {0}_h The stub
+ */
+static void
+{0}_shm_client_delete ({0}_handle {0}_h)
+{{
+    {0}_shm_client_st *{0}_shm_client = ({0}_shm_client_st *) {0}_h;
+
+    if (NULL == {0}_shm_client) {{
+        return;
+    }}
+
+    {0}_friend_delete(&({0}_shm_client->{0}));
+    c_intf_shm_delete({0}_shm_client->shm);
+    free({0}_shm_client);
+}}
+
+/** The virtual function table of client stubs */
+static {0}_vtable_st {0}_shm_client_vtable = {{
+""".format(intf.name))
+    f.write(",\n".join(["    {}_shm_client_{}".format(intf.name, fn.name)
+                        for fn in intf.functions.viewvalues()] +
+                       get_batch_defaults(intf)))
+    f.write("""
+}};
+
+/**
+ * Create a client stub implementing the {0} interface whose calls are run
+ * on the object served through a channel by another process.  Calls on the
+ * stub may be made from any thread and wait for the server to run them.
+ *
+ * @param name The name of the channel given to {0}_shm_create()
+ * @return The stub or NULL if the channel could not be opened
+ */
+{0}_handle
+{0}_shm_client_new (const char *name)
+{{
+    {0}_shm_client_st *{0}_shm_client = NULL;
+
+    {0}_shm_client = calloc(1, sizeof(*{0}_shm_client));
+    if (NULL == {0}_shm_client) {{
+        return (NULL);
+    }}
+
+    {0}_shm_client->shm = c_intf_shm_open(name, {1}_SHM_ID,
+                                          sizeof({0}_shm_payload_un));
+    if (NULL == {0}_shm_client->shm) {{
+        free({0}_shm_client);
+        return (NULL);
+    }}
+
+    if (!{0}_init(&({0}_shm_client->{0}))) {{
+        c_intf_shm_delete({0}_shm_client->shm);
+        free({0}_shm_client);
+        return (NULL);
+    }}
+
+    if (!{0}_set_vtable(&({0}_shm_client->{0}), &{0}_shm_client_vtable)) {{
+        {0}_shm_client_delete(&({0}_shm_client->{0}));
+        return (NULL);
+    }}
+
+    return (&({0}_shm_client->{0}));
+}}
+
+/**
+ * Create a channel in shared memory through which other processes call an
+ * object of this process with {0}_shm_client_new().
+ *
+ * @param name The name of the shared memory, e.g. "/my_channel"
+ * @param capacity The number of calls which can be queued, rounded up to a
+ * power of two.  If 0, the capacity from the description file is used.
+ * @return The channel or NULL if creation failed.  It is deleted with
+ * c_intf_shm_delete() once the clients are done with it.
+ */
+c_intf_shm_handle
+{0}_shm_create (const char *name, size_t capacity)
+{{
+    if (0 == capacity) {{
+        capacity = {2};
+    }}
+
+    return (c_intf_shm_create(name, {1}_SHM_ID, capacity,
+                              sizeof({0}_shm_payload_un)));
+}}
+
+/**
+ * Run up to max_calls calls queued on a channel by clients on the target.
+ * Must only be called by one thread of the process which created the
+ * channel.
+ *
+ * @param shm The channel
+ * @param target_h The object the calls are run on
+ * @param max_calls The maximum number of calls to run
+ * @param timeout_ms The maximum time to wait for the first call, negative to
+ * wait forever
+ * @return The number of calls run
+ */
+size_t
+{0}_shm_serve (c_intf_shm_handle shm, {0}_handle target_h,
+{3}size_t max_calls, int timeout_ms)
+{{
+    {0}_shm_payload_un *payload;
+    uint32_t fn_id;
+    size_t count = 0;
+
+    if ((NULL == shm) || (NULL == target_h)) {{
+        return (0);
+    }}
+
+    while (count < max_calls) {{
+        /* Only wait for the first call, then run the ones already queued */
+        payload = c_intf_shm_serve_begin(shm, (0 == count) ? timeout_ms : 0,
+                                         &fn_id);
+        if (NULL == payload) {{
+            break;
+        }}
+
+        switch (fn_id) {{
+""".format(intf.name, intf.name.upper(), intf.shm_capacity,
+           " " * (len(intf.name) + 12)))
+    for fn in fns:
+        f.write("        case {}_SHM_{}:\n".format(intf.name.upper(),
+                                                 fn.name.upper()))
+        call_str = "{}_{}({})".format(intf.name, fn.name,
+                                      fn.get_args_str(
+                                          "target_h",
+                                          "payload->{}.".format(fn.name)))
+        if (fn.return_type == "void"):
+            f.write("            {};\n".format(call_str))
+        else:
+            f.write("            payload->{}.ret =\n".format(fn.name) + \
+                    "                {};\n".format(call_str))
+        f.write("            break;\n")
+    f.write("""\
+        }
+
+        c_intf_shm_serve_end(shm);
+        count++;
+    }
+
+    return (count);
+}
+""")
+
+def is_scalar_input (input):
+    """Indicates whether an input is passed by value and can be recorded"""
+    return (re.search(r'\*|\[|_handle\b', input) is None)
+
+def get_scalar_inputs (fn):
+    """Get the inputs of a function which can be recorded"""
+    if (fn.is_void_input()):
+        return []
+    return [input for input in fn.inputs if is_scalar_input(input)]
+
+def is_replayable (fn):
+    """Indicates whether all the inputs of a function can be recorded"""
+    return (len(get_scalar_inputs(fn)) == len(fn.get_input_names()))
+
+def write_record_ids (f, intf):
+    """Write the identifiers of the interface and its functions in recorded
+       calls"""
+    f.write("/** Identifies the {} interface in recorded calls */\n".format(
+                intf.name) + \
+            "#define {}_RECORD_ID 0x{:08x}U\n\n".format(
+                intf.name.upper(), get_fnv1a_hash(intf.name)))
+    f.write("/** Identify the functions of the interface in recorded " + \
+            "calls */\n")
+    for fn in intf.functions.viewvalues():
+        f.write("#define {}_RECORD_{} 0x{:08x}U\n".format(
+                    intf.name.upper(), fn.name.upper(),
+                    get_fnv1a_hash("{}.{}".format(intf.name, fn.name))))
+    f.write("\n")
+
+def generate_interface_flight_code (f, intf):
+    """Generate the function naming the class of objects in flight recorder
+       events"""
+
+    f.write("""\
+/**
+ * Set the class shown for an object in flight recorder events.  By default,
+ * none is shown.
+ *
+ * @param {0}_h The object
+ * @param class_name The name of the class, which must outlive the object
+ */
+void
+{0}_set_flight_class ({0}_handle {0}_h, const char *class_name)
+{{
+    if ((NULL == {0}_h) || (NULL == {0}_h->private_h)) {{
+        return;
+    }}
+
+    {0}_h->private_h->flight_class = class_name;
+}}
+
+""".format(intf.name))
+
+def generate_interface_record_code (f, intf):
+    """Generate the functions recording the calls made on the interface,
+       which are called by the interface functions"""
+
+    for fn in intf.functions.viewvalues():
+        inputs = get_scalar_inputs(fn)
+        names = [get_c_indentifier(input) for input in inputs]
+        real_name = "{}_record_{}".format(intf.name, fn.name)
+        if (len(inputs) > 0):
+            f.write("""\
+/** The recorded arguments of {1} */
+typedef struct {0}_{1}_record_args_st_ {{
+""".format(intf.name, fn.name))
+            for input in inputs:
+                f.write("    {};\n".format(get_member_decl(input)))
+            f.write("}} {0}_{1}_record_args_st;\n\n".format(intf.name,
+                                                          fn.name))
+        f.write("""\
+/**
+ * Record a call to {1}.
+ *
+ * @param {0}_h The object
+""".format(intf.name, fn.name))
+        for name in names:
+            f.write(" * @param {} Input parameter\n".format(name))
+        f.write("""\
+ */
+static void
+{1} ({2})
+{{
+""".format(intf.name, real_name,
+           ",\n{}".format(" " * (len(real_name) + 2)).join(
+               ["{0}_handle {0}_h".format(intf.name)] + inputs)))
+        if (len(inputs) > 0):
+            f.write("    {0}_{1}_record_args_st args;\n\n".format(intf.name,
+                                                                fn.name))
+        f.write("""\
+    if ({0}_h->private_h->record_skip) {{
+        return;
+    }}
+
+""".format(intf.name))
+        if (len(inputs) > 0):
+            f.write("    /* Cleared so the padding in the log is too */\n" + \
+                    "    memset(&args, 0, sizeof(args));\n")
+            for name in names:
+                f.write("    args.{0} = {0};\n".format(name))
+            f.write("\n")
+        f.write("""\
+    c_intf_record_append({0}_h->private_h->record_object_id,
+                         {0}_h->private_h->record_class_id,
+                         {1}_RECORD_ID, {1}_RECORD_{2},
+                         {3});
+}}
+
+""".format(intf.name, intf.name.upper(), fn.name.upper(),
+           "&args, sizeof(args)" if len(inputs) > 0 else "NULL, 0"))
+
+    f.write("""\
+/**
+ * Set the identifiers used for an object in recorded calls.  By default, the
+ * class is 0 and the object is identified by its {0} handle.
+ *
+ * @param {0}_h The object
+ * @param class_id The <CLASS>_RECORD_ID of the class of the object
+ * @param object_id Identifies the object, the same for all its interfaces
+ */
+void
+{0}_set_record_info ({0}_handle {0}_h, uint32_t class_id,
+    uint64_t object_id)
+{{
+    if ((NULL == {0}_h) || (NULL == {0}_h->private_h)) {{
+        return;
+    }}
+
+    {0}_h->private_h->record_class_id = class_id;
+    {0}_h->private_h->record_object_id = object_id;
+}}
+
+/**
+ * Make a recorded call again on an object.  Calls with pointer inputs cannot
+ * be replayed since only the scalar inputs are recorded.
+ *
+ * @param {0}_h The object
+ * @param fn_id The {1}_RECORD_<FN> of the function
+ * @param args The recorded arguments
+ * @param args_size The size of the recorded arguments
+ * @return TRUE if the call was made, FALSE otherwise
+ */
+bool
+{0}_replay_call ({0}_handle {0}_h, uint32_t fn_id, const void *args,
+    size_t args_size)
+{{
+""".format(intf.name, intf.name.upper()))
+    has_args = False
+    for fn in intf.functions.viewvalues():
+        if (is_replayable(fn) and len(fn.get_input_names()) > 0):
+            f.write("    {0}_{1}_record_args_st {1}_args;\n".format(intf.name,
+                                                                  fn.name))
+            has_args = True
+    if (has_args):
+        f.write("\n")
+    f.write("""\
+    if ((NULL == {0}_h) || ((NULL == args) && (0 != args_size))) {{
+        return (false);
+    }}
+
+    switch (fn_id) {{
+""".format(intf.name))
+    for fn in intf.functions.viewvalues():
+        f.write("    case {}_RECORD_{}:\n".format(intf.name.upper(),
+                                                fn.name.upper()))
+        if (not is_replayable(fn)):
+            f.write("        return (false);\n")
+            continue
+        if (len(fn.get_input_names()) > 0):
+            f.write("""\
+        if (sizeof({1}_args) != args_size) {{
+            return (false);
+        }}
+        memcpy(&{1}_args, args, sizeof({1}_args));
+""".format(intf.name, fn.name))
+        f.write("        {}_{}({});\n".format(
+                    intf.name, fn.name,
+                    fn.get_args_str("{}_h".format(intf.name),
+                                    "{}_args.".format(fn.name))) + \
+                "        return (true);\n")
+    f.write("""\
+    default:
+        return (false);
+    }
+}
+
+""")
+
+def get_parallel_functions (intf):
+    """Get the functions of the interface which get a parallel version.  The
+       arguments are shared by the threads through a structure, so functions
+       with array inputs are left out along with delete."""
+    return ([fn for fn in intf.functions.viewvalues()
+             if (fn.name != "delete") and
+             not any("[" in input for input in fn.inputs)])
+
+def get_parallel_params_str (intf, fn, sep):
+    """Get the parameters of the parallel version of a function"""
+    params = ["const {0}_handle *{0}_handles".format(intf.name),
+              "size_t num_handles", "c_intf_pool_handle pool"]
+    if (fn.return_type != "void"):
+        params.append("{} *results".format(fn.return_type))
+    if (not fn.is_void_input()):
+        params.extend(fn.inputs)
+    return (sep.join(params))
+
+def generate_interface_parallel_code (f, intf):
+    """Generate the versions of the interface functions calling them on many
+       objects with a thread pool"""
+
+    for fn in get_parallel_functions(intf):
+        real_name = "{}_{}_parallel".format(intf.name, fn.name)
+        is_void = (fn.return_type == "void")
+        f.write("""
+/** The arguments shared by the threads calling {2} */
+typedef struct {1}_st_ {{
+    /** The objects */
+    const {0}_handle *{0}_handles;
+""".format(intf.name, real_name, fn.name))
+        if (not is_void):
+            f.write("    /** Where the return values are stored */\n" + \
+                    "    {} *results;\n".format(fn.return_type))
+        for input in fn.inputs if not fn.is_void_input() else []:
+            f.write("    {};\n".format(get_member_decl(input)))
+        f.write("""\
+}} {1}_st;
+
+/**
+ * Call {2} on a range of the objects.
+ *
+ * @param ctx The arguments
+ * @param begin The first object
+ * @param end One past the last object
+ */
+static void
+{1}_range (void *ctx, size_t begin, size_t end)
+{{
+    {1}_st *args = ctx;
+    size_t i;
+
+    for (i = begin; i < end; i++) {{
+""".format(intf.name, real_name, fn.name))
+        call_str = "{}_{}({})".format(intf.name, fn.name,
+                                      fn.get_args_str(
+                                          "args->{}_handles[i]".format(
+                                              intf.name),
+                                          "args->"))
+        if (is_void):
+            f.write("        {};\n".format(call_str))
+        else:
+            f.write("        args->results[i] =\n" + \
+                    "            {};\n".format(call_str))
+        f.write("""\
+    }}
+}}
+
+/**
+ * Call {1} on many objects spread over the threads of a pool.  The
+ * calls may run concurrently, so the implementations must not share state
+ * without synchronization.
+ *
+ * @param {0}_handles The objects
+ * @param num_handles The number of objects
+ * @param pool The pool.  If NULL, the calls are made by the caller.
+""".format(intf.name, fn.name))
+        if (not is_void):
+            f.write(" * @param results Set to the return values, in the " + \
+                    "order of the objects\n")
+        for name in fn.get_input_names():
+            f.write(" * @param {} Input parameter\n".format(name))
+        f.write("""\
+ */
+void
+{1} ({2})
+{{
+    {1}_st args;
+
+    args.{0}_handles = {0}_handles;
+""".format(intf.name, real_name,
+           get_parallel_params_str(intf, fn,
+                                   ",\n" + " " * (len(real_name) + 2))))
+        if (not is_void):
+            f.write("    args.results = results;\n")
+        for name in fn.get_input_names():
+            f.write("    args.{0} = {0};\n".format(name))
+        f.write("""
+    c_intf_pool_run(pool, num_handles, {0}_range,
+                    &args);
+}}
+""".format(real_name))
+
+def generate_class_files (class_obj, parser_args, author=None, license=None):
+
+    header_file_name = "{}/{}{}.h".format(parser_args.output_dir,
+                                          class_obj.name,
+                                          parser_args.gen_file_suffix)
+    c_file_name = "{}/{}{}.c".format(parser_args.output_dir, class_obj.name,
+                                     parser_args.gen_file_suffix)
+
+    try:
+        f = open(header_file_name, "w")
+    except IOError:
+        print "ERROR: Could not open {} for writing".format(
+            header_file_name)
+        sys.exit(1)
+
+    # Write the public interface file
+    desc_str = "This includes the APIs for casting to interfaces the\n" + \
+        "{} class implements and its opaque handle.\n".format(class_obj.name) + \
+        "This file should be included in the\n" + \
+        "public header file for the {} class.".format(class_obj.name)
+    write_header(f, desc_str, author, license, parser_args.lean_headers)
+
+    f.write("""\
+#ifndef __{0}_H__
+#define __{0}_H__
+
+""".format(re.sub(".h$", "", os.path.basename(header_file_name)).upper()))
+
+    if (parser_args.lean_headers and
+        (parser_args.bulk or parser_args.hot_swap) and
+        not uses_runtime(parser_args)):
+        # Used by <class>_new_n() and <class>_swap_vtable()
+        f.write("#include <stdbool.h>\n" + \
+                "#include <stddef.h>\n\n")
+    if (uses_runtime(parser_args)):
+        f.write("#include \"{}.h\"\n".format(get_runtime_name(parser_args)))
+        if (parser_args.lean_headers):
+            f.write("\n")
+    if (parser_args.lean_headers):
+        # Users of the class only need the interface handles for the casts
+        for (intf, member) in class_obj.get_casts():
+            write_handle_typedef(f, intf.name)
+    else:
+        for intf in class_obj.interfaces:
+            f.write("#include \"{}{}.h\"\n".format(intf.name,
+                                                   parser_args.gen_file_suffix))
+        f.write("\n")
+
+    f.write("""\
+/** Opaque pointer to reference instances of this class */
+typedef struct {0}_st_ *{0}_handle;
+
+/* APIs below are documented in their implementation file */
+
+extern void
+{0}_delete({0}_handle {0}_h);
+
+""".format(class_obj.name))
+
+    if (parser_args.record):
+        f.write("""\
+/** Identifies the {0} class in recorded calls */
+#define {1}_RECORD_ID 0x{2:08x}U
+
+""".format(class_obj.name, class_obj.name.upper(),
+           get_fnv1a_hash(class_obj.name)))
+
+    if (parser_args.snapshot):
+        f.write("""\
+/** Identifies the {0} class in snapshots */
+#define {1}_SNAPSHOT_ID 0x{2:08x}U
+
+extern size_t
+{0}_snapshot({0}_handle {0}_h, c_intf_snap_writer_handle writer);
+
+""".format(class_obj.name, class_obj.name.upper(),
+           get_fnv1a_hash(class_obj.name)))
+
+    if (parser_args.alloc_hooks):
+        f.write("""\
+extern void
+{0}_set_allocator(const c_intf_allocator_st *allocator);
+
+""".format(class_obj.name))
+
+    if (parser_args.arena):
+        f.write("""\
+extern {0}_handle
+{0}_new_in(c_intf_arena_handle arena, void *context);
+
+""".format(class_obj.name))
+
+    if (parser_args.bulk):
+        f.write("""\
+extern bool
+{0}_new_n(size_t count, void *const *contexts, {0}_handle *{0}_handles);
+
+""".format(class_obj.name))
+
+    if (parser_args.hot_swap):
+        f.write("""\
+/** The vtables of the interfaces of the class, see {0}_swap_vtable() */
+typedef struct {0}_impl_st_ {0}_impl_st;
+
+extern const {0}_impl_st {0}_default_impl;
+
+extern bool
+{0}_swap_vtable(const {0}_impl_st *impl);
+
+""".format(class_obj.name))
+
+    if (parser_args.numa):
+        f.write("""\
+extern {0}_handle
+{0}_new_on(int placement, void *context);
+
+extern size_t
+{0}_numa_count(int node);
+
+""".format(class_obj.name))
+
+    for (intf, member) in class_obj.get_casts():
+        f.write("""\
+extern {1}_handle
+{0}_cast_to_{1}({0}_handle {0}_h);
+
+""".format(class_obj.name, intf.name))
+
+    f.write("#endif\n")
+    f.close()
+
+    try:
+        f = open(c_file_name, "w")
+    except IOError:
+        print "ERROR: Could not open {} for writing".format(
+            c_file_name)
+        sys.exit(1)
+
+    # Write the public interface file
+    desc_str = "This implements the interface related portion of the\n" + \
+        "{} class.\n".format(class_obj.name) + \
+        "This file should be included in the " + \
+        "{} implementation file\n".format(class_obj.name) + \
+        "Yes, including a C file is bizarre, " + \
+        "but that's how it works here."
+    write_header(f, desc_str, author, license)
+
+    f.write("""\
+
+/* 
+ * See below for forward declarations that must be defined manually in the
+ * implementing C file.
+ */
+
+""")
+
+
+    if (parser_args.lean_headers):
+        for include in ["<stdlib.h>", "<stdbool.h>", "<stdint.h>",
+                        "<stddef.h>"]:
+            f.write("#include {}\n".format(include))
+    if (class_obj.lazy_data):
+        f.write("#include <sched.h>\n")
+    if (parser_args.bulk and parser_args.alloc_hooks):
+        f.write("#include <string.h>\n")
+    f.write("#include \"{}\"\n".format(os.path.basename(header_file_name)))
+    for intf in class_obj.interfaces:
+        f.write("#include \"{}_friend{}.h\"\n".format(intf.name, 
+                    parser_args.gen_file_suffix))
+    f.write("\n")
+
+    f.write("""\
+/* Forward declarations */
+/* Begin structs that must be defined manually. */
+
+/** 
+ * Forward pointer to reference non-interface data for the class.
+ * This must be defined manually.
+ */
+typedef struct {0}_data_st_ *{0}_data_handle;
+
+/* End structs that must be defined manually. */
+
+""".format(class_obj.name))
+
+    f.write("""\
+/* Forward declarations */
+/* Begin functions that must be defined manually. */
+
+static void
+{0}_data_delete({0}_data_handle *{0}_data_h);
+
+static bool
+{0}_data_create({0}_data_handle *{0}_data_h, void *context);
+
+""".format(class_obj.name))
+
+    if (parser_args.mem_stats):
+        f.write("""\
+static size_t
+{0}_data_size({0}_data_handle {0}_data_h);
+
+""".format(class_obj.name))
+
+    if (parser_args.snapshot):
+        f.write("""\
+static bool
+{0}_data_snapshot({0}_data_handle {0}_data_h,
+    c_intf_snap_writer_handle writer, size_t *offset);
+
+static bool
+{0}_data_revive({0}_data_handle {0}_data_h, c_intf_snap_handle snap);
+
+""".format(class_obj.name))
+
+    for intf in class_obj.interfaces:
+        # Inherited methods take the handle of the interface declaring them
+        for (owner, fn, is_batch) in get_vtable_slots(intf):
+            if (is_batch):
+                if (not class_obj.implements_batch(intf, fn)): continue
+                f.write("static void\n" + \
+                        "{}_{}_{}_n({});\n\n".format(class_obj.name,
+                            owner.name, fn.name,
+                            get_batch_params_str(owner, fn, ",\n    ")))
+                continue
+            if (fn.name == "delete"): continue
+            f.write("""\
+static {0}
+{1}_{2}_{3}({2}_handle {2}_h""".format(fn.return_type, class_obj.name,
+    owner.name, fn.name))
+            if (not fn.is_void_input()):
+                for input in fn.inputs:
+                    f.write(",\n    {}".format(input))
+            f.write(");\n\n")
+            for feature in class_obj.get_versions(intf, fn):
+                f.write("__attribute__((target(\"{}\")))\n".format(feature) + \
+                        "static {}\n".format(fn.return_type) + \
+                        "{}_{}_{}_{}({});\n\n".format(class_obj.name,
+                            owner.name, fn.name, get_feature_suffix(feature),
+                            fn.get_params_str("{}_handle".format(owner.name),
+                                              "{}_h".format(owner.name),
+                                              ",\n    ")))
+
+    f.write("""\
+/* End functions that must be defined manually. */
+
+""")
+
+    if (class_obj.lazy_data):
+        f.write("""\
+/** States of the data of {0} objects, which is created on first use */
+enum {{
+    {1}_DATA_PENDING,
+    {1}_DATA_CREATING,
+    {1}_DATA_CREATED
+}};
+
+""".format(class_obj.name, class_obj.name.upper()))
+
+    if (parser_args.bulk):
+        f.write("""\
+/** The memory of {0} objects created together by {0}_new_n */
+typedef struct {0}_block_st_ {{
+    /** The number of objects of the block not deleted yet */
+    size_t live;
+""".format(class_obj.name))
+        if (parser_args.alloc_hooks):
+            f.write("""\
+    /** The allocator of the block */
+    const c_intf_allocator_st *allocator;
+""")
+        f.write("}} {0}_block_st;\n\n".format(class_obj.name))
+
+    f.write("/** Private data for this class */\n" + \
+            "typedef struct {}_st_ {{\n".format(class_obj.name))
+    for intf in class_obj.interfaces:
+        f.write("""\
+    /** {0} reference */
+    {0}_st {0};
+""".format(intf.name))
+    f.write("""\
+    /** Data for this class */
+    {0}_data_handle {0}_data_h;
+""".format(class_obj.name))
+    if (parser_args.alloc_hooks):
+        f.write("""\
+    /** Allocator of this object, NULL if allocated with calloc() */
+    const c_intf_allocator_st *allocator;
+""")
+    if (parser_args.arena):
+        f.write("""\
+    /** Arena of this object, NULL if not allocated from an arena */
+    c_intf_arena_handle arena;
+    /** Indicates whether the arena object was already deleted */
+    bool arena_deleted;
+""")
+    if (parser_args.bulk):
+        f.write("""\
+    /** The block of the object if created by {0}_new_n, else NULL */
+    {0}_block_st *block;
+""".format(class_obj.name))
+    if (parser_args.numa):
+        f.write("""\
+    /** Indicates whether the object was created by {0}_new_on */
+    bool numa_placed;
+    /** The NUMA node of the object, if placed */
+    int numa_node;
+""".format(class_obj.name))
+    if (parser_args.mem_stats):
+        f.write("""\
+    /** Indicates whether the object is counted in the memory usage */
+    bool mem_counted;
+    /** The bytes counted for the object */
+    size_t mem_bytes;
+    /** When the object was created */
+    uint64_t mem_created_ns;
+""")
+    if (class_obj.lazy_data):
+        f.write("""\
+    /** Whether the data was created, one of the {}_DATA_* states */
+    int data_state;
+    /** The context passed to {}_data_create, until the data is created */
+    void *data_context;
+""".format(class_obj.name.upper(), class_obj.name))
+    f.write("""\
+}} {0}_st;
+
+""".format(class_obj.name))
+
+    if (parser_args.numa):
+        f.write("""\
+/** The number of objects created by {0}_new_on on each node */
+static size_t {0}_numa_counts[C_INTF_NUMA_MAX_NODES];
+
+""".format(class_obj.name))
+
+    if (parser_args.mem_stats):
+        generate_class_mem_stats_code(f, class_obj)
+
+    if (parser_args.lock_stats and
+        any(intf.is_threadsafe() for intf in class_obj.interfaces)):
+        f.write("""\
+/** The lock contention of the {0} class */
+static c_intf_lock_class_st {0}_lock_class = {{ .name = "{0}" }};
+
+/**
+ * Register the lock contention of the {0} class before main() runs.
+ */
+__attribute__((constructor))
+static void
+{0}_lock_register (void)
+{{
+    c_intf_lock_register(&{0}_lock_class);
+}}
+
+""".format(class_obj.name))
+
+    if (parser_args.alloc_hooks):
+        f.write("""\
+/** The allocator for this class, if NULL the global allocator is used */
+static const c_intf_allocator_st *{0}_allocator = NULL;
+
+/**
+ * Set the allocator used for new {0} objects.  Existing objects keep the
+ * allocator they were created with.
+ *
+ * @param allocator The allocator.  If NULL, the global allocator is used.
+ * @see c_intf_set_allocator()
+ */
+void
+{0}_set_allocator (const c_intf_allocator_st *allocator)
+{{
+    __atomic_store_n(&{0}_allocator, allocator, __ATOMIC_RELEASE);
+}}
+
+/**
+ * Allocate a zeroed {0} object from the allocator of the class.  Objects
+ * must be allocated with this rather than calloc() for the allocator to be
+ * used for the object and its interfaces.
+ *
+ * @return The object or NULL on failure
+ */
+static inline {0}_st *
+{0}_alloc (void)
+{{
+    const c_intf_allocator_st *allocator;
+    {0}_st *{0} = NULL;
+
+    allocator = __atomic_load_n(&{0}_allocator, __ATOMIC_ACQUIRE);
+    if (NULL == allocator) {{
+        allocator = c_intf_get_allocator();
+    }}
+
+    {0} = c_intf_alloc(allocator, sizeof(*{0}));
+    if (NULL != {0}) {{
+        {0}->allocator = allocator;
+    }}
+
+    return ({0});
+}}
+
+""".format(class_obj.name))
+    else:
+        f.write("""\
+/**
+ * Allocate a zeroed {0} object.  Objects should be allocated with this
+ * rather than calloc(), so they come from the allocator of the class when
+ * the code is generated with --alloc-hooks.
+ *
+ * @return The object or NULL on failure
+ */
+static inline {0}_st *
+{0}_alloc (void)
+{{
+    return (calloc(1, sizeof({0}_st)));
+}}
+
+""".format(class_obj.name))
+
+    f.write("""\
+/*
+ * This is C, we need explicit casts to each of an object's parent classes.
+ */
+
+""")
+
+    for (intf, member) in class_obj.get_casts():
+        if (intf is not member):
+            f.write("""\
+/**
+ * Cast the {1} object, embedded as {2}, to {0}.
+ *
+ * @param {1}_h The {1} object
+ * @return The {0} object
+ */
+static {0}_handle
+{1}_cast_to_{0} ({1}_handle {1}_h)
+{{
+    {0}_handle {0}_h = NULL;
+
+    if (NULL != {1}_h) {{
+        {0}_h = ({0}_handle) ((uint8_t *) {1}_h -
+            offsetof({0}_st, {2}));
+    }}
+
+    return ({0}_h);
+}}
+
+/**
+ * Cast the {0} object to {1}, which {2} extends.
+ *
+ * @param {0}_h The {0} object
+ * @return The {1} object
+ */
+{1}_handle
+{0}_cast_to_{1} ({0}_handle {0}_h)
 {{
-    if (NULL == {0}_h) {{
-        return;
+    {1}_handle {1}_h = NULL;
+
+    if (NULL != {0}_h) {{
+        {1}_h = ({1}_handle) &({0}_h->{2});
     }}
 
-    if (NULL != {0}_h->private_h) {{
-        free({0}_h->private_h);
-        {0}_h->private_h = NULL;
+    return ({1}_h);
+}}
+
+""".format(class_obj.name, intf.name, member.name))
+            continue
+        f.write("""\
+/**
+ * Cast the {1} object to {0}.
+ *
+ * @param {1}_h The {1} object
+ * @return The {0} object
+ */
+static {0}_handle
+{1}_cast_to_{0} ({1}_handle {1}_h)
+{{
+    {0}_handle {0}_h = NULL;
+
+    if (NULL != {1}_h) {{
+        {0}_h = ({0}_handle) ((uint8_t *) {1}_h -
+            offsetof({0}_st, {1}));
     }}
 
-    if (free_{0}_h) {{
-        free({0}_h);
+    return ({0}_h);
+}}
+
+/**
+ * Cast the {0} object to {1}.
+ *
+ * @param {0}_h The {0} object
+ * @return The {1} object
+ */
+{1}_handle
+{0}_cast_to_{1} ({0}_handle {0}_h)
+{{
+    {1}_handle {1}_h = NULL;
+
+    if (NULL != {0}_h) {{
+        {1}_h = &({0}_h->{1});
     }}
+
+    return ({1}_h);
 }}
 
+ """.format(class_obj.name, intf.name))
+
+    f.write("""\
 /**
- * Allow a friend class to delete the {0} object.  It is assumed that
- * the friend class is managing the memory for the {0} object and, thus,
- * the object will not be freed.  However, members within the {0} object
- * may be freed.  This does not call the virtual function table version of
- * delete, but rather the delete specifically for type {0}.
+ * The function to delete a {0} object.  Upon return, the
+ * object is not longer valid and the pointer is set to NULL.
  *
- * @param {0}_h The object.  If NULL, then this function is a no-op.
- * @see {0}_delete()
+ * @param {0}_h A pointer to the object.  If NULL, then this function 
+ * is a no-op.
  */
 void
-{0}_friend_delete ({0}_handle {0}_h)
+{0}_delete ({0}_handle {0}_h)
 {{
-    {0}_delete_internal({0}_h, false);
+    if (NULL == {0}_h) {{
+        return;
+    }}
+
+""".format(class_obj.name))
+
+    if (parser_args.arena and class_obj.trivial_destroy):
+        f.write("""\
+    if (NULL != {0}_h->arena) {{
+        /* Nothing to clean up, the memory goes with the arena */
+        return;
+    }}
+
+""".format(class_obj.name))
+    elif (parser_args.arena):
+        f.write("""\
+    if (NULL != {0}_h->arena) {{
+        /* The memory stays valid until the arena is reset */
+        if ({0}_h->arena_deleted) {{
+            return;
+        }}
+        {0}_h->arena_deleted = true;
+    }}
+
+""".format(class_obj.name))
+
+    if (parser_args.mem_stats):
+        f.write("""\
+    if ({0}_h->mem_counted) {{
+        c_intf_mem_remove_object(&{0}_mem_class, {0}_h->mem_bytes,
+                                 {0}_h->mem_created_ns);
+    }}
+
+""".format(class_obj.name))
+
+    if (parser_args.numa):
+        f.write("""\
+    if ({0}_h->numa_placed) {{
+        __atomic_fetch_sub(&({0}_numa_counts[{0}_h->numa_node]), 1,
+                           __ATOMIC_RELAXED);
+    }}
+
+""".format(class_obj.name))
+
+    if (class_obj.lazy_data):
+        f.write("""\
+    if ({1}_DATA_CREATED ==
+        __atomic_load_n(&({0}_h->data_state), __ATOMIC_ACQUIRE)) {{
+        {0}_data_delete(&({0}_h->{0}_data_h));
+    }}
+
+""".format(class_obj.name, class_obj.name.upper()))
+    else:
+        f.write("""\
+    {0}_data_delete(&({0}_h->{0}_data_h));
+
+""".format(class_obj.name))
+
+    for intf in class_obj.interfaces:
+        f.write("    {1}_friend_delete(&({0}_h->{1}));\n\n".format(
+                    class_obj.name, intf.name))
+
+    if (parser_args.bulk):
+        f.write("""\
+    if (NULL != {0}_h->block) {{
+        /* The block is freed along with its last object */
+        if (1 == __atomic_fetch_sub(&({0}_h->block->live), 1,
+                                    __ATOMIC_ACQ_REL)) {{
+            {1};
+        }}
+        return;
+    }}
+
+""".format(class_obj.name,
+           "c_intf_free({0}_h->block->allocator, {0}_h->block)".format(
+               class_obj.name) if parser_args.alloc_hooks else
+           "free({}_h->block)".format(class_obj.name)))
+
+    if (parser_args.alloc_hooks):
+        f.write("""\
+    c_intf_free({0}_h->allocator, {0}_h);
 }}
 
-""".format(intf.name))
+""".format(class_obj.name))
+    else:
+        f.write("""\
+    free({0}_h);
+}}
 
-    for fn in intf.functions.viewvalues():
+""".format(class_obj.name))
+
+    # The delete slot is declared by the root of the interfaces extended
+    for intf in [intf.get_ancestors()[-1] for intf in class_obj.interfaces]:
         f.write("""\
 /**
- * {0} from {1}.
+ * Wrapper for to call common function.
  *
  * @param {1}_h The object
-""".format(fn.name, intf.name))
+ */
+static void
+{0}_{1}_delete ({1}_handle {1}_h)
+{{
+    if (NULL == {1}_h) {{
+        return;
+    }}
 
-        if (not fn.is_void_input):
-            for input in fn.inputs:
-                f.write(" * @param {} Input parameter\n".format(
-                    get_c_indentifier(intput)))
-        f.write(" * @return {}\n".format(fn.return_type) + \
-                " */\n")
+    {0}_delete({1}_cast_to_{0}({1}_h));
+}}
 
-        f.write("{}\n".format(fn.return_type))
-        real_name = "{}_{}".format(intf.name, fn.name)
-        f.write("{1} ({0}_handle {0}_h".format(intf.name, real_name))
-        if (not fn.is_void_input):
-            for input in fn.inputs:
-                f.write(",\n{}{} {}".format(" " * (len(real_name) + 2), 
-                                            input[0], input[1]))
-        f.write(")\n" + \
-                "{\n")
+""".format(class_obj.name, intf.name))
+
+    if (len(class_obj.versions) > 0):
+        generate_class_multiversion_code(f, class_obj)
+
+    if (class_obj.lazy_data):
+        generate_class_lazy_data_code(f, class_obj, parser_args)
+
+    for intf in class_obj.interfaces:
         f.write("""\
-    assert((NULL != {0}_h) &&
-           (NULL != {0}_h->private_h) &&
-           (NULL != {0}_h->private_h->vtable) &&
-           (NULL != {0}_h->private_h->vtable->{1}_fn));
+/**
+ * The virtual function table of the {1} interface of the {0}
+ * class.
+ */
+static {2}{1}_vtable_st {0}_{1}_vtable = {{
+""".format(class_obj.name, intf.name,
+           "const " if parser_args.static_init else ""))
+        fn_names = []
+        for (owner, fn, is_batch) in get_vtable_slots(intf):
+            if (not is_batch):
+                if (class_obj.lazy_data and fn.name != "delete"):
+                    fn_names.append("    {}_{}_{}_lazy".format(
+                        class_obj.name, owner.name, fn.name))
+                else:
+                    fn_names.append("    {}".format(
+                        class_obj.get_method_name(intf, fn)))
+            elif (class_obj.implements_batch(intf, fn)):
+                fn_names.append("    {}_{}_{}_n{}".format(
+                    class_obj.name, owner.name, fn.name,
+                    "_lazy" if class_obj.lazy_data else ""))
+            elif (parser_args.static_init):
+                # Nothing is inherited into const vtables
+                fn_names.append("    {}_{}_n_default".format(owner.name,
+                                                            fn.name))
+            else:
+                fn_names.append("    NULL")
+        f.write(",\n".join(fn_names) + "\n" + \
+                "};\n\n")
+
+    if (parser_args.hot_swap):
+        generate_class_hot_swap_code(f, class_obj, parser_args)
+
+    if (parser_args.static_init):
+        generate_class_static_init_code(f, class_obj, parser_args)
+
+    f.write("""\
+/**
+ * Initialize the {0} objects.
+ *
+ * @param {0}_h The object
+ * @param context An opaque context passed to {0}_data_create
+ * @return TRUE on success, FALSE otherwise
+ */
+static bool
+{0}_init ({0}_handle {0}_h, void *context)
+{{
+    bool rc = false;
+""".format(class_obj.name))
+
+    for intf in class_obj.interfaces:
+        f.write("""\
+    bool {}_initialized = false;
+""".format(intf.name))
+
+    if (not class_obj.lazy_data):
+        f.write("""\
+    bool {0}_data_created = false;
+""".format(class_obj.name))
+    f.write("""\
+
+    if (NULL == {0}_h) {{
+        return (false);
+    }}
+
+""".format(class_obj.name))
+
+    for intf in class_obj.interfaces:
+        f.write("""\
+    rc = {1}_init{2}(&({0}_h->{1}){3});
+    if (!rc) {{
+        goto err_exit;
+    }}
+    {1}_initialized = true;
+
+    rc = {1}_set_vtable(&({0}_h->{1}),
+             &{0}_{1}_vtable);
+    if (!rc) {{
+        goto err_exit;
+    }}
+
+""".format(class_obj.name, intf.name,
+           "_with_allocator" if parser_args.alloc_hooks else "",
+           ", {}_h->allocator".format(class_obj.name)
+               if parser_args.alloc_hooks else ""))
+        if (parser_args.hot_swap):
+            f.write("""\
+    {1}_set_shared_vtable(&({0}_h->{1}),
+        &{0}_{1}_shared_vtable);
+
+""".format(class_obj.name, intf.name))
+        if (parser_args.record):
+            f.write("""\
+    {1}_set_record_info(&({0}_h->{1}), {2}_RECORD_ID,
+        (uintptr_t) {0}_h);
+
+""".format(class_obj.name, intf.name, class_obj.name.upper()))
+        if (parser_args.flight_recorder):
+            f.write("""\
+    {1}_set_flight_class(&({0}_h->{1}), "{0}");
+
+""".format(class_obj.name, intf.name))
+        if (parser_args.lock_stats and intf.is_threadsafe()):
+            f.write("""\
+    {1}_set_lock_class(&({0}_h->{1}), &{0}_lock_class);
+
+""".format(class_obj.name, intf.name))
+
+    mem_str = ""
+    if (parser_args.mem_stats and parser_args.arena and
+        class_obj.trivial_destroy):
+        mem_str = """
+    if (NULL == {0}_h->arena) {{
+        /* Arena objects of the class are released without being deleted */
+        {0}_mem_add_object({0}_h);
+    }}
+""".format(class_obj.name)
+    elif (parser_args.mem_stats):
+        mem_str = "\n    {0}_mem_add_object({0}_h);\n".format(class_obj.name)
+
+    if (class_obj.lazy_data):
+        f.write("""\
+    /* The data is created by the first method called */
+    {0}_h->data_state = {1}_DATA_PENDING;
+    {0}_h->data_context = context;
+{2}
+    return (true);
+
+err_exit:
+
+""".format(class_obj.name, class_obj.name.upper(), mem_str))
+    else:
+        f.write("""\
+    rc = {0}_data_create(&({0}_h->{0}_data_h), context);
+    if (!rc) {{
+        goto err_exit;
+    }}
+    {0}_data_created = true;
+{1}
+    return (true);
+
+err_exit:
+
+    if ({0}_data_created) {{
+        {0}_data_delete(&({0}_h->{0}_data_h));
+    }}
+
+""".format(class_obj.name, mem_str))
+
+    for intf in class_obj.interfaces:
+        f.write("""\
+    if ({1}_initialized) {{
+        {1}_friend_delete(&({0}_h->{1}));
+    }}
+
+""".format(class_obj.name, intf.name))
+
+    f.write("""\
+    return (rc);
+}
+""")
+
+    if (parser_args.arena):
+        generate_class_arena_code(f, class_obj)
+
+    if (parser_args.numa):
+        generate_class_numa_code(f, class_obj)
+
+    if (parser_args.bulk):
+        generate_class_bulk_code(f, class_obj, parser_args)
 
-""".format(intf.name, fn.name))
-        # Get input parameters for function call
-        f.write("    return ({0}_h->private_h->vtable->{1}_fn({0}_h".format(
-                    intf.name, fn.name))
-        if (not fn.is_void_input):
-            for input in fn.inputs:
-                f.write(",\n{}".format(get_c_indentifier(input)))
-        f.write("));\n")
-        f.write("}\n\n")
+    if (parser_args.snapshot):
+        generate_class_snapshot_code(f, class_obj, parser_args)
+
+    f.close()
+
+def generate_class_hot_swap_code (f, class_obj, parser_args):
+    """Generate the vtables shared by the objects of the class and the
+       function swapping them"""
 
     f.write("""\
 /**
- * The virtual function table used for objects of type {0}.  As this is
- * an interface, all functions should be NULL.
+ * The vtables of the interfaces of a {0} object, see
+ * {0}_swap_vtable()
  */
-static const {0}_vtable_st {0}_vtable = {{
-""".format(intf.name))
-    f.write(",\n".join("    NULL" for fn in intf.functions.viewvalues()))
+struct {0}_impl_st_ {{
+""".format(class_obj.name))
+    f.write("\n".join("""\
+    /** The vtable of {1}, NULL to keep the current one */
+    const {1}_vtable_st *{1};""".format(class_obj.name, intf.name)
+                      for intf in class_obj.interfaces))
+    f.write("""
+}};
+
+/** The vtables the {0} class was generated with */
+const {0}_impl_st {0}_default_impl = {{
+""".format(class_obj.name))
+    f.write(",\n".join("    .{1} = &{0}_{1}_vtable".format(class_obj.name,
+                                                         intf.name)
+                       for intf in class_obj.interfaces))
     f.write("\n};\n\n")
 
+    for intf in class_obj.interfaces:
+        f.write("""\
+/** The vtable of {1} used by all the {0} objects */
+static const {1}_vtable_st *{0}_{1}_shared_vtable =
+    &{0}_{1}_vtable;
+
+""".format(class_obj.name, intf.name))
+
     f.write("""\
 /**
- * Fill in the child vtable with values inherited from the parent_vtable for all
- * functions left NULL in the child vtable.
+ * Swap the implementation of all the {0} objects, live or
+ * created later, without touching them: each interface has a vtable shared
+ * by all the objects, which they read on every call.  Each vtable is
+ * swapped atomically, so calls through different interfaces may briefly use
+ * the old and the new implementation.  Calls in progress may still use the
+ * old vtables, so vtables must never be freed.  {0}_default_impl
+ * swaps back the implementation the class was generated with.{1}
  *
- * @param parent_vtable The parent vtable from which to inherit.
- * @param child_vtable The child vtable to which functions may be inherited.
- * @param do_null_check Indicates whether an error should be thrown if a
- * function in the child vtable is NULL after inheritance.
- * @return TRUE on success, FALSE otherwise
+ * @param impl The new vtables, in which the functions left NULL are those
+ * of the class
+ * @return TRUE on success, FALSE if a vtable is incomplete or could not be
+ * copied to inherit the functions of the class, in which case nothing is
+ * swapped
  */
-static bool
-{0}_inherit_vtable (const {0}_vtable_st *parent_vtable,
-    {0}_vtable_st *child_vtable,
-    bool do_null_check)
+bool
+{0}_swap_vtable (const {0}_impl_st *impl)
 {{
-    if ((NULL == parent_vtable) || (NULL == child_vtable)) {{
+""".format(class_obj.name,
+           "  As the data\n" + \
+           " * of objects is created on first use, " + \
+           "functions taking the place of\n" + \
+           " * the generated ones must call " + \
+           "{}_create_data() first.".format(class_obj.name)
+               if class_obj.lazy_data else ""))
+    for intf in class_obj.interfaces:
+        f.write("    const {0}_vtable_st *{0}_new_vtable = NULL;\n".format(
+                    intf.name))
+    f.write("""\
+    bool rc = true;
+
+    if (NULL == impl) {
         return (false);
-    }}
+    }
 
-""".format(intf.name))
+""")
+    for intf in class_obj.interfaces:
+        f.write("""\
+    if (rc && (NULL != impl->{1})) {{
+        {1}_new_vtable = {1}_prepare_vtable(
+            &{0}_{1}_vtable, impl->{1});
+        rc = (NULL != {1}_new_vtable);
+    }}
+""".format(class_obj.name, intf.name))
+    f.write("""
+    if (!rc) {
+        return (false);
+    }
 
-    for fn in intf.functions.viewvalues():
+""")
+    for intf in class_obj.interfaces:
         f.write("""\
-    if (NULL == child_vtable->{0}_fn) {{
-        child_vtable->{0}_fn = parent_vtable->{0}_fn;
-        if (do_null_check && (NULL == child_vtable->{0}_fn)) {{
-            return (false);
-        }}
+    if (NULL != {1}_new_vtable) {{
+        __atomic_store_n(&{0}_{1}_shared_vtable,
+                         {1}_new_vtable, __ATOMIC_RELEASE);
     }}
+""".format(class_obj.name, intf.name))
+    f.write("""
+    return (true);
+}
 
-""".format(fn.name))
-    f.write("    return (true);\n" + \
-            "}\n\n")
+""")
+
+def generate_class_static_init_code (f, class_obj, parser_args):
+    """Generate the macro initializing objects of the class at compile
+       time"""
+
+    fields = []
+    for intf in class_obj.interfaces:
+        private_fields = [".vtable = &{}_{}_vtable".format(class_obj.name,
+                                                           intf.name)]
+        if (parser_args.record):
+            private_fields.append(".record_object_id = (uintptr_t) &(name)")
+            private_fields.append(".record_class_id = {}_RECORD_ID".format(
+                                      class_obj.name.upper()))
+        if (parser_args.flight_recorder):
+            private_fields.append(".flight_class = \"{}\"".format(
+                                      class_obj.name))
+        if (parser_args.lock_stats and intf.is_threadsafe()):
+            private_fields.append(".lock_class = &{}_lock_class".format(
+                                      class_obj.name))
+        if (parser_args.hot_swap):
+            private_fields.append(".shared_vtable = &{}_{}_shared_vtable".\
+                                  format(class_obj.name, intf.name))
+        fields.append(".{0} = {{ .private_h = &({0}_private_st) {{ \\\n".format(
+                          intf.name) + \
+                      "        " + \
+                      ", \\\n        ".join(private_fields) + " } }")
+    fields.append(".{0}_data_h = (data_h)".format(class_obj.name))
+    if (class_obj.lazy_data):
+        fields.append(".data_state = {}_DATA_CREATED".format(
+                          class_obj.name.upper()))
 
     f.write("""\
 /**
- * This is a function used by implementing classes to set the virtual table
- * according with their methods.
+ * Initialize a {0} object at compile time, with no allocation or call to
+ * {0}_init().  Only usable at file scope, e.g.:
  *
- * @param {0}_h The object
- * @param vtable The virtual table specification for the implementing class.  If
- * any function pointer is NULL, an error is returned.
- * @return TRUE on success, FALSE otherwise
+ *     static {0}_st my_{0} =
+ *         {1}_STATIC_INITIALIZER(my_{0}, &my_data);
+ *
+ * The object must not be deleted.
+ *
+ * @param name The name of the object
+ * @param data_h The data of the object
  */
-bool
-{0}_set_vtable ({0}_handle {0}_h, 
-    {0}_vtable_st *vtable)
-{{
-    bool rc;
-
-    if (((NULL == {0}_h) || (NULL == vtable) ||
-         (NULL == {0}_h->private_h))) {{
-        return (false);
-    }}
-    
-    rc = {0}_inherit_vtable(&{0}_vtable, vtable, true);
+#define {1}_STATIC_INITIALIZER(name, data_h) {{ \\
+    {2} }}
 
-    if (rc) {{
-        {0}_h->private_h->vtable = vtable;
-    }}
+""".format(class_obj.name, class_obj.name.upper(),
+           ", \\\n    ".join(fields)))
 
-    return (rc);
-}}
+def generate_class_multiversion_code (f, class_obj):
+    """Generate the GNU ifuncs picking the best version of each method with
+       versions for the CPU once, when the program is loaded"""
 
+    for intf in class_obj.interfaces:
+        for fn in intf.functions.viewvalues():
+            features = class_obj.get_versions(intf, fn)
+            if (len(features) == 0): continue
+            owner = intf.get_owner(fn)
+            base_name = "{}_{}_{}".format(class_obj.name, owner.name, fn.name)
+            f.write("""\
 /**
- * Allows a friend class to initialize their inner {0} object.  Must be
- * called before the {0} object is used.  If an error is returned, any
- * clean-up was handled internally and there is no need to call a delete
- * function.
+ * Get the best version of {0}() for the CPU.
+ * Run by the dynamic loader, before constructors, so the CPU features must
+ * be read first and the sanitizer runtime is not ready to check memory
+ * accesses.
  *
- * @param {0}_h The object
- * @return TRUE on success, FALSE otherwise
- * @see {0}_delete()
- * @see {0}_friend_delete()
+ * @return The version
  */
-bool
-{0}_init ({0}_handle {0}_h)
+__attribute__((no_sanitize_address, no_sanitize_thread))
+static {1}_{2}_fn
+{0}_resolve (void)
 {{
-    if (NULL == {0}_h) {{
-        return (false);
-    }}
+    __builtin_cpu_init();
 
-    {0}_h->private_h = calloc(1, sizeof(*{0}_h->private_h));
-    if (NULL == {0}_h->private_h) {{
-        goto err_exit;
+""".format(base_name, owner.name, fn.name))
+            for feature in features:
+                f.write("""\
+    if (__builtin_cpu_supports("{1}")) {{
+        return ({0}_{2});
     }}
+""".format(base_name, feature, get_feature_suffix(feature)))
+            f.write("""
+    return ({0});
+}}
 
-    {0}_h->private_h->vtable = NULL;
+/** {0}() in its best version for the CPU */
+static {1}
+{0}_best({2})
+    __attribute__((ifunc("{0}_resolve")));
 
-    return (true);
+""".format(base_name, fn.return_type,
+           fn.get_params_str("{}_handle".format(owner.name),
+                             "{}_h".format(owner.name),
+                             ",\n" + " " * (len(base_name) + 6))))
 
-err_exit:
+def generate_class_mem_stats_code (f, class_obj):
+    """Generate the functions counting the objects of the class in its memory
+       usage"""
 
-    if (NULL != {0}_h->private_h) {{
-        free({0}_h->private_h);
-        {0}_h->private_h = NULL;
-    }}
+    f.write("""\
+/** The memory usage of the {0} class */
+static c_intf_mem_class_st {0}_mem_class = {{ .name = "{0}" }};
 
-    return (false);
+/**
+ * Register the memory usage of the {0} class before main() runs.
+ */
+__attribute__((constructor))
+static void
+{0}_mem_register (void)
+{{
+    c_intf_mem_register(&{0}_mem_class);
 }}
-""".format(intf.name))
-
-    f.close()
 
-def generate_class_files (class_obj, parser_args, author=None, license=None):
+/**
+ * Count a new {0} object in the memory usage of the class.
+ *
+ * @param {0}_h The object
+ */
+static void
+{0}_mem_add_object ({0}_handle {0}_h)
+{{
+    {0}_h->mem_bytes = sizeof(*{0}_h){1};
+    {0}_h->mem_created_ns = c_intf_mem_now();
+    {0}_h->mem_counted = true;
+    c_intf_mem_add_object(&{0}_mem_class, {0}_h->mem_bytes);
+}}
 
-    header_file_name = "{}/{}{}.h".format(parser_args.output_dir,
-                                          class_obj.name,
-                                          parser_args.gen_file_suffix)
-    c_file_name = "{}/{}{}.c".format(parser_args.output_dir, class_obj.name,
-                                     parser_args.gen_file_suffix)
+""".format(class_obj.name,
+           "".join(" +\n        {}_get_private_size()".format(intf.name)
+                   for intf in class_obj.interfaces) +
+           ("" if class_obj.lazy_data else
+            " +\n        {0}_data_size({0}_h->{0}_data_h)".format(
+                class_obj.name))))
 
-    try:
-        f = open(header_file_name, "w")
-    except IOError:
-        print "ERROR: Could not open {} for writing".format(
-            header_file_name)
-        sys.exit(1)
+    if (class_obj.lazy_data):
+        f.write("""\
+/**
+ * Count the data of a {0} object, created on first use, in the memory usage
+ * of the class.
+ *
+ * @param {0}_h The object
+ */
+static void
+{0}_mem_add_data ({0}_handle {0}_h)
+{{
+    size_t bytes;
 
-    # Write the public interface file
-    desc_str = "This includes the APIs for casting to interfaces the\n" + \
-        "{} class implements and its opaque handle.\n".format(class_obj.name) + \
-        "This file should be included in the\n" + \
-        "public header file for the {} class.".format(class_obj.name)
-    write_header(f, desc_str, author, license)
+    if (!{0}_h->mem_counted) {{
+        return;
+    }}
 
-    f.write("""\
-#ifndef __{0}_H__
-#define __{0}_H__
+    bytes = {0}_data_size({0}_h->{0}_data_h);
+    {0}_h->mem_bytes += bytes;
+    c_intf_mem_add_bytes(&{0}_mem_class, bytes);
+}}
 
-""".format(re.sub(".h$", "", os.path.basename(header_file_name)).upper()))
+""".format(class_obj.name))
 
-    for intf in class_obj.interfaces:
-        f.write("#include \"{}{}.h\"\n".format(intf.name,
-                                               parser_args.gen_file_suffix))
-    f.write("\n")
+def generate_class_lazy_data_code (f, class_obj, parser_args):
+    """Generate the functions creating the data of the class on the first
+       call of one of its methods"""
 
     f.write("""\
-/** Opaque pointer to reference instances of this class */
-typedef struct {0}_st_ *{0}_handle;
-
-/* APIs below are documented in their implementation file */
+/**
+ * Create the data of a {0} object if it was not already.  The first thread
+ * to get here creates it while the others wait.  If creation fails, the
+ * data handle is left NULL and the next call tries again.
+ *
+ * @param {0}_h The object
+ */
+static void
+{0}_create_data ({0}_handle {0}_h)
+{{
+    int state = {1}_DATA_PENDING;
+
+    if (__atomic_compare_exchange_n(&({0}_h->data_state), &state,
+            {1}_DATA_CREATING, false, __ATOMIC_ACQUIRE,
+            __ATOMIC_ACQUIRE)) {{
+        if ({0}_data_create(&({0}_h->{0}_data_h),
+                {0}_h->data_context)) {{
+            state = {1}_DATA_CREATED;{2}
+        }} else {{
+            {0}_h->{0}_data_h = NULL;
+            state = {1}_DATA_PENDING;
+        }}
+        __atomic_store_n(&({0}_h->data_state), state,
+                         __ATOMIC_RELEASE);
+        return;
+    }}
 
-extern void
-{0}_delete({0}_handle {0}_h);
+    while ({1}_DATA_CREATING == state) {{
+        sched_yield();
+        state = __atomic_load_n(&({0}_h->data_state),
+                                __ATOMIC_ACQUIRE);
+    }}
+}}
 
-""".format(class_obj.name))
+""".format(class_obj.name, class_obj.name.upper(),
+           "\n            {}_mem_add_data({}_h);".format(class_obj.name,
+                                                       class_obj.name)
+               if parser_args.mem_stats else ""))
 
     for intf in class_obj.interfaces:
-        f.write("""\
-extern {1}_handle
-{0}_cast_to_{1}({0}_handle {0}_h);
+        for (owner, fn, is_batch) in get_vtable_slots(intf):
+            if (is_batch):
+                if (class_obj.implements_batch(intf, fn)):
+                    generate_class_lazy_batch_code(f, class_obj, owner, fn)
+                continue
+            if (fn.name == "delete"): continue
+            real_name = "{}_{}_{}_lazy".format(class_obj.name, owner.name,
+                                               fn.name)
+            call_str = "{}({})".format(
+                class_obj.get_method_name(intf, fn),
+                fn.get_args_str("{}_h".format(owner.name)))
+            f.write("""\
+/**
+ * Create the data of the object on first use, then call
+ * {0}_{1}_{2}().
+ *
+ * @param {1}_h The object
+""".format(class_obj.name, owner.name, fn.name))
+            for name in fn.get_input_names():
+                f.write(" * @param {} Input parameter\n".format(name))
+            if (fn.return_type != "void"):
+                f.write(" * @return The return value of the method\n")
+            f.write("""\
+ */
+static {0}
+{1} ({2})
+{{
+    {3}_handle {3}_h = {4}_cast_to_{3}({4}_h);
 
-""".format(class_obj.name, intf.name))
+    if ({5}_DATA_CREATED !=
+        __atomic_load_n(&({3}_h->data_state), __ATOMIC_ACQUIRE)) {{
+        {3}_create_data({3}_h);
+    }}
 
-    f.write("#endif\n")
-    f.close()
+    {6};
+}}
 
-    try:
-        f = open(c_file_name, "w")
-    except IOError:
-        print "ERROR: Could not open {} for writing".format(
-            c_file_name)
-        sys.exit(1)
+""".format(fn.return_type, real_name,
+           fn.get_params_str("{}_handle".format(owner.name),
+                             "{}_h".format(owner.name),
+                             ",\n" + " " * (len(real_name) + 2)),
+           class_obj.name, owner.name, class_obj.name.upper(),
+           call_str if fn.return_type == "void"
+               else "return ({})".format(call_str)))
 
-    # Write the public interface file
-    desc_str = "This implements the interface related portion of the\n" + \
-        "{} class.\n".format(class_obj.name) + \
-        "This file should be included in the " + \
-        "{} implementation file\n".format(class_obj.name) + \
-        "Yes, including a C file is bizarre, " + \
-        "but that's how it works here."
-    write_header(f, desc_str, author, license)
+def generate_class_lazy_batch_code (f, class_obj, intf, fn):
+    """Generate the function creating the data of the objects not used yet
+       before calling the batch version of a method"""
 
+    real_name = "{}_{}_{}_n_lazy".format(class_obj.name, intf.name, fn.name)
+    f.write("""\
+/**
+ * Create the data of the objects not used yet, then call
+ * {0}_{1}_{2}_n().
+ *
+ * @param {1}_handles The objects
+ * @param num_handles The number of objects
+""".format(class_obj.name, intf.name, fn.name))
+    if (fn.return_type != "void"):
+        f.write(" * @param results Where the return value of " + \
+                "each object is stored\n")
+    for name in fn.get_input_names():
+        f.write(" * @param {} Input parameter\n".format(name))
     f.write("""\
-
-/* 
- * See below for forward declarations that must be defined manually in the
- * implementing C file.
  */
+static void
+{1} ({2})
+{{
+    {0}_handle {0}_h;
+    size_t i;
+
+    for (i = 0; i < num_handles; i++) {{
+        {0}_h = {3}_cast_to_{0}({3}_handles[i]);
+        if ({4}_DATA_CREATED !=
+            __atomic_load_n(&({0}_h->data_state), __ATOMIC_ACQUIRE)) {{
+            {0}_create_data({0}_h);
+        }}
+    }}
 
-""")
-
+    {0}_{3}_{5}_n({6});
+}}
 
-    f.write("#include \"{}\"\n".format(os.path.basename(header_file_name)))
-    for intf in class_obj.interfaces:
-        f.write("#include \"{}_friend{}.h\"\n".format(intf.name, 
-                    parser_args.gen_file_suffix))
-    f.write("\n")
+""".format(class_obj.name, real_name,
+           get_batch_params_str(intf, fn,
+                                ",\n" + " " * (len(real_name) + 2)),
+           intf.name, class_obj.name.upper(), fn.name,
+           get_batch_args_str(intf, fn)))
+        
+def generate_class_snapshot_code (f, class_obj, parser_args):
+    """Generate the functions writing objects of the class to snapshots and
+       reviving them"""
 
     f.write("""\
-/* Forward declarations */
-/* Begin structs that must be defined manually. */
 
-/** 
- * Forward pointer to reference non-interface data for the class.
- * This must be defined manually.
+/**
+ * Write a {0} object to a snapshot, along with its data written by
+ * {0}_data_snapshot().  Objects referenced more than once are only written
+ * once.
+ *
+ * @param {0}_h The object
+ * @param writer The snapshot
+ * @return The offset of the object, to be stored in place of pointers to it
+ * or given to c_intf_snap_write() for the root object, or 0 on failure
  */
-typedef struct {0}_data_st_ *{0}_data_handle;
+size_t
+{0}_snapshot ({0}_handle {0}_h, c_intf_snap_writer_handle writer)
+{{
+    {0}_st *image;
+    size_t offset;
+""".format(class_obj.name))
+    for intf in class_obj.interfaces:
+        f.write("    size_t {}_offset;\n".format(intf.name))
+    f.write("""\
+    size_t data_offset = 0;
 
-/* End structs that must be defined manually. */
+    if ((NULL == {0}_h) || (NULL == writer)) {{
+        return (0);
+    }}
 
-""".format(class_obj.name))
+    offset = c_intf_snap_lookup(writer, {0}_h);
+    if (0 != offset) {{
+        return (offset);
+    }}
+
+    /* Added first so the data can reference the object */
+    offset = c_intf_snap_alloc(writer, sizeof(*image));
+    if ((0 == offset) ||
+        !c_intf_snap_add_object(writer, {0}_h, {1}_SNAPSHOT_ID,
+                                sizeof(*image), offset)) {{
+        return (0);
+    }}
+
+""".format(class_obj.name, class_obj.name.upper()))
+    for intf in class_obj.interfaces:
+        f.write("""\
+    {1}_offset = {1}_snapshot_private(&({0}_h->{1}), writer);
+    if (0 == {1}_offset) {{
+        return (0);
+    }}
 
+""".format(class_obj.name, intf.name))
+    if (class_obj.lazy_data):
+        data_check_str = "({}_DATA_CREATED ==\n".format(
+                             class_obj.name.upper()) + \
+                         "         __atomic_load_n(&({}_h->data_state), " \
+                         "__ATOMIC_ACQUIRE)) &&\n        ".format(
+                             class_obj.name)
+    else:
+        data_check_str = ""
     f.write("""\
-/* Forward declarations */
-/* Begin functions that must be defined manually. */
+    if ({2}(NULL != {0}_h->{0}_data_h) &&
+        !{0}_data_snapshot({0}_h->{0}_data_h, writer, &data_offset)) {{
+        return (0);
+    }}
 
-static void
-{0}_data_delete({0}_data_handle *{0}_data_h);
+    /* Filled in last since allocations may move the block.  Pointers are
+     * stored as offsets, which are never 0 for a block. */
+    image = c_intf_snap_at(writer, offset);
+""".format(class_obj.name, class_obj.name.upper(), data_check_str))
+    for intf in class_obj.interfaces:
+        f.write("    image->{0}.private_h =\n".format(intf.name) + \
+                "        ({0}_private_handle) (uintptr_t) {0}_offset;\n".format(
+                    intf.name))
+    f.write("    image->{0}_data_h = ({0}_data_handle) (uintptr_t) data_offset;\n".format(
+                class_obj.name))
+    if (class_obj.lazy_data):
+        f.write("""\
+    image->data_state = (0 != data_offset) ? {0}_DATA_CREATED :
+                                             {0}_DATA_PENDING;
+""".format(class_obj.name.upper()))
+    f.write("""
+    return (offset);
+}}
 
+/**
+ * Revive a {0} object mapped from a snapshot, turning its offsets back into
+ * pointers and fixing its data with {0}_data_revive().
+ *
+ * @param snap The snapshot
+ * @param obj The object
+ * @return TRUE on success, FALSE if the object is not valid
+ */
 static bool
-{0}_data_create({0}_data_handle *{0}_data_h, void *context);
+{0}_snapshot_fixup (c_intf_snap_handle snap, void *obj)
+{{
+    {0}_st *{0} = obj;
+    size_t data_offset = (size_t) (uintptr_t) {0}->{0}_data_h;
 
 """.format(class_obj.name))
-
     for intf in class_obj.interfaces:
-        for fn in intf.functions.viewvalues():
-            if (fn.name == "delete"): continue
+        f.write("""\
+    if (!{1}_revive_private(&({0}->{1}), snap) ||
+        !{1}_set_vtable(&({0}->{1}), &{0}_{1}_vtable)) {{
+        return (false);
+    }}
+""".format(class_obj.name, intf.name))
+        if (parser_args.record):
             f.write("""\
-static {0}
-{1}_{2}_{3}({2}_handle {2}_h""".format(fn.return_type, class_obj.name,
-    intf.name, fn.name))
-            if (not fn.is_void_input):
-                for input in fn.inputs:
-                    f.write(",\n    {}".format(input))
-            f.write(");\n\n")
-
+    {1}_set_record_info(&({0}->{1}), {2}_RECORD_ID, (uintptr_t) {0});
+""".format(class_obj.name, intf.name, class_obj.name.upper()))
+        if (parser_args.flight_recorder):
+            f.write("""\
+    {1}_set_flight_class(&({0}->{1}), "{0}");
+""".format(class_obj.name, intf.name))
+        if (parser_args.lock_stats and intf.is_threadsafe()):
+            f.write("""\
+    {1}_set_lock_class(&({0}->{1}), &{0}_lock_class);
+""".format(class_obj.name, intf.name))
+        if (parser_args.hot_swap):
+            f.write("""\
+    {1}_set_shared_vtable(&({0}->{1}),
+        &{0}_{1}_shared_vtable);
+""".format(class_obj.name, intf.name))
+        f.write("\n")
     f.write("""\
-/* End functions that must be defined manually. */
-
-""")
+    /* The size of the data is only known to {0}_data_revive() */
+    {0}->{0}_data_h = c_intf_snap_get_ptr(snap, data_offset, 0);
+    if ((0 != data_offset) &&
+        ((NULL == {0}->{0}_data_h) ||
+         !{0}_data_revive({0}->{0}_data_h, snap))) {{
+        return (false);
+    }}
 
-    f.write("/** Private data for this class */\n" + \
-            "typedef struct {}_st_ {{\n".format(class_obj.name))
-    for intf in class_obj.interfaces:
-        f.write("""\
-    /** {0} reference */
-    {0}_st {0};
-""".format(intf.name))
-    f.write("""\
-    /** Data for this class */
-    {0}_data_handle {0}_data_h;
-}} {0}_st;
+    return (true);
+}}
 
-""".format(class_obj.name))
+/** Revives the {0} objects of snapshots */
+static c_intf_snap_class_st {0}_snapshot_class = {{
+    {1}_SNAPSHOT_ID,
+    sizeof({0}_st),
+    {0}_snapshot_fixup,
+    NULL
+}};
 
-    f.write("""\
-/*
- * This is C, we need explicit casts to each of an object's parent classes.
+/**
+ * Register the class before main() runs, so its objects can be revived.
  */
+static void __attribute__((constructor))
+{0}_snapshot_register (void)
+{{
+    c_intf_snap_register(&{0}_snapshot_class);
+}}
+""".format(class_obj.name, class_obj.name.upper()))
 
-""")
+def generate_class_arena_code (f, class_obj):
+    """Generate the functions to create objects of the class in an arena"""
 
-    for intf in class_obj.interfaces:
+    if (not class_obj.trivial_destroy):
         f.write("""\
+
 /**
- * Cast the {1} object to {0}.
+ * Delete a {0} object when its arena is reset or deleted.
  *
- * @param {1}_h The {1} object
- * @return The {0} object
+ * @param obj The object
  */
-static {0}_handle
-{1}_cast_to_{0} ({1}_handle {1}_h)
+static void
+{0}_arena_finalize (void *obj)
 {{
-    {0}_handle {0}_h = NULL;
-
-    if (NULL != {1}_h) {{
-        {0}_h = ({0}_handle) ((uint8_t *) {1}_h -
-            offsetof({0}_st, {1}));
-    }}
-
-    return ({0}_h);
+    {0}_delete(obj);
 }}
+""".format(class_obj.name))
+
+    f.write("""\
 
 /**
- * Cast the {0} object to {1}.
+ * Create a new {0} object in an arena.  The object is released when the
+ * arena is reset or deleted, so it does not need to be deleted.
  *
- * @param {0}_h The {0} object
- * @return The {1} object
+ * @param arena The arena
+ * @param context An opaque context passed to {0}_data_create
+ * @return The object or NULL if creation failed
  */
-{1}_handle
-{0}_cast_to_{1} ({0}_handle {0}_h)
+{0}_handle
+{0}_new_in (c_intf_arena_handle arena, void *context)
 {{
-    {1}_handle {1}_h = NULL;
+    const c_intf_allocator_st *allocator;
+    {0}_st *{0} = NULL;
 
-    if (NULL != {0}_h) {{
-        {1}_h = &({0}_h->{1});
+    allocator = c_intf_arena_get_allocator(arena);
+    if (NULL == allocator) {{
+        return (NULL);
     }}
 
-    return ({1}_h);
+    {0} = c_intf_alloc(allocator, sizeof(*{0}));
+    if (NULL == {0}) {{
+        return (NULL);
+    }}
+    {0}->allocator = allocator;
+    {0}->arena = arena;
+
+    if (!{0}_init({0}, context)) {{
+        /* Any clean-up was done by the init and the memory is the arena's */
+        return (NULL);
+    }}
+""".format(class_obj.name))
+
+    if (not class_obj.trivial_destroy):
+        f.write("""\
+
+    if (!c_intf_arena_add_finalizer(arena, {0}_arena_finalize, {0})) {{
+        {0}_delete({0});
+        return (NULL);
+    }}
+""".format(class_obj.name))
+
+    f.write("""\
+
+    return ({0});
 }}
+""".format(class_obj.name))
 
- """.format(class_obj.name, intf.name))
+def generate_class_numa_code (f, class_obj):
+    """Generate the functions to create objects of the class on NUMA nodes"""
 
     f.write("""\
+
 /**
- * The function to delete a {0} object.  Upon return, the
- * object is not longer valid and the pointer is set to NULL.
+ * Create a new {0} object in the memory of a NUMA node.  Its interfaces
+ * and, if {0}_data_create allocates from the allocator of the object, its
+ * data are on the same node.
  *
- * @param {0}_h A pointer to the object.  If NULL, then this function 
- * is a no-op.
+ * @param placement The node, C_INTF_NUMA_CURRENT for the node of the calling
+ * thread or C_INTF_NUMA_INTERLEAVE to spread the objects over all the nodes
+ * @param context An opaque context passed to {0}_data_create
+ * @return The object or NULL if creation failed
  */
-void
-{0}_delete ({0}_handle {0}_h)
+{0}_handle
+{0}_new_on (int placement, void *context)
 {{
-    if (NULL == {0}_h) {{
-        return;
+    const c_intf_allocator_st *allocator;
+    {0}_st *{0} = NULL;
+    int node;
+
+    node = c_intf_numa_resolve(placement);
+    allocator = c_intf_numa_get_allocator(node);
+    if (NULL == allocator) {{
+        return (NULL);
     }}
 
-    {0}_data_delete(&({0}_h->{0}_data_h));
+    {0} = c_intf_alloc(allocator, sizeof(*{0}));
+    if (NULL == {0}) {{
+        return (NULL);
+    }}
+    {0}->allocator = allocator;
 
-""".format(class_obj.name))
+    if (!{0}_init({0}, context)) {{
+        c_intf_free(allocator, {0});
+        return (NULL);
+    }}
 
-    for intf in class_obj.interfaces:
-        f.write("    {1}_friend_delete(&({0}_h->{1}));\n\n".format(
-                    class_obj.name, intf.name))
+    {0}->numa_placed = true;
+    {0}->numa_node = node;
+    __atomic_fetch_add(&({0}_numa_counts[node]), 1, __ATOMIC_RELAXED);
 
-    f.write("""\
-    free({0}_h);
+    return ({0});
 }}
 
-""".format(class_obj.name))
-
-    for intf in class_obj.interfaces:
-        f.write("""\
 /**
- * Wrapper for to call common function.
+ * Get the number of {0} objects created by {0}_new_on on a NUMA node and not
+ * deleted yet.
  *
- * @param {1}_h The object
+ * @param node The node
+ * @return The number of objects, 0 if there is no such node
  */
-static void
-{0}_{1}_delete ({1}_handle {1}_h)
+size_t
+{0}_numa_count (int node)
 {{
-    if (NULL == {1}_h) {{
-        return;
+    if ((node < 0) || (node >= C_INTF_NUMA_MAX_NODES)) {{
+        return (0);
     }}
 
-    {0}_delete({1}_cast_to_{0}({1}_h));
+    return (__atomic_load_n(&({0}_numa_counts[node]), __ATOMIC_RELAXED));
 }}
+""".format(class_obj.name))
 
-""".format(class_obj.name, intf.name))
+def generate_class_bulk_code (f, class_obj, parser_args):
+    """Generate the function creating many objects of the class with a single
+       allocation"""
+
+    if (parser_args.alloc_hooks):
+        alloc_str = """\
+    allocator = __atomic_load_n(&{0}_allocator, __ATOMIC_ACQUIRE);
+    if (NULL == allocator) {{
+        allocator = c_intf_get_allocator();
+    }}
+
+    block = c_intf_alloc(allocator, size);
+    if (NULL == block) {{
+        return (false);
+    }}
+    memset(block, 0, size);
+    block->allocator = allocator;
+"""
+        free_str = "c_intf_free(allocator, block)"
+    else:
+        alloc_str = """\
+    block = calloc(1, size);
+    if (NULL == block) {{
+        return (false);
+    }}
+"""
+        free_str = "free(block)"
+
+    f.write("""\
 
-    for intf in class_obj.interfaces:
-        f.write("""\
 /**
- * The virtual function table for {0} interface.
+ * Round up the size of a part of a block so the next part is aligned for any
+ * type.
+ *
+ * @param size The size
+ * @return The aligned size
  */
-static {0}_vtable_st {0}_vtable = {{
-""".format(intf.name))
-        fn_names = []
-        for fn in intf.functions.viewvalues():
-            fn_names.append("    {}_{}_{}".format(class_obj.name, intf.name,
-                                                  fn.name))
-        f.write(",\n".join(fn_names) + "\n" + \
-                "};\n\n")
+static inline size_t
+{0}_bulk_align (size_t size)
+{{
+    return ((size + 15) & ~(size_t) 15);
+}}
 
-    f.write("""\
 /**
- * Initialize the {0} objects.
+ * Create many {0} objects at once.  The objects and the private data of
+ * their interfaces are allocated in a single block, freed when all the
+ * objects are deleted, and each vtable is checked once.  If any object
+ * cannot be created, the objects already created are deleted.
  *
- * @param {0}_h The object
- * @param context An opaque context passed to {0}_data_create
+ * @param count The number of objects
+ * @param contexts The opaque context passed to {0}_data_create for each
+ * object, or NULL for NULL contexts
+ * @param {0}_handles Where the objects are stored
  * @return TRUE on success, FALSE otherwise
  */
-static bool
-{0}_init ({0}_handle {0}_h, void *context)
+bool
+{0}_new_n (size_t count, void *const *contexts, {0}_handle *{0}_handles)
 {{
-    bool rc = false;
 """.format(class_obj.name))
-
+    if (parser_args.alloc_hooks):
+        f.write("    const c_intf_allocator_st *allocator;\n")
+    f.write("""\
+    {0}_block_st *block;
+    {0}_st *{0}s;
+    {0}_handle {0}_h;
+""".format(class_obj.name))
     for intf in class_obj.interfaces:
-        f.write("""\
-    bool {}_initialized = false;
-""".format(intf.name))
-
+        f.write("    size_t {}_offset;\n".format(intf.name))
     f.write("""\
-    bool {0}_data_created = false;
+    size_t num_created = 0;
+    size_t size;
+    size_t i;
+    bool rc = false;
 
-    if (NULL == {0}_h) {{
+    if ((0 == count) || (NULL == {0}_handles)) {{
+        return (0 == count);
+    }}
+
+    /* Half the address space at most, so the aligned parts add up */
+    if (count > SIZE_MAX / 2 / (sizeof({0}_st){1})) {{
         return (false);
     }}
 
+    /* The block, then the objects, then the private data of each interface */
+    size = {0}_bulk_align(sizeof(*block)) +
+           {0}_bulk_align(count * sizeof({0}_st));
+""".format(class_obj.name,
+           "".join(" +\n        {}_get_private_size()".format(intf.name)
+                   for intf in class_obj.interfaces)))
+    for intf in class_obj.interfaces:
+        f.write("""\
+    {1}_offset = size;
+    size += {0}_bulk_align(count * {1}_get_private_size());
+""".format(class_obj.name, intf.name))
+    f.write("\n" + alloc_str.format(class_obj.name))
+    f.write("""\
+    block->live = count;
+    {0}s = ({0}_st *) ((uint8_t *) block +
+        {0}_bulk_align(sizeof(*block)));
+
 """.format(class_obj.name))
 
     for intf in class_obj.interfaces:
         f.write("""\
-    rc = {1}_init(&({0}_h->{1}));
-    if (!rc) {{
-        goto err_exit;
-    }}
-    {1}_initialized = true;
-
-    rc = {1}_set_vtable(&({0}_h->{1}),
-             &{1}_vtable);
+    rc = {1}_init_n(&({0}s[0].{1}), sizeof({0}_st), count,
+             (uint8_t *) block + {1}_offset, &{0}_{1}_vtable);
     if (!rc) {{
         goto err_exit;
     }}
@@ -1182,37 +9731,181 @@ static bool
 """.format(class_obj.name, intf.name))
 
     f.write("""\
-    rc = {0}_data_create(&({0}_h->{0}_data_h), context);
-    if (!rc) {{
-        goto err_exit;
+    for (i = 0; i < count; i++) {{
+        {0}_h = &({0}s[i]);
+        {0}_h->block = block;
+""".format(class_obj.name))
+    if (parser_args.alloc_hooks):
+        f.write("        {0}_h->allocator = allocator;\n".format(
+                    class_obj.name))
+    for intf in class_obj.interfaces:
+        if (parser_args.record):
+            f.write("""\
+        {1}_set_record_info(&({0}_h->{1}), {2}_RECORD_ID,
+            (uintptr_t) {0}_h);
+""".format(class_obj.name, intf.name, class_obj.name.upper()))
+        if (parser_args.flight_recorder):
+            f.write("""\
+        {1}_set_flight_class(&({0}_h->{1}), "{0}");
+""".format(class_obj.name, intf.name))
+        if (parser_args.lock_stats and intf.is_threadsafe()):
+            f.write("""\
+        {1}_set_lock_class(&({0}_h->{1}), &{0}_lock_class);
+""".format(class_obj.name, intf.name))
+        if (parser_args.hot_swap):
+            f.write("""\
+        {1}_set_shared_vtable(&({0}_h->{1}),
+            &{0}_{1}_shared_vtable);
+""".format(class_obj.name, intf.name))
+    if (class_obj.lazy_data):
+        f.write("""\
+        /* The data is created by the first method called */
+        {0}_h->data_state = {1}_DATA_PENDING;
+        {0}_h->data_context = (NULL == contexts) ? NULL : contexts[i];
+""".format(class_obj.name, class_obj.name.upper()))
+    else:
+        f.write("""\
+        rc = {0}_data_create(&({0}_h->{0}_data_h),
+                 (NULL == contexts) ? NULL : contexts[i]);
+        if (!rc) {{
+            goto err_exit;
+        }}
+""".format(class_obj.name))
+    f.write("        num_created++;\n")
+    if (parser_args.mem_stats):
+        f.write("        {0}_mem_add_object({0}_h);\n".format(class_obj.name))
+    f.write("""\
+    }}
+
+    for (i = 0; i < count; i++) {{
+        {0}_handles[i] = &({0}s[i]);
     }}
-    {0}_data_created = true;
 
     return (true);
 
 err_exit:
 
-    if ({0}_data_created) {{
-        {0}_data_delete(&({0}_h->{0}_data_h));
+    /* Objects are only created in order, the others have no data */
+    for (i = num_created; i < count; i++) {{
+""".format(class_obj.name))
+    for intf in class_obj.interfaces:
+        f.write("        {1}_friend_delete(&({0}s[i].{1}));\n".format(
+                    class_obj.name, intf.name))
+    f.write("""\
     }}
 
-""".format(class_obj.name))
+    if (0 == num_created) {{
+        {1};
+        return (false);
+    }}
 
-    for intf in class_obj.interfaces:
-        f.write("""\
-    if ({1}_initialized) {{
-        {1}_friend_delete(&({0}_h->{1}));
+    /* The last object deleted frees the block */
+    block->live = num_created;
+    for (i = 0; i < num_created; i++) {{
+        {0}_delete(&({0}s[i]));
     }}
 
-""".format(class_obj.name, intf.name))
+    return (false);
+}}
+""".format(class_obj.name, free_str))
+
+def generate_module_header (parsed_data, parser_args):
+    """Generate a single header including the public headers of all the
+       interfaces and classes, suitable for use as a precompiled header."""
+
+    header_file_name = "{}/{}_api.h".format(parser_args.output_dir,
+                                            parser_args.module_header)
+
+    try:
+        f = open(header_file_name, "w")
+    except IOError:
+        print "ERROR: Could not open {} for writing".format(
+            header_file_name)
+        sys.exit(1)
 
+    desc_str = "This includes the public APIs of all the interfaces and\n" + \
+        "classes of the {} module.".format(parser_args.module_header)
+    write_header(f, desc_str, parsed_data.author, parsed_data.license,
+                 parser_args.lean_headers)
     f.write("""\
-    return (rc);
-}
-""")
+#ifndef __{0}_API_H__
+#define __{0}_API_H__
+
+""".format(parser_args.module_header.upper()))
+    for include in ["<stdlib.h>", "<stdbool.h>", "<stdint.h>", "<stddef.h>"]:
+        f.write("#include {}\n".format(include))
+    if (uses_runtime(parser_args)):
+        f.write("#include \"{}.h\"\n".format(get_runtime_name(parser_args)))
+    for name in (parsed_data.imported_intf_dict.keys() +
+                 parsed_data.intf_dict.keys() +
+                 parsed_data.class_dict.keys()):
+        f.write("#include \"{}{}.h\"\n".format(name,
+                                               parser_args.gen_file_suffix))
+    f.write("\n#endif\n")
+    f.close()
+
+def generate_amalgamation (parsed_data, parser_args):
+    """Generate a single C file with the code of all the interfaces and
+       classes so they are compiled as one translation unit.  As the class
+       code must be in the same file as its implementation, the
+       implementation files are included rather than the generated class
+       files."""
+
+    c_file_name = "{}/{}_all.c".format(parser_args.output_dir,
+                                       parser_args.amalgamate)
+    impl_dir = parser_args.impl_dir
+    if (impl_dir is None):
+        impl_dir = os.path.relpath(
+                       os.path.dirname(os.path.abspath(
+                           parser_args.desc_file_name)),
+                       os.path.abspath(parser_args.output_dir))
+
+    try:
+        f = open(c_file_name, "w")
+    except IOError:
+        print "ERROR: Could not open {} for writing".format(c_file_name)
+        sys.exit(1)
 
+    desc_str = "This is the amalgamation of all the interfaces and classes\n" + \
+        "of the {} module.  It should be compiled instead of\n".format(
+            parser_args.amalgamate) + \
+        "the individual interface and class implementation files."
+    write_header(f, desc_str, parsed_data.author, parsed_data.license)
+
+    names = ["{}{}".format(intf.name, parser_args.gen_file_suffix)
+             for intf in parsed_data.intf_dict.viewvalues()]
+    if (uses_runtime(parser_args)):
+        names.insert(0, get_runtime_name(parser_args))
+
+    for name in names:
+        intf_file_name = "{}/{}.c".format(parser_args.output_dir, name)
+        try:
+            with open(intf_file_name, "r") as intf_file:
+                intf_code = intf_file.read()
+        except IOError:
+            print "ERROR: Could not open {}".format(intf_file_name)
+            sys.exit(1)
+        f.write("\n/* Begin {}.c */\n\n".format(name))
+        f.write(intf_code)
+        f.write("\n/* End {}.c */\n".format(name))
+
+    f.write("\n/* Class implementations */\n\n")
+    for class_obj in parsed_data.class_dict.viewvalues():
+        f.write("#include \"{}\"\n".format(
+            os.path.join(impl_dir, "{}.c".format(class_obj.name))))
     f.close()
 
+def generate_files (task):
+    """Generate the files for a single interface or class.  The task is a
+       tuple of the generator function and its arguments.  Returns the exit
+       code so this can be run in a worker process."""
+    (gen_fn, obj, parser_args, author, license) = task
+    try:
+        gen_fn(obj, parser_args, author, license)
+    except SystemExit as e:
+        return (e.code)
+    return (0)
+
 parser = argparse.ArgumentParser(description="""Generate basic infterfaces for
                                  C.""")
 
@@ -1227,25 +9920,188 @@ parser.add_argument("-s", "--gen-file-suffix", dest="gen_file_suffix",
                     default="_gen",
                     help="The suffix used for generated files.  E.g.: " + \
                          "<interface name><suffix>.c")
+parser.add_argument("-j", "--jobs", dest="jobs", type=int,
+                    metavar="number of jobs",
+                    default=1,
+                    help="""The number of worker processes used to generate
+                         the interface and class files.  The generated files
+                         are the same regardless of the number of jobs.""")
+parser.add_argument("-c", "--cache-dir", dest="cache_dir",
+                    metavar="cache directory",
+                    default=None,
+                    help="""A directory in which parsed description files are
+                         cached, keyed by their contents, so unchanged
+                         imported files are not parsed again.""")
+parser.add_argument("--lean-headers", dest="lean_headers",
+                    action="store_true",
+                    help="""Generate headers with a one line comment, only the
+                         standard includes their types need and forward
+                         declarations of interface handles in class
+                         headers.""")
+parser.add_argument("--module-header", dest="module_header",
+                    metavar="module name",
+                    default=None,
+                    help="""Also generate <module name>_api.h which includes
+                         the public headers of all interfaces and classes.""")
+parser.add_argument("--amalgamate", dest="amalgamate",
+                    metavar="module name",
+                    default=None,
+                    help="""Also generate <module name>_all.c with the code of
+                         all interfaces and classes as a single translation
+                         unit.""")
+parser.add_argument("--impl-dir", dest="impl_dir",
+                    metavar="implementation directory",
+                    default=None,
+                    help="""The directory of the <class>.c implementation
+                         files, as included from the output directory, for
+                         --amalgamate.  Defaults to the directory of the
+                         description file.""")
+parser.add_argument("--alloc-hooks", dest="alloc_hooks",
+                    action="store_true",
+                    help="""Allocate objects and their interfaces through an
+                         allocator which can be set globally or per class
+                         instead of calling calloc() and free() directly.""")
+parser.add_argument("--arena", dest="arena",
+                    action="store_true",
+                    help="""Generate <class>_new_in() to create objects in an
+                         arena which releases all of them at once.  Implies
+                         --alloc-hooks.""")
+parser.add_argument("--numa", dest="numa",
+                    action="store_true",
+                    help="""Generate <class>_new_on() to create objects in
+                         the memory of a NUMA node and <class>_numa_count()
+                         to count them per node.  Implies --alloc-hooks.""")
+parser.add_argument("--parallel-calls", dest="parallel_calls",
+                    action="store_true",
+                    help="""Generate <intf>_<fn>_parallel() to call an
+                         interface function on many objects with a
+                         work-stealing thread pool.""")
+parser.add_argument("--record", dest="record",
+                    action="store_true",
+                    help="""Generate the code recording the calls made on
+                         interfaces to a log, once started with
+                         c_intf_record_start(), and replaying them with
+                         <intf>_replay_call().""")
+parser.add_argument("--flight-recorder", dest="flight_recorder",
+                    action="store_true",
+                    help="""Keep the last calls made on interfaces by each
+                         thread, which c_intf_flight_dump() writes as Chrome
+                         trace JSON.""")
+parser.add_argument("--flight-events", dest="flight_events",
+                    metavar="events", type=int, default=1024,
+                    help="""The number of calls kept per thread by
+                         --flight-recorder, a power of two.  Defaults to
+                         1024.""")
+parser.add_argument("--static-init", dest="static_init",
+                    action="store_true",
+                    help="""Generate <CLASS>_STATIC_INITIALIZER() to define
+                         objects fully initialized at compile time, with
+                         const vtables.""")
+parser.add_argument("--mem-stats", dest="mem_stats",
+                    action="store_true",
+                    help="""Track the live objects, bytes held, peaks,
+                         creation rate and lifetimes of the objects of each
+                         class, which c_intf_mem_report() writes.""")
+parser.add_argument("--snapshot", dest="snapshot",
+                    action="store_true",
+                    help="""Generate <class>_snapshot() to write object
+                         graphs to files which c_intf_snap_open() maps and
+                         revives with a single fixup pass.""")
+parser.add_argument("--bulk", dest="bulk",
+                    action="store_true",
+                    help="""Generate <class>_new_n() to create many objects
+                         with a single allocation and <intf>_delete_n() to
+                         delete many objects.""")
+parser.add_argument("--handle-table", dest="handle_table",
+                    action="store_true",
+                    help="""Generate 32-bit <intf>_id handles with a
+                         generation, which <intf>_resolve() turns back into
+                         objects through a table per interface, detecting
+                         the ids of deleted objects.""")
+parser.add_argument("--epochs", dest="epochs",
+                    action="store_true",
+                    help="""Generate <intf>_retire() to delete objects once
+                         the read sections entered with c_intf_read_enter()
+                         which may use them are exited.""")
+parser.add_argument("--lock-stats", dest="lock_stats",
+                    action="store_true",
+                    help="""Count the locks taken on the objects of
+                         THREADSAFE interfaces, how many waited and for how
+                         long, per class, which c_intf_lock_report()
+                         writes.""")
+parser.add_argument("--hot-swap", dest="hot_swap",
+                    action="store_true",
+                    help="""Generate <class>_swap_vtable() to swap the
+                         implementation of all the objects of a class at
+                         once, through vtables shared by the objects.""")
 
 args = parser.parse_args()
 
-try:
-    desc_file = open(args.desc_file_name, "r")
-except IOError:
+if (args.jobs < 1):
+    print "ERROR: The number of jobs must be at least 1"
+    usage(parser, 1)
+
+if (args.arena or args.numa):
+    args.alloc_hooks = True
+
+if ((args.flight_events < 1) or
+    (args.flight_events & (args.flight_events - 1))):
+    print "ERROR: The number of flight recorder events must be a power of two"
+    usage(parser, 1)
+
+if (not os.path.isfile(args.desc_file_name)):
     print "ERROR: Could not open {}".format(args.desc_file_name)
     usage(parser)
 
 try:
-    parsed_data = get_interface_objects(get_log_lines(desc_file))
+    parsed_data = load_desc_file(args.desc_file_name, args.cache_dir)
 except ParseError as e:
     print "ERROR: {}".format(e)
     sys.exit(1)
-finally:
-    desc_file.close()
+
+# The runtime support of shared memory proxies is only needed if an interface
+# generated here has them
+args.shm_proxies = any(intf.is_shm()
+                       for intf in parsed_data.intf_dict.viewvalues())
+
+# The runtime support of locks is needed by THREADSAFE interfaces generated
+# here and by the classes implementing them, which may be imported
+args.threadsafe = any(intf.is_threadsafe()
+                      for intf in parsed_data.intf_dict.viewvalues()) or \
+                  any(intf.is_threadsafe()
+                      for class_obj in parsed_data.class_dict.viewvalues()
+                      for intf in class_obj.interfaces)
+
+# Each interface and class is written to its own files, so once parsing is
+# done they can be generated independently of each other.
+tasks = []
+if (uses_runtime(args)):
+    tasks.append((generate_runtime_files, None, args, parsed_data.author,
+                  parsed_data.license))
 
 for val in parsed_data.intf_dict.viewvalues():
-    generate_interface_files(val, args, parsed_data.author, parsed_data.license)
+    tasks.append((generate_interface_files, val, args, parsed_data.author,
+                  parsed_data.license))
 
 for val in parsed_data.class_dict.viewvalues():
-    generate_class_files(val, args, parsed_data.author, parsed_data.license)
+    tasks.append((generate_class_files, val, args, parsed_data.author,
+                  parsed_data.license))
+
+if (args.jobs == 1 or len(tasks) <= 1):
+    exit_codes = [generate_files(task) for task in tasks]
+else:
+    pool = multiprocessing.Pool(min(args.jobs, len(tasks)))
+    try:
+        exit_codes = pool.map(generate_files, tasks, 1)
+    finally:
+        pool.close()
+        pool.join()
+
+if (any(exit_codes)):
+    sys.exit(1)
+
+if (args.module_header is not None):
+    generate_module_header(parsed_data, args)
+
+if (args.amalgamate is not None):
+    generate_amalgamation(parsed_data, args)